@@ -9,7 +9,8 @@ SUBDIRS     = \
 contains(DEFINES, HAVE_ICU) {
 SUBDIRS += \
  pt_mcalendar \
- pt_mcharsetdetector
+ pt_mcharsetdetector \
+ pt_mstringsearch
 }
 
 include(shell.pri)
@@ -148,4 +148,308 @@ void Pt_MCharsetDetector::benchmarkDetection()
     }
 }
 
+void Pt_MCharsetDetector::benchmarkDetectionPerMessage_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("inputEncoding");
+    QTest::addColumn<QString>("declaredLocale");
+
+    QTest::newRow("German ISO-8859-1")
+        << QString::fromUtf8("Schöne Grüße aus München!") << "ISO-8859-1" << "";
+    QTest::newRow("German ISO-8859-1, declared de_DE")
+        << QString::fromUtf8("Schöne Grüße aus München!") << "ISO-8859-1" << "de_DE";
+    QTest::newRow("Russian KOI8-R")
+        << QString::fromUtf8("Привет, как дела?") << "KOI8-R" << "";
+    QTest::newRow("Russian KOI8-R, declared ru_RU")
+        << QString::fromUtf8("Привет, как дела?") << "KOI8-R" << "ru_RU";
+    QTest::newRow("Ukrainian windows-1251, declared uk_UA")
+        << QString::fromUtf8("Ґанок і їжак") << "windows-1251" << "uk_UA";
+    QTest::newRow("Traditional Chinese Big5, declared zh_TW")
+        << QString::fromUtf8("中華電信") << "Big5" << "zh_TW";
+    QTest::newRow("Japanese Shift_JIS")
+        << QString::fromUtf8("今日は雨が降っています。") << "Shift_JIS" << "";
+}
+
+void Pt_MCharsetDetector::benchmarkDetectionPerMessage()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, inputEncoding);
+    QFETCH(QString, declaredLocale);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+    QByteArray encodedString = codec->fromUnicode(text);
+    QString decodedText;
+
+    // a new detector for every short message, like a mail or
+    // messaging client would do it:
+    QBENCHMARK {
+        MCharsetDetector charsetDetector(encodedString);
+        charsetDetector.setDeclaredLocale(declaredLocale);
+        decodedText = charsetDetector.text(charsetDetector.detect());
+    }
+
+    QVERIFY(!decodedText.isEmpty());
+}
+
+void Pt_MCharsetDetector::benchmarkLargeInput_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("inputEncoding");
+    QTest::addColumn<int>("size");
+
+    QString german = QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. ");
+    QString russian = QString::fromUtf8("Съешь же ещё этих мягких французских булок. ");
+    QString chinese = QString::fromUtf8("中華電信的網路服務。");
+    QList<int> sizes;
+    sizes << 64 * 1024 << 1024 * 1024 << 4 * 1024 * 1024;
+    foreach (int size, sizes) {
+        QString suffix = QString(" %1 kB").arg(size / 1024);
+        QTest::newRow(("German UTF-8" + suffix).toLatin1().constData())
+            << german << "UTF-8" << size;
+        QTest::newRow(("German ISO-8859-1" + suffix).toLatin1().constData())
+            << german << "ISO-8859-1" << size;
+        QTest::newRow(("Russian KOI8-R" + suffix).toLatin1().constData())
+            << russian << "KOI8-R" << size;
+        QTest::newRow(("Traditional Chinese Big5" + suffix).toLatin1().constData())
+            << chinese << "Big5" << size;
+    }
+}
+
+void Pt_MCharsetDetector::benchmarkLargeInput()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, inputEncoding);
+    QFETCH(int, size);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+
+    QByteArray encodedString;
+    QByteArray encodedText = codec->fromUnicode(text);
+    while (encodedString.size() < size)
+        encodedString += encodedText;
+    MCharsetDetector charsetDetector(encodedString);
+    QList<MCharsetMatch> mCharsetMatchList;
+
+    QBENCHMARK {
+        mCharsetMatchList = charsetDetector.detectAll();
+    }
+
+    QVERIFY(!mCharsetMatchList.isEmpty());
+}
+
+void Pt_MCharsetDetector::benchmarkDetectAndDecode_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QString>("inputEncoding");
+    QTest::addColumn<int>("size");
+    QTest::addColumn<bool>("reuseDecodedText");
+
+    QString german = QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. ");
+    QString chinese = QString::fromUtf8("中華電信的網路服務。");
+    int size = 1024 * 1024;
+    QTest::newRow("German ISO-8859-1 1024 kB detect() and text()")
+        << german << "ISO-8859-1" << size << false;
+    QTest::newRow("German ISO-8859-1 1024 kB detectAndDecode()")
+        << german << "ISO-8859-1" << size << true;
+    QTest::newRow("Traditional Chinese Big5 1024 kB detect() and text()")
+        << chinese << "Big5" << size << false;
+    QTest::newRow("Traditional Chinese Big5 1024 kB detectAndDecode()")
+        << chinese << "Big5" << size << true;
+}
+
+void Pt_MCharsetDetector::benchmarkDetectAndDecode()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, inputEncoding);
+    QFETCH(int, size);
+    QFETCH(bool, reuseDecodedText);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+
+    QByteArray encodedString;
+    QByteArray encodedText = codec->fromUnicode(text);
+    while (encodedString.size() < size)
+        encodedString += encodedText;
+    MCharsetDetector charsetDetector(encodedString);
+    QString decodedText;
+
+    QBENCHMARK {
+        if (reuseDecodedText) {
+            charsetDetector.detectAndDecode(&decodedText);
+        }
+        else {
+            MCharsetMatch bestMatch = charsetDetector.detect();
+            decodedText = charsetDetector.text(bestMatch);
+        }
+    }
+
+    QVERIFY(!decodedText.isEmpty());
+}
+
+// peak resident set size of the process in kB, -1 if not available
+static qint64 peakResidentSize()
+{
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly))
+        return -1;
+    foreach (const QByteArray &line, status.readAll().split('\n')) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong();
+    }
+    return -1;
+}
+
+// resets the peak resident set size to the current one (Linux >= 4.0)
+static bool resetPeakResidentSize()
+{
+    QFile clearRefs("/proc/self/clear_refs");
+    if (!clearRefs.open(QIODevice::WriteOnly))
+        return false;
+    return clearRefs.write("5") == 1;
+}
+
+void Pt_MCharsetDetector::benchmarkDetectAndDecodePeakMemory()
+{
+    // Single byte charsets can decode almost any input, for Latin
+    // text libicu returns many of them which all have to be checked.
+    // detectAndDecode() must not keep the decoded texts of all of
+    // them but only the one of the best match.
+    QString german = QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. ");
+    QByteArray encodedText = QTextCodec::codecForName("ISO-8859-1")->fromUnicode(german);
+    QByteArray encodedString;
+    const int size = 4 * 1024 * 1024;
+    encodedString.reserve(size + encodedText.size());
+    while (encodedString.size() < size)
+        encodedString += encodedText;
+    MCharsetDetector charsetDetector(encodedString);
+    QString decodedText;
+
+    if (!resetPeakResidentSize() || peakResidentSize() < 0) {
+        qWarning("peak resident set size not available, not checking it");
+    }
+    else {
+        const qint64 before = peakResidentSize();
+        charsetDetector.detectAndDecode(&decodedText);
+        const qint64 growth = peakResidentSize() - before;
+        qDebug() << "peak memory growth for" << encodedString.size() / 1024
+                 << "kB of input:" << growth << "kB";
+        // the decoded text needs two bytes per input byte, allow some
+        // more for the chunks, reallocations and libicu. One decoded
+        // text per candidate would need many times that:
+        QVERIFY2(growth < 6 * encodedString.size() / 1024,
+                 qPrintable(QString("peak memory grew by %1 kB").arg(growth)));
+        QCOMPARE(decodedText, german.repeated(encodedString.size() / encodedText.size()));
+    }
+
+    QBENCHMARK {
+        charsetDetector.detectAndDecode(&decodedText);
+    }
+}
+
+void Pt_MCharsetDetector::benchmarkDetectFiles_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("2 threads") << 2;
+    QTest::newRow("4 threads") << 4;
+    QTest::newRow("ideal thread count") << 0;
+}
+
+void Pt_MCharsetDetector::benchmarkDetectFiles()
+{
+    QFETCH(int, threads);
+
+    // many small message parts, like a mail indexer sees them:
+    QString german = QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. ");
+    QString russian = QString::fromUtf8("Съешь же ещё этих мягких французских булок. ");
+    QString chinese = QString::fromUtf8("中華電信的網路服務。");
+    QList<QTemporaryFile *> files;
+    QStringList fileNames;
+    qint64 totalSize = 0;
+    for (int i = 0; i < 500; ++i) {
+        QByteArray encodedString;
+        if (i % 4 == 0)
+            encodedString = QTextCodec::codecForName("ISO-8859-1")->fromUnicode(german);
+        else if (i % 4 == 1)
+            encodedString = QTextCodec::codecForName("KOI8-R")->fromUnicode(russian);
+        else if (i % 4 == 2)
+            encodedString = QTextCodec::codecForName("Big5")->fromUnicode(chinese);
+        else
+            encodedString = german.toUtf8();
+        QByteArray content;
+        while (content.size() < 2000 + 100 * (i % 50))
+            content += encodedString;
+        QTemporaryFile *file = new QTemporaryFile;
+        QVERIFY(file->open());
+        file->write(content);
+        file->close();
+        files << file;
+        fileNames << file->fileName();
+        totalSize += content.size();
+    }
+    QList<MCharsetMatch> matches;
+    // QElapsedTimer needs Qt 4.7, milliseconds are precise enough here:
+    QTime timer;
+    qint64 elapsed = 0;
+    int iterations = 0;
+
+    QBENCHMARK {
+        timer.start();
+        matches = MCharsetDetector::detectFiles(fileNames, "", "", threads);
+        elapsed += timer.elapsed();
+        ++iterations;
+    }
+
+    QCOMPARE(matches.size(), fileNames.size());
+    if (elapsed > 0) {
+        double seconds = elapsed / 1e3;
+        qDebug() << "files/s:" << iterations * fileNames.size() / seconds
+                 << "MB/s:" << iterations * totalSize / seconds / (1024 * 1024);
+    }
+    qDeleteAll(files);
+}
+
+void Pt_MCharsetDetector::benchmarkFeed_data()
+{
+    benchmarkLargeInput_data();
+}
+
+void Pt_MCharsetDetector::benchmarkFeed()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, inputEncoding);
+    QFETCH(int, size);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+
+    QByteArray encodedString;
+    QByteArray encodedText = codec->fromUnicode(text);
+    while (encodedString.size() < size)
+        encodedString += encodedText;
+    MCharsetDetector charsetDetector;
+    QList<MCharsetMatch> mCharsetMatchList;
+
+    // feed the input like it is read from a file:
+    QBENCHMARK {
+        for (int i = 0; i < encodedString.size(); i += 16 * 1024) {
+            if (!charsetDetector.feed(encodedString.constData() + i,
+                                      qMin(16 * 1024, encodedString.size() - i)))
+                break;
+        }
+        charsetDetector.finish();
+        mCharsetMatchList = charsetDetector.detectAll();
+    }
+
+    QVERIFY(!mCharsetMatchList.isEmpty());
+}
+
 QTEST_APPLESS_MAIN(Pt_MCharsetDetector);
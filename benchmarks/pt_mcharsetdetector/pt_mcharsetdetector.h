@@ -43,6 +43,17 @@ private slots:
 
     void benchmarkDetection_data();
     void benchmarkDetection();
+    void benchmarkDetectionPerMessage_data();
+    void benchmarkDetectionPerMessage();
+    void benchmarkLargeInput_data();
+    void benchmarkLargeInput();
+    void benchmarkDetectAndDecode_data();
+    void benchmarkDetectAndDecode();
+    void benchmarkDetectAndDecodePeakMemory();
+    void benchmarkDetectFiles_data();
+    void benchmarkDetectFiles();
+    void benchmarkFeed_data();
+    void benchmarkFeed();
 };
 
 #endif
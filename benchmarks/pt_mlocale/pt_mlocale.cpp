@@ -275,4 +275,68 @@ void Pt_MLocale::benchmarkCollatorStrengthSwitching()
     }
 }
 #endif
+
+#ifdef HAVE_ICU
+void Pt_MLocale::benchmarkCollatorStrengthVariants()
+{
+    MLocale localeDa("da_DK");
+    MCollator collatorDa = localeDa.collator();
+    QString s1("Aaland");
+    QString s2(QString::fromUtf8("Åland"));
+    QBENCHMARK {
+        collatorDa.compare(s1, s2, MLocale::CollatorStrengthPrimary);
+        collatorDa.compare(s1, s2, MLocale::CollatorStrengthQuaternary);
+    }
+}
+
+void Pt_MLocale::benchmarkCollatorSort_data()
+{
+    QTest::addColumn<QString>("localeName");
+    QTest::addColumn<int>("threads");
+
+    // threads == -1 sorts with qStableSort() and the collator
+    // as comparison function, for reference
+    QList<int> threadCounts;
+    threadCounts << -1 << 1 << 2 << 4 << 8;
+    QStringList localeNames;
+    localeNames << "de_DE" << "zh_CN@collation=pinyin";
+    foreach (const QString &localeName, localeNames) {
+        foreach (int threads, threadCounts) {
+            QTest::newRow(QString("%1 threads=%2").arg(localeName).arg(threads).toUtf8().constData())
+                << localeName << threads;
+        }
+    }
+}
+
+void Pt_MLocale::benchmarkCollatorSort()
+{
+    QFETCH(QString, localeName);
+    QFETCH(int, threads);
+
+    const QStringList syllables = QString::fromUtf8(
+        "an,Bä,chu,de,Ém,fo,gü,ha,ið,ju,ka,lø,mi,No,ös,pa,qi,ro,Sü,ta,ul,vé,wo,xi,ya,zå,"
+        "阿,北,长,东,二,方,广,海,江,开,"
+        ).split(',', QString::SkipEmptyParts);
+    QStringList list;
+    quint32 seed = 42;
+    for (int i = 0; i < 50000; ++i) {
+        QString name;
+        for (int j = 0; j < 4; ++j) {
+            seed = seed * 1103515245 + 12345;
+            name += syllables.at((seed >> 16) % syllables.size());
+        }
+        list << name;
+    }
+
+    MLocale locale(localeName);
+    MCollator collator = locale.collator();
+    QBENCHMARK {
+        QStringList sorted = list;
+        if (threads < 0)
+            qStableSort(sorted.begin(), sorted.end(), collator);
+        else
+            collator.sort(sorted, Qt::AscendingOrder, threads, true);
+    }
+}
+#endif
 QTEST_APPLESS_MAIN(Pt_MLocale);
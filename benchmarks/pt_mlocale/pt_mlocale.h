@@ -57,6 +57,9 @@ private slots:
     void benchmarkFormatNumberDoubleWestern();
     void benchmarkChineseSorting();
     void benchmarkCollatorStrengthSwitching();
+    void benchmarkCollatorStrengthVariants();
+    void benchmarkCollatorSort_data();
+    void benchmarkCollatorSort();
 #endif
 };
 
@@ -23,7 +23,10 @@
 #include "mcity.h"
 #include "mcountry.h"
 
+#include <math.h>
+
 using ML10N::MCity;
+using ML10N::MCountry;
 using ML10N::MLocationDatabase;
 
 void Pt_MLocationDatabase::initTestCase()
@@ -57,6 +60,48 @@ void Pt_MLocationDatabase::benchmarkMLocationDatabaseConstructorDestructor()
     }
 }
 
+void Pt_MLocationDatabase::benchmarkMLocationDatabaseFirstQuery()
+{
+    // the data is loaded on the first query and freed with the last
+    // instance, so this loads it in every iteration:
+    QBENCHMARK {
+        MLocationDatabase *db = new MLocationDatabase;
+        db->countries();
+        delete db;
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkMLocationDatabaseSharedInstance()
+{
+    MLocationDatabase db;
+    db.countries();
+    QBENCHMARK {
+        MLocationDatabase *otherDb = new MLocationDatabase;
+        otherDb->countries();
+        delete otherDb;
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkMLocationDatabaseConstructorDestructorXml()
+{
+    // Without a cached binary database the first query parses the xml
+    // files and writes the cache again. Compare with
+    // benchmarkMLocationDatabaseFirstQuery() which maps the binary
+    // database cached by the first iteration.
+    if (QFile::exists("/usr/share/meegotouch/locationdatabase/locationdatabase.bin"))
+        qWarning("system binary location database installed, the xml files are not parsed");
+    const QByteArray savedCacheHome = qgetenv("XDG_CACHE_HOME");
+    const QString cacheHome = QDir::tempPath() + "/pt_mlocationdatabase-cache";
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(cacheHome));
+    QBENCHMARK {
+        QFile::remove(cacheHome + "/mlocale/locationdatabase.bin");
+        MLocationDatabase *db = new MLocationDatabase;
+        db->countries();
+        delete db;
+    }
+    qputenv("XDG_CACHE_HOME", savedCacheHome);
+}
+
 void Pt_MLocationDatabase::benchmarkTimeZone()
 {
     MLocationDatabase db;
@@ -108,5 +153,138 @@ void Pt_MLocationDatabase::benchmarkMatchingCities()
     }
 }
 
+void Pt_MLocationDatabase::benchmarkMatchingCitiesShortQueries()
+{
+    // what a user types into a search field, one keystroke at a time:
+    QStringList patterns;
+    patterns << "s" << "sa" << "san" << "san " << "san j" << "san jo" << "san jos";
+
+    MLocationDatabase db;
+    if (db.cities().count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    QBENCHMARK {
+        foreach (const QString &pattern, patterns)
+            db.matchingCities(pattern);
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkCitiesInCountry()
+{
+    MLocationDatabase db;
+    if (db.cities().count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    QStringList countryKeys;
+    foreach (const MCountry &country, db.countries())
+        countryKeys << country.key();
+    QBENCHMARK {
+        foreach (const QString &countryKey, countryKeys)
+            db.citiesInCountry(countryKey);
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkCitiesInTimeZone()
+{
+    MLocationDatabase db;
+    QList<MCity> cities = db.cities();
+    if (cities.count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    QSet<QString> timeZoneIds;
+    foreach (const MCity &city, cities)
+        timeZoneIds << city.timeZone();
+    // aliases have to be canonicalized first:
+    timeZoneIds << "US/Pacific" << "Asia/Calcutta";
+    QBENCHMARK {
+        foreach (const QString &timeZoneId, timeZoneIds)
+            db.citiesInTimeZone(timeZoneId);
+    }
+}
+
+static QList<QPointF> someLocations()
+{
+    // latitude, longitude pairs spread over the globe:
+    QList<QPointF> locations;
+    for (int latitude = -80; latitude <= 80; latitude += 20)
+        for (int longitude = -180; longitude < 180; longitude += 20)
+            locations << QPointF(latitude + 0.5, longitude + 0.5);
+    return locations;
+}
+
+void Pt_MLocationDatabase::benchmarkNearestCity()
+{
+    MLocationDatabase db;
+    if (db.cities().count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    const QList<QPointF> locations = someLocations();
+    QBENCHMARK {
+        foreach (const QPointF &location, locations)
+            db.nearestCity(location.x(), location.y());
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkNearestCityLinearScan()
+{
+    // what nearestCity() did before it had a spatial index, a scan
+    // over all cities, here with the great circle distance:
+    MLocationDatabase db;
+    QList<MCity> cities = db.cities();
+    if (cities.count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    const QList<QPointF> locations = someLocations();
+    const double radiansPerDegree = M_PI / 180.0;
+    QBENCHMARK {
+        foreach (const QPointF &location, locations) {
+            double bestDistance = 10;
+            foreach (const MCity &city, cities) {
+                const double sinHalfLatitude =
+                    sin((city.latitude() - location.x()) * radiansPerDegree / 2);
+                const double sinHalfLongitude =
+                    sin((city.longitude() - location.y()) * radiansPerDegree / 2);
+                const double a = sinHalfLatitude * sinHalfLatitude
+                    + cos(location.x() * radiansPerDegree) * cos(city.latitude() * radiansPerDegree)
+                    * sinHalfLongitude * sinHalfLongitude;
+                bestDistance = qMin(bestDistance, 2 * atan2(sqrt(a), sqrt(1 - a)));
+            }
+        }
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkNearestCities()
+{
+    MLocationDatabase db;
+    if (db.cities().count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    const QList<QPointF> locations = someLocations();
+    QBENCHMARK {
+        foreach (const QPointF &location, locations)
+            db.nearestCities(location.x(), location.y(), 10);
+    }
+}
+
+void Pt_MLocationDatabase::benchmarkCitiesWithin()
+{
+    MLocationDatabase db;
+    if (db.cities().count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    const QList<QPointF> locations = someLocations();
+    QBENCHMARK {
+        foreach (const QPointF &location, locations)
+            db.citiesWithin(location.x(), location.y(), 500);
+    }
+}
+
 QTEST_APPLESS_MAIN(Pt_MLocationDatabase);
 
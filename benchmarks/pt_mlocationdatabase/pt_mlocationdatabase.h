@@ -38,8 +38,18 @@ private slots:
     void cleanup();
 
     void benchmarkMLocationDatabaseConstructorDestructor();
+    void benchmarkMLocationDatabaseFirstQuery();
+    void benchmarkMLocationDatabaseSharedInstance();
+    void benchmarkMLocationDatabaseConstructorDestructorXml();
     void benchmarkTimeZone();
     void benchmarkMatchingCities();
+    void benchmarkMatchingCitiesShortQueries();
+    void benchmarkCitiesInCountry();
+    void benchmarkCitiesInTimeZone();
+    void benchmarkNearestCity();
+    void benchmarkNearestCityLinearScan();
+    void benchmarkNearestCities();
+    void benchmarkCitiesWithin();
 };
 
 #endif
@@ -0,0 +1,282 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "pt_mstringsearch.h"
+
+using ML10N::MLocale;
+using ML10N::MBreakIterator;
+using ML10N::MStringSearch;
+using ML10N::MStringSearchIndex;
+using ML10N::MStringSearchSession;
+using ML10N::MMultiStringSearch;
+
+void Pt_MStringSearch::initTestCase()
+{
+    static int argc = 0;
+    static char *argv[1] = { (char *) "" };
+    qap = new QCoreApplication(argc, argv);
+#if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
+    QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+#endif
+    // a contact list of 20000 names:
+    const QStringList firstNames = QString::fromUtf8(
+        "Anna,Åsa,Björn,Chloé,Dmitri,Émilie,François,Günther,Hélène,Ingrid,"
+        "Jürgen,Kåre,Łukasz,Márta,Nils,Örjan,Pål,Renée,Søren,Zoë").split(',');
+    const QStringList lastNames = QString::fromUtf8(
+        "Andersson,Bäckström,Černý,Dvořák,Eriksen,Fältskog,Gómez,Hämäläinen,"
+        "Iglesias,Jönsson,Kowalski,Lindqvist,Müller,Nyström,O'Brien,Pérez,"
+        "Quist,Rådström,Schröder,Wójcik,刘,张,王").split(',');
+    quint32 seed = 42;
+    for (int i = 0; i < 20000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        QString name = firstNames.at((seed >> 16) % firstNames.size());
+        seed = seed * 1103515245 + 12345;
+        name += QLatin1Char(' ') + lastNames.at((seed >> 16) % lastNames.size());
+        names << name;
+    }
+}
+
+void Pt_MStringSearch::cleanupTestCase()
+{
+    delete qap;
+}
+
+void Pt_MStringSearch::init()
+{
+}
+
+void Pt_MStringSearch::cleanup()
+{
+}
+
+void Pt_MStringSearch::benchmarkFilterWithStringSearch_data()
+{
+    QTest::addColumn<QString>("localeName");
+    QTest::addColumn<QString>("pattern");
+
+    QTest::newRow("sv_SE a") << "sv_SE" << "a";
+    QTest::newRow("sv_SE ande") << "sv_SE" << "ande";
+    QTest::newRow("de_DE schro") << "de_DE" << "schro";
+    QTest::newRow("zh_CN liu") << "zh_CN" << "liu";
+}
+
+void Pt_MStringSearch::benchmarkFilterWithStringSearch()
+{
+    QFETCH(QString, localeName);
+    QFETCH(QString, pattern);
+
+    // the way a list is filtered with MStringSearch, one row at a time:
+    MLocale locale(localeName);
+    MStringSearch stringSearch(pattern, names.first(), locale);
+    QBENCHMARK {
+        QList<int> rows;
+        for (int row = 0; row < names.size(); ++row) {
+            stringSearch.setText(names.at(row));
+            if (stringSearch.first() != -1)
+                rows << row;
+        }
+    }
+}
+
+void Pt_MStringSearch::benchmarkFilterWithIndex_data()
+{
+    benchmarkFilterWithStringSearch_data();
+}
+
+void Pt_MStringSearch::benchmarkFilterWithIndex()
+{
+    QFETCH(QString, localeName);
+    QFETCH(QString, pattern);
+
+    MLocale locale(localeName);
+    MStringSearchIndex index(names, locale);
+    // prepare the tables for the pattern outside of the measurement:
+    index.matchingRows(pattern);
+    QBENCHMARK {
+        index.matchingRows(pattern);
+    }
+}
+
+void Pt_MStringSearch::benchmarkPrefixMatchingRows_data()
+{
+    benchmarkFilterWithStringSearch_data();
+}
+
+void Pt_MStringSearch::benchmarkPrefixMatchingRows()
+{
+    QFETCH(QString, localeName);
+    QFETCH(QString, pattern);
+
+    MLocale locale(localeName);
+    MStringSearchIndex index(names, locale);
+    // build the prefix index outside of the measurement:
+    index.prefixMatchingRows(pattern);
+    QBENCHMARK {
+        index.prefixMatchingRows(pattern);
+    }
+}
+
+void Pt_MStringSearch::benchmarkIndexCreation()
+{
+    MLocale locale("sv_SE");
+    QBENCHMARK {
+        MStringSearchIndex index(names, locale);
+    }
+}
+
+void Pt_MStringSearch::benchmarkConstruction_data()
+{
+    QTest::addColumn<QString>("localeName");
+    QTest::addColumn<MBreakIterator::Type>("breakIteratorType");
+
+    QTest::newRow("en_US character") << "en_US" << MBreakIterator::CharacterIterator;
+    QTest::newRow("en_US word") << "en_US" << MBreakIterator::WordIterator;
+    QTest::newRow("zh_CN word") << "zh_CN" << MBreakIterator::WordIterator;
+}
+
+void Pt_MStringSearch::benchmarkConstruction()
+{
+    QFETCH(QString, localeName);
+    QFETCH(MBreakIterator::Type, breakIteratorType);
+
+    // one MStringSearch per row as a filter would do it:
+    MLocale locale(localeName);
+    QBENCHMARK {
+        for (int i = 0; i < 100; ++i) {
+            MStringSearch stringSearch("an", names.at(i), locale, breakIteratorType);
+            stringSearch.first();
+        }
+    }
+}
+
+void Pt_MStringSearch::benchmarkTyping_data()
+{
+    QTest::addColumn<bool>("useSession");
+
+    QTest::newRow("index") << false;
+    QTest::newRow("session") << true;
+}
+
+void Pt_MStringSearch::benchmarkTyping()
+{
+    QFETCH(bool, useSession);
+
+    // typing “anders”, one backspace, then “ss”:
+    QStringList typedPatterns;
+    typedPatterns << "a" << "an" << "and" << "ande" << "ander" << "anders"
+                  << "ander" << "anderss" << "andersso";
+    MLocale locale("sv_SE");
+    MStringSearchIndex index(names, locale);
+    index.matchingRows("a");
+    QBENCHMARK {
+        MStringSearchSession session(&index);
+        foreach (const QString &pattern, typedPatterns) {
+            if (useSession) {
+                session.setPattern(pattern);
+                session.matchingRows();
+            }
+            else {
+                index.matchingRows(pattern);
+            }
+        }
+    }
+}
+
+void Pt_MStringSearch::benchmarkKeywords_data()
+{
+    QTest::addColumn<int>("keywordCount");
+    QTest::addColumn<bool>("useMultiStringSearch");
+
+    QTest::newRow("1 keyword, MStringSearch") << 1 << false;
+    QTest::newRow("1 keyword, MMultiStringSearch") << 1 << true;
+    QTest::newRow("10 keywords, MStringSearch") << 10 << false;
+    QTest::newRow("10 keywords, MMultiStringSearch") << 10 << true;
+    QTest::newRow("50 keywords, MStringSearch") << 50 << false;
+    QTest::newRow("50 keywords, MMultiStringSearch") << 50 << true;
+}
+
+void Pt_MStringSearch::benchmarkKeywords()
+{
+    QFETCH(int, keywordCount);
+    QFETCH(bool, useMultiStringSearch);
+
+    // about 100 kB of text:
+    QString text;
+    for (int i = 0; text.size() * int(sizeof(QChar)) < 100 * 1024; ++i)
+        text += names.at(i % names.size()) + QLatin1String(", ");
+    QStringList keywords;
+    for (int i = 0; i < keywordCount; ++i)
+        keywords << names.at(i * 97 % names.size()).section(' ', i % 2, i % 2);
+
+    MLocale locale("en_US");
+    if (useMultiStringSearch) {
+        MMultiStringSearch search(keywords, locale);
+        QBENCHMARK {
+            search.findAll(text);
+        }
+    }
+    else {
+        MStringSearch stringSearch(keywords.first(), text, locale);
+        QBENCHMARK {
+            foreach (const QString &keyword, keywords) {
+                stringSearch.setPattern(keyword);
+                stringSearch.findAll();
+            }
+        }
+    }
+}
+
+void Pt_MStringSearch::benchmarkFindAll_data()
+{
+    QTest::addColumn<QString>("localeName");
+    QTest::addColumn<QString>("pattern");
+    QTest::addColumn<bool>("useFindAll");
+
+    QTest::newRow("en_US first/next") << "en_US" << "schroder" << false;
+    QTest::newRow("en_US findAll") << "en_US" << "schroder" << true;
+    QTest::newRow("en_US frequent first/next") << "en_US" << "an" << false;
+    QTest::newRow("en_US frequent findAll") << "en_US" << "an" << true;
+}
+
+void Pt_MStringSearch::benchmarkFindAll()
+{
+    QFETCH(QString, localeName);
+    QFETCH(QString, pattern);
+    QFETCH(bool, useFindAll);
+
+    // about 1 MB of text:
+    QString text;
+    for (int i = 0; text.size() * int(sizeof(QChar)) < 1024 * 1024; ++i)
+        text += names.at(i % names.size()) + QLatin1String(", ");
+
+    MLocale locale(localeName);
+    MStringSearch stringSearch(pattern, text, locale);
+    QBENCHMARK {
+        if (useFindAll) {
+            stringSearch.findAll();
+        }
+        else {
+            QVector<QPair<int, int> > matches;
+            for (int start = stringSearch.first(); start != -1; start = stringSearch.next())
+                matches.append(qMakePair(stringSearch.matchedStart(), stringSearch.matchedLength()));
+        }
+    }
+}
+
+QTEST_APPLESS_MAIN(Pt_MStringSearch);
@@ -0,0 +1,67 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef PT_MSTRINGSEARCH_H
+#define PT_MSTRINGSEARCH_H
+
+#include <QtTest/QtTest>
+#include <QCoreApplication>
+#include <QTextCodec>
+#include <QObject>
+#include <MLocale>
+#include <MStringSearch>
+#include <MStringSearchIndex>
+#include <MStringSearchSession>
+#include <MMultiStringSearch>
+
+Q_DECLARE_METATYPE(ML10N::MLocale::CollatorStrength);
+Q_DECLARE_METATYPE(ML10N::MBreakIterator::Type);
+
+class Pt_MStringSearch : public QObject
+{
+    Q_OBJECT
+
+private:
+    QCoreApplication *qap;
+    QStringList names;
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void init();
+    void cleanup();
+
+    void benchmarkFilterWithStringSearch_data();
+    void benchmarkFilterWithStringSearch();
+    void benchmarkFilterWithIndex_data();
+    void benchmarkFilterWithIndex();
+    void benchmarkPrefixMatchingRows_data();
+    void benchmarkPrefixMatchingRows();
+    void benchmarkIndexCreation();
+    void benchmarkConstruction_data();
+    void benchmarkConstruction();
+    void benchmarkTyping_data();
+    void benchmarkTyping();
+    void benchmarkKeywords_data();
+    void benchmarkKeywords();
+    void benchmarkFindAll_data();
+    void benchmarkFindAll();
+};
+
+#endif
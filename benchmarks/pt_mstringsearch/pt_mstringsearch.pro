@@ -0,0 +1,7 @@
+include(../common_top.pri)
+INCLUDEPATH += $$MSRCDIR/include $$MSRCDIR/corelib/theme
+DEPENDPATH += $$INCLUDEPATH
+TARGET = pt_mstringsearch
+
+HEADERS += pt_mstringsearch.h
+SOURCES += pt_mstringsearch.cpp
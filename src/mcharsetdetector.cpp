@@ -30,16 +30,320 @@
 #include <unicode/uenum.h>
 #include <unicode/ucsdet.h>
 
+#include <limits.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QFile>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 #include <QDebug>
 
 namespace ML10N {
 
+// The charsets detectable by both libicu and QTextCodec and their
+// codecs do not change while the process runs. They are looked up
+// once and shared by all MCharsetDetector objects, which makes
+// creating a detector for a single detection cheap.
+struct MCharsetDetectorCodecTable {
+    QStringList charsets;
+    QHash<QString, QTextCodec *> codecs;
+    QHash<QString, int> charsetIds;
+};
+
+// names of the charsets in MCharsetDetectorPrivate::CharsetId
+static const char *const charsetIdNames[MCharsetDetectorPrivate::CharsetIdCount] = {
+    0,
+    "UTF-8",
+    "ISO-8859-1",
+    "ISO-8859-5",
+    "ISO-8859-6",
+    "ISO-8859-7",
+    "ISO-8859-8",
+    "ISO-8859-9",
+    "KOI8-R",
+    "KOI8-U",
+    "windows-1251",
+    "ISO-2022-JP",
+    "Big5",
+    "GB18030"
+};
+
+// When the declared locale is set and it is a locale where the
+// legacy encoding is a single byte encoding, these encodings are
+// added to the matches in detectAll(). Multibyte encodings like
+// Shift_JIS, EUC-JP, Big5, etc. ... do not need to be added,
+// contrary to the single byte encodings I could find no case where
+// the matches returned by libicu did omit a multibyte encoding when
+// it should have been included.
+struct MCharsetDetectorLanguage {
+    char language[3];
+    MCharsetDetectorPrivate::LanguageId id;
+    MCharsetDetectorPrivate::CharsetId legacyCharsets[3];
+};
+
+static const MCharsetDetectorLanguage languageTable[] = {
+    { "ru", MCharsetDetectorPrivate::RussianLanguage,
+      { MCharsetDetectorPrivate::Koi8rCharset,
+        MCharsetDetectorPrivate::Windows1251Charset,
+        MCharsetDetectorPrivate::Iso88595Charset } },
+    // ISO 8859-5 encoding is missing the letter ґ needed for
+    // Ukrainian, i.e. ISO 8859-5 should not occur for Ukrainian
+    { "uk", MCharsetDetectorPrivate::UkrainianLanguage,
+      { MCharsetDetectorPrivate::Koi8uCharset,
+        MCharsetDetectorPrivate::Windows1251Charset } },
+    { "tr", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88599Charset } },
+    { "el", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88597Charset } },
+    { "en", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "da", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "de", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "es", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "fi", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "fr", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "it", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "nl", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "no", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "nn", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "nb", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "pt", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "sv", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "cs", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "hu", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "pl", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "ro", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88591Charset } },
+    { "ar", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88596Charset } },
+    { "fa", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88596Charset } },
+    { "ur", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88596Charset } },
+    { "he", MCharsetDetectorPrivate::OtherLanguage, { MCharsetDetectorPrivate::Iso88598Charset } }
+};
+
+// Offsets added to the accumulated confidence of a charset for the
+// declared language, see detectAll().
+struct MCharsetDetectorConfidenceOffset {
+    MCharsetDetectorPrivate::LanguageId language;
+    MCharsetDetectorPrivate::CharsetId charset;
+    qint32 offset;
+};
+
+static const MCharsetDetectorConfidenceOffset confidenceOffsets[] = {
+    { MCharsetDetectorPrivate::RussianLanguage, MCharsetDetectorPrivate::Koi8rCharset, 20 },
+    { MCharsetDetectorPrivate::RussianLanguage, MCharsetDetectorPrivate::Iso88595Charset, 20 },
+    { MCharsetDetectorPrivate::RussianLanguage, MCharsetDetectorPrivate::Windows1251Charset, 21 },
+    { MCharsetDetectorPrivate::UkrainianLanguage, MCharsetDetectorPrivate::Koi8uCharset, 20 },
+    { MCharsetDetectorPrivate::UkrainianLanguage, MCharsetDetectorPrivate::Windows1251Charset, 25 }
+};
+
+static QMutex codecTableMutex;
+static MCharsetDetectorCodecTable *codecTable = 0;
+
+struct MStaticCodecTableDestroyer {
+    ~MStaticCodecTableDestroyer() {
+        delete codecTable;
+        codecTable = 0;
+    }
+};
+static MStaticCodecTableDestroyer staticCodecTableDestroyer;
+
+static MCharsetDetectorCodecTable *createCodecTable()
+{
+    // Codecs supported by QTextCodec (Qt 4.7):
+    //
+    // ISO-2022-JP JIS7 EUC-KR GB2312 Big5 Big5-ETen CP950 GB18030
+    // EUC-JP Shift_JIS SJIS MS_Kanji System UTF-8 ISO-8859-1 latin1
+    // CP819 IBM819 iso-ir-100 csISOLatin1 ISO-8859-15 latin9 UTF-32LE
+    // UTF-32BE UTF-32 UTF-16LE UTF-16BE UTF-16 mulelao-1 roman8
+    // hp-roman8 csHPRoman8 TIS-620 ISO 8859-11 WINSAMI2 WS2 Apple
+    // Roman macintosh MacRoman windows-1258 CP1258 windows-1257
+    // CP1257 windows-1256 CP1256 windows-1255 CP1255 windows-1254
+    // CP1254 windows-1253 CP1253 windows-1252 CP1252 windows-1251
+    // CP1251 windows-1250 CP1250 IBM866 CP866 csIBM866 IBM874 CP874
+    // IBM850 CP850 csPC850Multilingual ISO-8859-16 iso-ir-226 latin10
+    // ISO-8859-14 iso-ir-199 latin8 iso-celtic ISO-8859-13
+    // ISO-8859-10 iso-ir-157 latin6 ISO-8859-10:1992 csISOLatin6
+    // ISO-8859-9 iso-ir-148 latin5 csISOLatin5 ISO-8859-8 ISO
+    // 8859-8-I iso-ir-138 hebrew csISOLatinHebrew ISO-8859-7 ECMA-118
+    // greek iso-ir-126 csISOLatinGreek ISO-8859-6 ISO-8859-6-I
+    // ECMA-114 ASMO-708 arabic iso-ir-127 csISOLatinArabic ISO-8859-5
+    // cyrillic iso-ir-144 csISOLatinCyrillic ISO-8859-4 latin4
+    // iso-ir-110 csISOLatin4 ISO-8859-3 latin3 iso-ir-109 csISOLatin3
+    // ISO-8859-2 latin2 iso-ir-101 csISOLatin2 KOI8-U KOI8-RU KOI8-R
+    // csKOI8R Iscii-Mlm Iscii-Knd Iscii-Tlg Iscii-Tml Iscii-Ori
+    // Iscii-Gjr Iscii-Pnj Iscii-Bng Iscii-Dev TSCII GBK gb2312.1980-0
+    // gbk-0 CP936 MS936 windows-936 jisx0201*-0 jisx0208*-0
+    // ksc5601.1987-0 cp949 Big5-HKSCS big5-0 big5hkscs-0
+
+    QSet<QString> availableCodecsQt;
+    foreach(const QByteArray &ba, QTextCodec::availableCodecs())
+        availableCodecsQt << QString(ba);
+
+    // Charsets detectable by libicu 4.4.2:
+    QStringList allDetectableCharsetsICU;
+    allDetectableCharsetsICU
+    << "UTF-8"
+    << "UTF-16BE"
+    << "UTF-16LE"
+    << "UTF-32BE"
+    << "UTF-32LE"
+    << "ISO-8859-1"
+    << "ISO-8859-2"
+    << "ISO-8859-5"
+    << "ISO-8859-6"
+    << "ISO-8859-7"
+    << "ISO-8859-8-I"
+    << "ISO-8859-8"
+    << "ISO-8859-9"
+    << "KOI8-R"
+    << "KOI8-U"
+    << "Shift_JIS"
+    << "GB18030"
+    << "EUC-JP"
+    << "EUC-KR"
+    << "Big5"
+    << "ISO-2022-JP"
+    << "ISO-2022-KR"
+    << "ISO-2022-CN"
+    << "IBM424_rtl"
+    << "IBM424_ltr"
+    << "IBM420_rtl"
+    << "IBM420_ltr"
+    << "windows-1250"
+    << "windows-1251"
+    << "windows-1252"
+    << "windows-1253"
+    << "windows-1255"
+    << "windows-1256"
+    << "windows-1254";
+
+    // The charsets detectable by libicu can be determined by
+    // ucsdet_getAllDetectableCharsets() and the documentation for
+    // that function at
+    // http://icu-project.org/apiref/icu4c/ucsdet_8h.html says:
+    //
+    //     “The state of the Charset detector that is passed in does
+    //     not affect the result of this function, but requiring a
+    //     valid, open charset detector as a parameter insures that
+    //     the charset detection service has been safely initialized
+    //     and that the required detection data is available.”
+    //
+    // but that does not seem to be completely true, in fact it
+    // *does* depend on the state of the charset detector. For example
+    // sometimes "windows-1250" *is* among the returned charsets.
+    // This happens if some non-ASCII text
+    // is in the detector and a detection is attempted and *then*
+    // ucsdet_getAllDetectableCharsets() is called.
+    // And sometimes "windows-1250" is *not* among the returned
+    // charsets. This happens when an empty charset detector is created
+    // and then ucsdet_getAllDetectableCharsets() is called.
+    // If ucsdet_getAllDetectableCharsets() has been called once
+    // the list of returned charsets never seems to change anymore,
+    // even if the text in the detector is changed again and
+    // another detection attempted which would result in a different
+    // list if ucsdet_getAllDetectableCharsets() were called first
+    // in that state.
+    //
+    // Sometimes ucsdet_getAllDetectableCharsets() reports charsets
+    // multiple times depending on the number of languages it can
+    // detect for that charsets, i.e. it may report ISO-8859-2 four
+    // times because it can detect the languages “cs”, “hu”,
+    // “pl”, and “ro” with that charset.
+    //
+    // This looks like a bug to me, to get a reliable list,
+    // I have hardcoded the complete list of charsets which
+    // ucsdet_getAllDetectableCharsets() can possibly return
+    // for all states of the detector above.
+    //
+    // Therefore, the following code should not add any extra charsets
+    // anymore, at least not for libicu 4.4.2. A detector of its own
+    // is opened for this, the result does not depend on the state of
+    // the detectors used for detection then:
+    UErrorCode status = U_ZERO_ERROR;
+    UCharsetDetector *uCharsetDetector = ucsdet_open(&status);
+    UEnumeration *en = ucsdet_getAllDetectableCharsets(uCharsetDetector, &status);
+    if (U_SUCCESS(status)) {
+        qint32 len;
+        const UChar *uc;
+        while ((uc = uenum_unext(en, &len, &status)) != NULL) {
+            if(uc && U_SUCCESS(status))
+                allDetectableCharsetsICU << QString::fromUtf16(uc, len);
+        }
+    }
+    else {
+        qWarning() << __PRETTY_FUNCTION__ << u_errorName(status);
+    }
+    uenum_close(en);
+    ucsdet_close(uCharsetDetector);
+
+    // remove all charsets not supported by QTextCodec and all duplicates:
+    MCharsetDetectorCodecTable *table = new MCharsetDetectorCodecTable;
+    foreach(const QString &cs, allDetectableCharsetsICU) {
+        if(availableCodecsQt.contains(cs) && !table->codecs.contains(cs)) {
+            QTextCodec *codec = QTextCodec::codecForName(cs.toLatin1());
+            if(codec == NULL)
+                continue;
+            table->charsets << cs;
+            table->codecs.insert(cs, codec);
+        }
+    }
+
+    qSort(table->charsets);
+
+    for(int id = MCharsetDetectorPrivate::OtherCharset + 1;
+        id < MCharsetDetectorPrivate::CharsetIdCount; ++id)
+        table->charsetIds.insert(QLatin1String(charsetIdNames[id]), id);
+
+    return table;
+}
+
+const MCharsetDetectorCodecTable *MCharsetDetectorPrivate::detectableCharsets()
+{
+    QMutexLocker locker(&codecTableMutex);
+    if(!codecTable)
+        codecTable = createCodecTable();
+    return codecTable;
+}
+
+QTextCodec *MCharsetDetectorPrivate::codecForCharset(const QString &charsetName)
+{
+    QTextCodec *codec = detectableCharsets()->codecs.value(charsetName);
+    if(codec == NULL)
+        codec = QTextCodec::codecForName(charsetName.toLatin1());
+    return codec;
+}
+
 MCharsetDetectorPrivate::MCharsetDetectorPrivate()
-    : _status(U_ZERO_ERROR),
+    : _isRawData(false),
+      _file(0),
+      _inputClass(AsciiInput),
+      _utf8Sequences(0),
+      _status(U_ZERO_ERROR),
       _uCharsetDetector(0),
+      _declaredLanguageRow(-1),
+      _declaredLanguageId(OtherLanguage),
+      _declaredTraditionalChinese(false),
+      _declaredSimplifiedChinese(false),
+      _declaredEncodingIsSingleByte(false),
+      _codecTable(0),
+      _keepDecodedText(false),
+      _sampleBudget(65536),
+      _isFeeding(false),
+      _isConclusive(false),
+      _hasCheckedBom(false),
+      _afterEscape(false),
+      _utf8Pending(0),
+      _utf8Valid(0),
+      _utf8Invalid(false),
+      _hasSampleMatches(false),
       q_ptr(0)
 {
     _uCharsetDetector = ucsdet_open(&_status);
@@ -49,7 +353,9 @@ MCharsetDetectorPrivate::MCharsetDetectorPrivate()
 
 MCharsetDetectorPrivate::~MCharsetDetectorPrivate()
 {
+    clearStream();
     ucsdet_close(_uCharsetDetector);
+    releaseFile();
 }
 
 bool MCharsetDetectorPrivate::hasError() const
@@ -70,6 +376,315 @@ QString MCharsetDetectorPrivate::errorString() const
     return QString(u_errorName(_status));
 }
 
+// Classifies the input as pure ASCII, as valid UTF-8 containing at
+// least one multibyte sequence, or as something else. NUL, SO, SI and
+// ESC are treated as “something else” because they occur in UTF-16,
+// UTF-32 and the ISO-2022 encodings. Overlong forms, surrogates and
+// noncharacters are not accepted as valid UTF-8 because QTextCodec
+// would decode them as invalid characters.
+//
+// With SSE2, runs of 16 plain ASCII bytes are skipped with a single
+// comparison, the scalar code only looks at the bytes around the
+// non-ASCII characters then.
+MCharsetDetectorPrivate::InputClass MCharsetDetectorPrivate::classifyInput(const QByteArray &ba, int *multibyteSequences)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(ba.constData());
+    const uchar *end = p + ba.size();
+    int sequences = 0;
+    if(multibyteSequences)
+        *multibyteSequences = 0;
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i so = _mm_set1_epi8(0x0E);
+    const __m128i si = _mm_set1_epi8(0x0F);
+    const __m128i esc = _mm_set1_epi8(0x1B);
+#endif
+    while(p < end) {
+#ifdef __SSE2__
+        while(end - p >= 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            // the high bit is set for bytes >= 0x80 and for the
+            // comparisons which found one of the special bytes:
+            const __m128i special
+                = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, zero),
+                                            _mm_cmpeq_epi8(chunk, esc)),
+                               _mm_or_si128(_mm_cmpeq_epi8(chunk, so),
+                                            _mm_cmpeq_epi8(chunk, si)));
+            if(_mm_movemask_epi8(_mm_or_si128(chunk, special)) != 0)
+                break;
+            p += 16;
+        }
+        if(p == end)
+            break;
+#endif
+        const uchar c = *p;
+        if(c < 0x80) {
+            if(c == 0x00 || c == 0x0E || c == 0x0F || c == 0x1B)
+                return OtherInput;
+            ++p;
+            continue;
+        }
+        int length;
+        uint codePoint;
+        uint minimum;
+        if(c >= 0xC2 && c <= 0xDF) {
+            length = 2;
+            codePoint = c & 0x1F;
+            minimum = 0x80;
+        }
+        else if(c >= 0xE0 && c <= 0xEF) {
+            length = 3;
+            codePoint = c & 0x0F;
+            minimum = 0x800;
+        }
+        else if(c >= 0xF0 && c <= 0xF4) {
+            length = 4;
+            codePoint = c & 0x07;
+            minimum = 0x10000;
+        }
+        else {
+            return OtherInput;
+        }
+        if(end - p < length)
+            return OtherInput;
+        for(int i = 1; i < length; ++i) {
+            if((p[i] & 0xC0) != 0x80)
+                return OtherInput;
+            codePoint = (codePoint << 6) | (p[i] & 0x3F);
+        }
+        if(codePoint < minimum || codePoint > 0x10FFFF
+           || (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+           || (codePoint >= 0xFDD0 && codePoint <= 0xFDEF)
+           || (codePoint & 0xFFFE) == 0xFFFE)
+            return OtherInput;
+        ++sequences;
+        p += length;
+    }
+    if(multibyteSequences)
+        *multibyteSequences = sequences;
+    return sequences > 0 ? Utf8Input : AsciiInput;
+}
+
+// Returns whether the charset decodes the ASCII bytes classified as
+// AsciiInput by classifyInput() as ASCII, i.e. whether it can decode
+// pure ASCII input without invalid characters.
+bool MCharsetDetectorPrivate::isAsciiCompatible(const QString &charsetName)
+{
+    return !charsetName.startsWith(QLatin1String("UTF-16"))
+        && !charsetName.startsWith(QLatin1String("UTF-32"))
+        && !charsetName.startsWith(QLatin1String("IBM42"));
+}
+
+// Returns the charsets which cannot decode the complete input without
+// invalid characters. Instead of decoding the whole input with one
+// charset after the other, the input is decoded in chunks with all
+// codecs side by side, keeping the state of each codec between the
+// chunks. A charset is dropped at the first chunk where it fails, so
+// the candidates which are wrong usually do not need to look at most
+// of the input, and the chunk is still in the cache for the next codec.
+//
+// If decodedText is given, charsetNames must be in the order of their
+// rank, and the text decoded by the best ranked of the first
+// textCandidates charsets which can decode the complete input is
+// stored there, its name in decodedTextCharset. Only the text of the
+// best ranked charset still decoding without error is kept, if that
+// fails the text of the next one is decoded again from the start. So
+// at most one decoded text is held at a time, the single byte
+// charsets which are usually all candidates rarely fail anyway.
+QStringList MCharsetDetectorPrivate::undecodableCharsets(const QStringList &charsetNames,
+                                                         int textCandidates,
+                                                         QString *decodedText,
+                                                         QString *decodedTextCharset) const
+{
+    const int chunkSize = 64 * 1024;
+    QStringList undecodable;
+    QStringList names;
+    QList<int> ranks;
+    QList<QTextCodec *> codecs;
+    QList<QTextCodec::ConverterState *> states;
+    for(int rank = 0; rank < charsetNames.size(); ++rank) {
+        const QString &name = charsetNames.at(rank);
+        QTextCodec *codec = codecForCharset(name);
+        if(codec == NULL) {
+            undecodable << name;
+            continue;
+        }
+        names << name;
+        ranks << rank;
+        codecs << codec;
+        states << new QTextCodec::ConverterState;
+    }
+    // the rank of the charset the text was decoded with, -1 if none:
+    QString text;
+    int textRank = -1;
+    for(int offset = 0; offset < _ba.size() && !codecs.isEmpty(); offset += chunkSize) {
+        const int size = qMin(chunkSize, _ba.size() - offset);
+        for(int i = 0; i < codecs.size();) {
+            const QString chunk
+                = codecs.at(i)->toUnicode(_ba.constData() + offset, size, states.at(i));
+            if(states.at(i)->invalidChars > 0) {
+                if(ranks.at(i) == textRank) {
+                    text.clear();
+                    textRank = -1;
+                }
+                undecodable << names.takeAt(i);
+                ranks.removeAt(i);
+                codecs.removeAt(i);
+                delete states.takeAt(i);
+                continue;
+            }
+            // the remaining charsets stay in the order of their rank,
+            // the first one is the best ranked:
+            if(decodedText && i == 0 && ranks.at(0) < textCandidates) {
+                if(textRank != ranks.at(0)) {
+                    // the charset the text was kept for has failed,
+                    // decode the input before this chunk again:
+                    QTextCodec::ConverterState state;
+                    text = codecs.at(0)->toUnicode(_ba.constData(), offset, &state);
+                    textRank = ranks.at(0);
+                }
+                text += chunk;
+            }
+            ++i;
+        }
+    }
+    qDeleteAll(states);
+    if(decodedText) {
+        decodedText->clear();
+        decodedTextCharset->clear();
+        if(textRank >= 0) {
+            *decodedText = text;
+            *decodedTextCharset = names.first();
+        }
+    }
+    return undecodable;
+}
+
+void MCharsetDetectorPrivate::setIcuText()
+{
+    // libicu does not detect short input well, short input is
+    // repeated until it has at least 50 bytes. Only that copy is
+    // made, longer input is used as it is (sharing the data of _ba).
+    _baExtended = _ba;
+    if (!_ba.isEmpty() && _ba.size() < 50) {
+        _baExtended.reserve((50 / _ba.size() + 1) * _ba.size());
+        while (_baExtended.size() < 50)
+            _baExtended += _ba;
+    }
+    _inputClass = classifyInput(_ba, &_utf8Sequences);
+    // libicu only gets the input up to the first NUL byte, like a
+    // length of -1 would do, but the raw data of _ba need not be
+    // terminated by a NUL byte:
+    const char *end = static_cast<const char *>(
+        memchr(_baExtended.constData(), '\0', _baExtended.size()));
+    const int32_t length = end ? int32_t(end - _baExtended.constData()) : _baExtended.size();
+    ucsdet_setText(_uCharsetDetector, _baExtended.constData(), length, &_status);
+    if(hasError())
+        qWarning() << __PRETTY_FUNCTION__ << errorString();
+}
+
+// unmaps and closes the file set by setFile(), the input must have
+// been replaced before
+void MCharsetDetectorPrivate::releaseFile()
+{
+    if(_file) {
+        _file->close();
+        delete _file;
+        _file = 0;
+    }
+}
+
+void MCharsetDetectorPrivate::clearStream()
+{
+    _isFeeding = false;
+    _isConclusive = false;
+    _hasCheckedBom = false;
+    _afterEscape = false;
+    _utf8Pending = 0;
+    _utf8Valid = 0;
+    _utf8Invalid = false;
+    _hasSampleMatches = false;
+    _sampleMatches.clear();
+    _restCharsets.clear();
+    _restCodecs.clear();
+    qDeleteAll(_restStates);
+    _restStates.clear();
+}
+
+// looks for conclusive evidence in the sample: a byte order mark, an
+// ISO-2022 escape sequence switching to a multibyte charset or at
+// least 16 UTF-8 multibyte sequences without any invalid UTF-8.
+// libicu already reports UTF-8 with confidence 100 for more than 3
+// such sequences, requiring more makes it very unlikely that input in
+// a legacy multibyte encoding is taken for UTF-8.
+void MCharsetDetectorPrivate::scanSample(const char *data, int size)
+{
+    for(int i = 0; i < size; ++i) {
+        const uchar c = data[i];
+        if(_afterEscape && c == '$')
+            _isConclusive = true;
+        _afterEscape = (c == 0x1B);
+        if(_utf8Pending > 0) {
+            if((c & 0xC0) == 0x80) {
+                if(--_utf8Pending == 0)
+                    ++_utf8Valid;
+                continue;
+            }
+            _utf8Invalid = true;
+            _utf8Pending = 0;
+        }
+        if(c < 0x80)
+            continue;
+        else if(c >= 0xC2 && c <= 0xDF)
+            _utf8Pending = 1;
+        else if(c >= 0xE0 && c <= 0xEF)
+            _utf8Pending = 2;
+        else if(c >= 0xF0 && c <= 0xF4)
+            _utf8Pending = 3;
+        else
+            _utf8Invalid = true;
+    }
+    if(!_hasCheckedBom && _ba.size() >= 4) {
+        _hasCheckedBom = true;
+        const uchar *bytes = reinterpret_cast<const uchar *>(_ba.constData());
+        if((bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF)
+           || (bytes[0] == 0xFE && bytes[1] == 0xFF)
+           || (bytes[0] == 0xFF && bytes[1] == 0xFE)
+           || (bytes[0] == 0x00 && bytes[1] == 0x00 && bytes[2] == 0xFE && bytes[3] == 0xFF))
+            _isConclusive = true;
+    }
+    if(_utf8Valid >= 16 && !_utf8Invalid)
+        _isConclusive = true;
+}
+
+// checks the input after the sample with the codecs of the matches
+// found in the sample, the matches for charsets which fail are removed
+void MCharsetDetectorPrivate::checkRest(const char *data, int size)
+{
+    const int chunkSize = 64 * 1024;
+    for(int offset = 0; offset < size && !_restCodecs.isEmpty(); offset += chunkSize) {
+        const int length = qMin(chunkSize, size - offset);
+        for(int i = 0; i < _restCodecs.size();) {
+            _restCodecs.at(i)->toUnicode(data + offset, length, _restStates.at(i));
+            if(_restStates.at(i)->invalidChars > 0) {
+                const QString name = _restCharsets.takeAt(i);
+                _restCodecs.removeAt(i);
+                delete _restStates.takeAt(i);
+                QList<MCharsetMatch>::iterator it = _sampleMatches.begin();
+                while(it != _sampleMatches.end()) {
+                    if((*it).name() == name)
+                        it = _sampleMatches.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            else {
+                ++i;
+            }
+        }
+    }
+}
+
 MCharsetDetector::MCharsetDetector()
     : d_ptr(new MCharsetDetectorPrivate)
 {
@@ -128,14 +743,140 @@ void MCharsetDetector::setText(const QByteArray &ba)
 {
     Q_D(MCharsetDetector);
     clearError();
+    d->clearStream();
     d->_ba = ba;
-    d->_baExtended = ba;
-    if (!ba.isEmpty())
-        while (d->_baExtended.size() < 50)
-            d->_baExtended += d->_ba;
-    ucsdet_setText(d->_uCharsetDetector, d->_baExtended.constData(), int32_t(-1), &(d->_status));
-    if(hasError())
-        qWarning() << __PRETTY_FUNCTION__ << errorString();
+    d->_isRawData = false;
+    d->setIcuText();
+    d->releaseFile();
+}
+
+void MCharsetDetector::setRawData(const char *data, int size)
+{
+    Q_D(MCharsetDetector);
+    clearError();
+    d->clearStream();
+    d->_ba = QByteArray::fromRawData(data, qMax(size, 0));
+    d->_isRawData = true;
+    d->setIcuText();
+    d->releaseFile();
+}
+
+bool MCharsetDetector::setFile(const QString &fileName)
+{
+    Q_D(MCharsetDetector);
+    QFile *file = new QFile(fileName);
+    if(!file->open(QIODevice::ReadOnly)) {
+        delete file;
+        setText(QByteArray());
+        d->_status = U_FILE_ACCESS_ERROR;
+        qWarning() << __PRETTY_FUNCTION__
+                   << "cannot open" << fileName << errorString();
+        return false;
+    }
+    if(file->size() == 0) {
+        // empty files cannot be mapped
+        delete file;
+        setText(QByteArray());
+        return true;
+    }
+    if(file->size() > INT_MAX) {
+        delete file;
+        setText(QByteArray());
+        d->_status = U_BUFFER_OVERFLOW_ERROR;
+        qWarning() << __PRETTY_FUNCTION__
+                   << "file too large" << fileName << errorString();
+        return false;
+    }
+    const uchar *data = file->map(0, file->size());
+    if(data == NULL) {
+        delete file;
+        setText(QByteArray());
+        d->_status = U_FILE_ACCESS_ERROR;
+        qWarning() << __PRETTY_FUNCTION__
+                   << "cannot map" << fileName << errorString();
+        return false;
+    }
+    setRawData(reinterpret_cast<const char *>(data), int(file->size()));
+    d->_file = file;
+    return true;
+}
+
+bool MCharsetDetector::feed(const char *data, int size)
+{
+    Q_D(MCharsetDetector);
+    clearError();
+    if(!d->_isFeeding) {
+        d->clearStream();
+        d->_ba.clear();
+        d->_baExtended.clear();
+        d->_isRawData = false;
+        d->releaseFile();
+        d->_isFeeding = true;
+    }
+    if(d->_isConclusive)
+        return false;
+    if(!data || size <= 0)
+        return true;
+    if(!d->_hasSampleMatches) {
+        const int sampleSize = qMin(size, qMax(d->_sampleBudget - d->_ba.size(), 0));
+        d->_ba.append(data, sampleSize);
+        d->scanSample(data, sampleSize);
+        if(d->_isConclusive)
+            return false;
+        if(d->_ba.size() < d->_sampleBudget)
+            return true;
+        // the sample is full, detect it now and check only the
+        // matches found against the rest of the input:
+        d->setIcuText();
+        d->_sampleMatches = detectAll();
+        clearError();
+        d->_hasSampleMatches = true;
+        foreach(const MCharsetMatch &match, d->_sampleMatches) {
+            if(d->_restCharsets.contains(match.name()))
+                continue;
+            QTextCodec *codec = MCharsetDetectorPrivate::codecForCharset(match.name());
+            if(codec == NULL)
+                continue;
+            // continue with the state after the sample, a multibyte
+            // sequence may continue in the rest of the input:
+            QTextCodec::ConverterState *state = new QTextCodec::ConverterState;
+            codec->toUnicode(d->_ba.constData(), d->_ba.size(), state);
+            d->_restCharsets << match.name();
+            d->_restCodecs << codec;
+            d->_restStates << state;
+        }
+        data += sampleSize;
+        size -= sampleSize;
+    }
+    d->checkRest(data, size);
+    return true;
+}
+
+void MCharsetDetector::finish()
+{
+    Q_D(MCharsetDetector);
+    clearError();
+    if(!d->_isFeeding)
+        return;
+    d->_isFeeding = false;
+    if(!d->_hasSampleMatches)
+        d->setIcuText();
+    d->_restCharsets.clear();
+    d->_restCodecs.clear();
+    qDeleteAll(d->_restStates);
+    d->_restStates.clear();
+}
+
+void MCharsetDetector::setSampleBudget(int bytes)
+{
+    Q_D(MCharsetDetector);
+    d->_sampleBudget = qMax(bytes, 1);
+}
+
+int MCharsetDetector::sampleBudget() const
+{
+    Q_D(const MCharsetDetector);
+    return d->_sampleBudget;
 }
 
 MCharsetMatch MCharsetDetector::detect()
@@ -169,6 +910,35 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
 {
     Q_D(MCharsetDetector);
     clearError();
+    if(d->_hasSampleMatches && !d->_isFeeding) {
+        // the input was fed with feed() and the matches were already
+        // detected in the sample and checked against the rest:
+        if(d->_sampleMatches.isEmpty()) {
+            d->_status = U_CE_NOT_FOUND_ERROR;
+            qWarning() << __PRETTY_FUNCTION__
+                       << "number of matches found=0"
+                       << errorString();
+        }
+        return d->_sampleMatches;
+    }
+    if(d->_inputClass == MCharsetDetectorPrivate::Utf8Input
+       && !d->_isFeeding
+       && !ucsdet_isInputFilterEnabled(d->_uCharsetDetector)) {
+        // The input is valid UTF-8 and contains non-ASCII
+        // characters. libicu would return UTF-8 with confidence 100
+        // if there is a BOM or more than 3 multibyte sequences (in
+        // the extended input it sees), otherwise 80 which is
+        // increased to 99 below. No other match could beat that,
+        // therefore return it right away without running the
+        // detection and the decoding checks for the other charsets.
+        // A sample fed with feed() still uses the complete
+        // detection, the rest of the input may not be UTF-8.
+        const int copies = d->_baExtended.size() / d->_ba.size();
+        qint32 confidence = 99;
+        if(d->_ba.startsWith("\xef\xbb\xbf") || d->_utf8Sequences * copies > 3)
+            confidence = 100;
+        return QList<MCharsetMatch>() << MCharsetMatch("UTF-8", "", confidence);
+    }
     // get list of matches from ICU:
     qint32 matchesFound;
     const UCharsetMatch **uCharsetMatch
@@ -207,8 +977,8 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
         }
         mCharsetMatchList << mCharsetMatch;
     }
-    if(d->_allDetectableCharsets.isEmpty())
-        getAllDetectableCharsets();
+    if(d->_codecTable == NULL)
+        d->_codecTable = MCharsetDetectorPrivate::detectableCharsets();
     // libicu sometimes does not detect single byte encodings at all
     // even if they can encode the input without error. This seems to
     // contradict the documentation on
@@ -226,86 +996,37 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
     // the list of matches with the confidence value of 10. If it
     // cannot encode the complete input, the iteration over the list
     // of matches will detect that and remove it again.
-    if(!d->_declaredEncoding.isEmpty()
-        && (d->_declaredEncoding.startsWith(QLatin1String("ISO-8859-"))
-            || d->_declaredEncoding.startsWith(QLatin1String("windows-12"))
-            || d->_declaredEncoding.startsWith(QLatin1String("KOI8"))))
-            mCharsetMatchList << MCharsetMatch(d->_declaredEncoding, "", 10);
+    if(d->_declaredEncodingIsSingleByte)
+        mCharsetMatchList << MCharsetMatch(d->_declaredEncoding, "", 10);
     // Similar as for declaredEncoding, when declaredLocale is used
     // and it is a locale where the legacy encoding is a single byte
     // encoding, it should at least be tried, therefore add the legacy
-    // single byte encoding for the declared locale here.  If it
-    // cannot encode the complete input, it will be removed again
-    // later.  Multibyte encodings like Shift_JIS, EUC-JP, Big5,
-    // etc. ...  do not need to be added, contrary to the single byte
-    // encodings I could find no case where the matches returned by
-    // libicu did omit a multibyte encoding when it should have been
-    // included.
-    if(!d->_declaredLocale.isEmpty()) {
-        QString language = d->_declaredLocale.left(2);
-        if(language ==  QLatin1String("ru")) {
-            mCharsetMatchList << MCharsetMatch("KOI8-R", language, 10);
-            mCharsetMatchList << MCharsetMatch("windows-1251", language, 10);
-            mCharsetMatchList << MCharsetMatch("ISO-8859-5", language, 10);
-        }
-        else if(language ==  QLatin1String("uk")) {
-            mCharsetMatchList << MCharsetMatch("KOI8-U", language, 10);
-            mCharsetMatchList << MCharsetMatch("windows-1251", language, 10);
-            // ISO 8859-5 encoding is missing the letter ґ needed for
-            // Ukrainian, i.e. ISO 8859-5 should not occur for Ukrainian
-        }
-        else if(language == QLatin1String("tr"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-9", language, 10);
-        else if(language == QLatin1String("el"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-7", language, 10);
-        else if(language == QLatin1String("en")
-                || language == QLatin1String("da")
-                || language == QLatin1String("de")
-                || language == QLatin1String("es")
-                || language == QLatin1String("fi")
-                || language == QLatin1String("fr")
-                || language == QLatin1String("it")
-                || language == QLatin1String("nl")
-                || language == QLatin1String("no")
-                || language == QLatin1String("nn")
-                || language == QLatin1String("nb")
-                || language == QLatin1String("pt")
-                || language == QLatin1String("sv"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-1", language, 10);
-        else if(language == QLatin1String("cs")
-                || language == QLatin1String("hu")
-                || language == QLatin1String("pl")
-                || language == QLatin1String("ro"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-1", language, 10);
-        else if(language == QLatin1String("ar")
-                || language == QLatin1String("fa")
-                || language == QLatin1String("ur"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-6", language, 10);
-        else if(language == QLatin1String("he"))
-            mCharsetMatchList << MCharsetMatch("ISO-8859-8", language, 10);
+    // single byte encodings for the declared locale here (see
+    // languageTable).  If it cannot encode the complete input, it
+    // will be removed again later.
+    if(d->_declaredLanguageRow >= 0) {
+        const MCharsetDetectorLanguage &row = languageTable[d->_declaredLanguageRow];
+        for(int i = 0; i < 3 && row.legacyCharsets[i] != MCharsetDetectorPrivate::OtherCharset; ++i)
+            mCharsetMatchList << MCharsetMatch(QLatin1String(charsetIdNames[row.legacyCharsets[i]]),
+                                               d->_declaredLanguage, 10);
     }
     // iterate over the detected matches and do some fine tuning:
     bool sortNeeded = false;
-    qint32 koi8rConfidence = 0;
-    qint32 koi8uConfidence = 0;
-    qint32 iso88595Confidence = 0;
-    qint32 windows1251Confidence = 0;
+    // the confidences of the matches so far, summed up per charset:
+    qint32 accumulatedConfidences[MCharsetDetectorPrivate::CharsetIdCount];
+    for(int i = 0; i < MCharsetDetectorPrivate::CharsetIdCount; ++i)
+        accumulatedConfidences[i] = 0;
     QList<MCharsetMatch>::iterator it = mCharsetMatchList.begin();
     while(it != mCharsetMatchList.end()) {
-        if((*it).name() == QLatin1String("KOI8-R"))
-            koi8rConfidence += (*it).confidence();
-        if((*it).name() == QLatin1String("KOI8-U"))
-            koi8uConfidence += (*it).confidence();
-        if((*it).name() == QLatin1String("ISO-8859-5"))
-            iso88595Confidence += (*it).confidence();
-        if((*it).name() == QLatin1String("windows-1251"))
-            windows1251Confidence += (*it).confidence();
-        if((*it).name() == QLatin1String("ISO-2022-JP")) {
+        const int charset = d->_codecTable->charsetIds.value(
+            (*it).name(), MCharsetDetectorPrivate::OtherCharset);
+        accumulatedConfidences[charset] += (*it).confidence();
+        if(charset == MCharsetDetectorPrivate::Iso2022jpCharset) {
             // non-Japanese text in ISO-2022-JP encoding is possible
             // but very unlikely:
             (*it).setLanguage("ja");
         }
-        if((*it).name() == QLatin1String("UTF-8")
+        if(charset == MCharsetDetectorPrivate::Utf8Charset
            && (*it).confidence() >= 80 && (*it).confidence() < 99) {
             // Actually libicu currently only returns confidence
             // values of 100, 80, 25, and 10 for UTF-8.  A value of 80
@@ -361,7 +1082,8 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
             // encoding.  Use a slightly lower value than for the
             // declared encoding. Setting the declared encoding
             // is more precise and should have somewhat higher priority
-            if(d->_declaredLocale.startsWith("ru")) {
+            if(d->_declaredLanguageId == MCharsetDetectorPrivate::RussianLanguage
+               || d->_declaredLanguageId == MCharsetDetectorPrivate::UkrainianLanguage) {
                 // Treat the Russian setDeclaredLocale("ru") case a
                 // bit different than the single byte encodings for
                 // other languages: Only increase the weight of
@@ -394,57 +1116,30 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
                 // ISO-8859-5 but 21 to the confidence for
                 // windows-1251 to prefer windows-1251 a little bit
                 // over ISO-8859-5.
-                if((*it).name() == QLatin1String("KOI8-R")
-                   && koi8rConfidence > 10 && koi8rConfidence < 30)
-                    (*it).setConfidence(20 + koi8rConfidence);
-                else if((*it).name() == QLatin1String("ISO-8859-5")
-                   && iso88595Confidence > 10 && iso88595Confidence < 30)
-                    (*it).setConfidence(20 + iso88595Confidence);
-                else if((*it).name() == QLatin1String("windows-1251")
-                   && windows1251Confidence > 10 && windows1251Confidence < 30)
-                    (*it).setConfidence(21 + windows1251Confidence);
-            }
-            else if(d->_declaredLocale.startsWith("uk")) {
-                // Treat the Ukrainian setDeclaredLocale("uk") case a
-                // bit different than the single byte encodings for
-                // Russian.
                 //
-                // If the setDeclareLocale("uk") has been used, the
-                // accumulated confidence for the Ukrainian single byte
-                // encoding is 10 (because of setDeclaredLocale("uk"))
-                // plus whatever libicu has detected. If libicu has
-                // not detected anything, the accumulated confidence
-                // is exactly 10 here and there is no way to
-                // distinguish between the Ukrainian legacy
-                // encodings. Therefore, don’t increase the confidence
-                // if the accumulated confidence is not > 10.
-                //
-                // But if libicu has detected something with small
-                // confidence, the accumulated confidence is 10 plus
-                // something small. In that case, adding something
-                // around 20 seems to work reasonably well.
-                //
-                // I add 20 to the confidence for KOI8-U but 25 to the
-                // confidence for windows-1251 to prefer windows-1251
-                // over KOI8-U.
-                if((*it).name() == QLatin1String("KOI8-U")
-                   && koi8uConfidence > 10 && koi8uConfidence < 30)
-                    (*it).setConfidence(20 + koi8uConfidence);
-                else if((*it).name() == QLatin1String("windows-1251")
-                   && windows1251Confidence > 10 && windows1251Confidence < 30)
-                    (*it).setConfidence(25 + windows1251Confidence);
+                // The Ukrainian setDeclaredLocale("uk") case works the
+                // same way, but 20 is added to the confidence for
+                // KOI8-U and 25 to the confidence for windows-1251 to
+                // prefer windows-1251 over KOI8-U. The offsets are in
+                // confidenceOffsets.
+                const int offsets = sizeof(confidenceOffsets) / sizeof(confidenceOffsets[0]);
+                for(int i = 0; i < offsets; ++i) {
+                    if(confidenceOffsets[i].language != d->_declaredLanguageId
+                       || confidenceOffsets[i].charset != charset)
+                        continue;
+                    const qint32 accumulated = accumulatedConfidences[charset];
+                    if(accumulated > 10 && accumulated < 30)
+                        (*it).setConfidence(confidenceOffsets[i].offset + accumulated);
+                    break;
+                }
             }
-            else if((d->_declaredLocale.contains("TW")
-                || d->_declaredLocale.contains("HK")
-                || d->_declaredLocale.contains("MO"))
-               && (*it).name() == QLatin1String("Big5")) {
+            else if(d->_declaredTraditionalChinese
+                    && charset == MCharsetDetectorPrivate::Big5Charset) {
                  // Traditional Chinese, Big5 more likely
                 (*it).setConfidence(39);
             }
-            else if((d->_declaredLocale.contains("CN")
-                     || d->_declaredLocale.contains("SG")
-                     || d->_declaredLocale == "zh")
-                    && (*it).name() == QLatin1String("GB18030")) {
+            else if(d->_declaredSimplifiedChinese
+                    && charset == MCharsetDetectorPrivate::Gb18030Charset) {
                 // Simplified Chinese, GB18030/GB2312 more likely.
                 // Simplified Chinese is also assumed if only “zh”
                 // is set. If the variant is unknown, simplified
@@ -462,26 +1157,51 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
             }
             sortNeeded = true;
         }
-        if(!d->_allDetectableCharsets.contains((*it).name())) {
+        if(!d->_codecTable->codecs.contains((*it).name())) {
             // remove matches for charsets not supported by QTextCodec
             // then it is probably some weird charset we cannot use anyway
             it = mCharsetMatchList.erase(it);
         }
         else {
-            // test whether the complete input text can be encoded
-            // using this match, if not remove the match
-            clearError();
-            text(*it);
-            if(hasError()) {
-                // qDebug() << __PRETTY_FUNCTION__
-                //          << "removing match" << (*it).name()
-                //          << "because it cannot encode the complete input"
-                //          << errorString();
-                it = mCharsetMatchList.erase(it);
-                clearError();
-            }
-            else
-                ++it;
+            ++it;
+        }
+    }
+    // test whether the complete input text can be decoded with the
+    // matches, all at once. The fine tuning does not depend on that,
+    // so the charsets are checked in the order of their rank, which
+    // lets detectAndDecode() keep only the text of the best one.
+    // (pure ASCII input is decoded without error by all ASCII
+    // compatible charsets, no need to check these, and none ranked
+    // below the first of them can be the best match):
+    QList<MCharsetMatch> rankedMatches = mCharsetMatchList;
+    qStableSort(rankedMatches.begin(), rankedMatches.end(), qGreater<MCharsetMatch>());
+    QStringList candidateCharsets;
+    int textCandidates = -1;
+    foreach(const MCharsetMatch &match, rankedMatches) {
+        if(d->_inputClass == MCharsetDetectorPrivate::AsciiInput
+           && MCharsetDetectorPrivate::isAsciiCompatible(match.name())) {
+            if(textCandidates < 0)
+                textCandidates = candidateCharsets.size();
+            continue;
+        }
+        if(!candidateCharsets.contains(match.name()))
+            candidateCharsets << match.name();
+    }
+    if(textCandidates < 0)
+        textCandidates = candidateCharsets.size();
+    const QStringList undecodableCharsets
+        = d->undecodableCharsets(candidateCharsets, textCandidates,
+                                 d->_keepDecodedText ? &d->_decodedText : 0,
+                                 &d->_decodedTextCharset);
+    it = mCharsetMatchList.begin();
+    while(it != mCharsetMatchList.end()) {
+        if(undecodableCharsets.contains((*it).name())) {
+            // the complete input text cannot be decoded using this
+            // match, remove the match
+            it = mCharsetMatchList.erase(it);
+        }
+        else {
+            ++it;
         }
     }
     // sort the list of matches again if confidences have been changed:
@@ -499,12 +1219,178 @@ QList<MCharsetMatch> MCharsetDetector::detectAll()
     return mCharsetMatchList;
 }
 
+MCharsetMatch MCharsetDetector::detectAndDecode(QString *text)
+{
+    Q_D(MCharsetDetector);
+    d->_keepDecodedText = true;
+    d->_decodedText.clear();
+    d->_decodedTextCharset.clear();
+    MCharsetMatch bestMatch = detect();
+    d->_keepDecodedText = false;
+    QString decodedText;
+    if(!hasError()) {
+        // use the text decoded while checking the matches if there
+        // is one, the check is skipped for some input, see detectAll():
+        if(d->_decodedTextCharset == bestMatch.name())
+            decodedText = d->_decodedText;
+        else
+            decodedText = this->text(bestMatch);
+    }
+    d->_decodedText.clear();
+    d->_decodedTextCharset.clear();
+    if(text)
+        *text = decodedText;
+    return bestMatch;
+}
+
+MCharsetMatch MCharsetDetector::detectAndDecodeToUtf8(QByteArray *utf8)
+{
+    Q_D(MCharsetDetector);
+    d->_keepDecodedText = true;
+    d->_decodedText.clear();
+    d->_decodedTextCharset.clear();
+    MCharsetMatch bestMatch = detect();
+    d->_keepDecodedText = false;
+    QByteArray result;
+    if(!hasError()) {
+        if(bestMatch.name() == QLatin1String("UTF-8") && !d->_hasSampleMatches) {
+            // the input is valid UTF-8 already, no need to decode it
+            // at all, only the byte order mark is removed like
+            // text() does (a sample kept by feed() may end in the
+            // middle of a character though):
+            if(d->_ba.startsWith("\xef\xbb\xbf"))
+                result = d->_ba.mid(3);
+            else if(d->_isRawData)
+                result = QByteArray(d->_ba.constData(), d->_ba.size());
+            else
+                result = d->_ba;
+        }
+        else if(d->_decodedTextCharset == bestMatch.name()) {
+            result = d->_decodedText.toUtf8();
+        }
+        else {
+            result = text(bestMatch).toUtf8();
+        }
+    }
+    d->_decodedText.clear();
+    d->_decodedTextCharset.clear();
+    if(utf8)
+        *utf8 = result;
+    return bestMatch;
+}
+
+// detects the inputs of a batch, one after the other, with one
+// detector for all of them. The tasks of a batch take the next input
+// which is not yet taken by any other task from a shared counter,
+// that spreads the work evenly even if the sizes of the inputs
+// differ a lot.
+class MCharsetDetectorBatchTask : public QRunnable
+{
+public:
+    MCharsetDetectorBatchTask(const QList<QByteArray> *buffers, const QStringList *fileNames,
+                              const QString &declaredLocale, const QString &declaredEncoding,
+                              QAtomicInt *next, QVector<MCharsetMatch> *results)
+        : _buffers(buffers), _fileNames(fileNames),
+          _declaredLocale(declaredLocale), _declaredEncoding(declaredEncoding),
+          _next(next), _results(results)
+    {
+    }
+
+    void run()
+    {
+        const int chunkSize = 64 * 1024;
+        MCharsetDetector detector;
+        detector.setDeclaredLocale(_declaredLocale);
+        detector.setDeclaredEncoding(_declaredEncoding);
+        QByteArray chunk;
+        for (int i = _next->fetchAndAddRelaxed(1); i < _results->size();
+             i = _next->fetchAndAddRelaxed(1)) {
+            if (_buffers) {
+                detector.setText(_buffers->at(i));
+            }
+            else {
+                QFile file(_fileNames->at(i));
+                if (!file.open(QIODevice::ReadOnly)) {
+                    qWarning() << __PRETTY_FUNCTION__ << "cannot open" << _fileNames->at(i);
+                    continue;
+                }
+                // the file may be empty, do not detect the previous
+                // input again then:
+                detector.setText(QByteArray());
+                chunk.resize(chunkSize);
+                qint64 size;
+                while ((size = file.read(chunk.data(), chunkSize)) > 0) {
+                    if (!detector.feed(chunk.constData(), int(size)))
+                        break;
+                }
+                detector.finish();
+            }
+            MCharsetMatch bestMatch = detector.detect();
+            if (!detector.hasError())
+                (*_results)[i] = bestMatch;
+        }
+    }
+
+private:
+    const QList<QByteArray> *_buffers;
+    const QStringList *_fileNames;
+    QString _declaredLocale;
+    QString _declaredEncoding;
+    QAtomicInt *_next;
+    QVector<MCharsetMatch> *_results;
+};
+
+QList<MCharsetMatch> MCharsetDetectorPrivate::detectBatch(const QList<QByteArray> *buffers,
+                                                          const QStringList *fileNames,
+                                                          const QString &declaredLocale,
+                                                          const QString &declaredEncoding,
+                                                          int threads)
+{
+    const int size = buffers ? buffers->size() : fileNames->size();
+    if (size == 0)
+        return QList<MCharsetMatch>();
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qBound(1, threads, size);
+
+    QVector<MCharsetMatch> results(size);
+    QAtomicInt next(0);
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    // libicu charset detectors must not be shared between threads,
+    // therefore each task uses its own:
+    for (int i = 0; i < threads; ++i)
+        pool.start(new MCharsetDetectorBatchTask(buffers, fileNames,
+                                                 declaredLocale, declaredEncoding,
+                                                 &next, &results));
+    pool.waitForDone();
+    return results.toList();
+}
+
+QList<MCharsetMatch> MCharsetDetector::detectBuffers(const QList<QByteArray> &buffers,
+                                                     const QString &declaredLocale,
+                                                     const QString &declaredEncoding,
+                                                     int threads)
+{
+    return MCharsetDetectorPrivate::detectBatch(&buffers, 0,
+                                                declaredLocale, declaredEncoding, threads);
+}
+
+QList<MCharsetMatch> MCharsetDetector::detectFiles(const QStringList &fileNames,
+                                                   const QString &declaredLocale,
+                                                   const QString &declaredEncoding,
+                                                   int threads)
+{
+    return MCharsetDetectorPrivate::detectBatch(0, &fileNames,
+                                                declaredLocale, declaredEncoding, threads);
+}
+
 QString MCharsetDetector::text(const MCharsetMatch &charsetMatch)
 {
     Q_D(MCharsetDetector);
     clearError();
     QTextCodec *codec
-        = QTextCodec::codecForName(charsetMatch.name().toLatin1());
+        = MCharsetDetectorPrivate::codecForCharset(charsetMatch.name());
     if (codec == NULL) { // there is no codec matching the name
         d->_status = U_ILLEGAL_ARGUMENT_ERROR;
         qWarning() << __PRETTY_FUNCTION__
@@ -528,6 +1414,25 @@ void MCharsetDetector::setDeclaredLocale(const QString &locale)
     Q_D(MCharsetDetector);
     clearError();
     d->_declaredLocale = locale;
+    d->_declaredLanguage = locale.left(2);
+    d->_declaredLanguageRow = -1;
+    d->_declaredLanguageId = MCharsetDetectorPrivate::OtherLanguage;
+    if(!locale.isEmpty()) {
+        const int rows = sizeof(languageTable) / sizeof(languageTable[0]);
+        for(int row = 0; row < rows; ++row) {
+            if(d->_declaredLanguage == QLatin1String(languageTable[row].language)) {
+                d->_declaredLanguageRow = row;
+                d->_declaredLanguageId = languageTable[row].id;
+                break;
+            }
+        }
+    }
+    d->_declaredTraditionalChinese = locale.contains("TW")
+        || locale.contains("HK")
+        || locale.contains("MO");
+    d->_declaredSimplifiedChinese = locale.contains("CN")
+        || locale.contains("SG")
+        || locale == "zh";
 }
 
 void MCharsetDetector::setDeclaredEncoding(const QString &encoding)
@@ -537,6 +1442,10 @@ void MCharsetDetector::setDeclaredEncoding(const QString &encoding)
     d->_declaredEncoding = encoding;
     if (d->_declaredEncoding == QLatin1String("GB2312"))
         d->_declaredEncoding = QLatin1String("GB18030");
+    d->_declaredEncodingIsSingleByte
+        = d->_declaredEncoding.startsWith(QLatin1String("ISO-8859-"))
+        || d->_declaredEncoding.startsWith(QLatin1String("windows-12"))
+        || d->_declaredEncoding.startsWith(QLatin1String("KOI8"));
     ucsdet_setDeclaredEncoding(d->_uCharsetDetector,
                                d->_declaredEncoding.toLatin1().constData(),
                                int32_t(-1),
@@ -548,140 +1457,9 @@ void MCharsetDetector::setDeclaredEncoding(const QString &encoding)
 QStringList MCharsetDetector::getAllDetectableCharsets()
 {
     Q_D(MCharsetDetector);
-
-    if (!d->_allDetectableCharsets.isEmpty())
-        return d->_allDetectableCharsets;
-
-    // Codecs supported by QTextCodec (Qt 4.7):
-    //
-    // ISO-2022-JP JIS7 EUC-KR GB2312 Big5 Big5-ETen CP950 GB18030
-    // EUC-JP Shift_JIS SJIS MS_Kanji System UTF-8 ISO-8859-1 latin1
-    // CP819 IBM819 iso-ir-100 csISOLatin1 ISO-8859-15 latin9 UTF-32LE
-    // UTF-32BE UTF-32 UTF-16LE UTF-16BE UTF-16 mulelao-1 roman8
-    // hp-roman8 csHPRoman8 TIS-620 ISO 8859-11 WINSAMI2 WS2 Apple
-    // Roman macintosh MacRoman windows-1258 CP1258 windows-1257
-    // CP1257 windows-1256 CP1256 windows-1255 CP1255 windows-1254
-    // CP1254 windows-1253 CP1253 windows-1252 CP1252 windows-1251
-    // CP1251 windows-1250 CP1250 IBM866 CP866 csIBM866 IBM874 CP874
-    // IBM850 CP850 csPC850Multilingual ISO-8859-16 iso-ir-226 latin10
-    // ISO-8859-14 iso-ir-199 latin8 iso-celtic ISO-8859-13
-    // ISO-8859-10 iso-ir-157 latin6 ISO-8859-10:1992 csISOLatin6
-    // ISO-8859-9 iso-ir-148 latin5 csISOLatin5 ISO-8859-8 ISO
-    // 8859-8-I iso-ir-138 hebrew csISOLatinHebrew ISO-8859-7 ECMA-118
-    // greek iso-ir-126 csISOLatinGreek ISO-8859-6 ISO-8859-6-I
-    // ECMA-114 ASMO-708 arabic iso-ir-127 csISOLatinArabic ISO-8859-5
-    // cyrillic iso-ir-144 csISOLatinCyrillic ISO-8859-4 latin4
-    // iso-ir-110 csISOLatin4 ISO-8859-3 latin3 iso-ir-109 csISOLatin3
-    // ISO-8859-2 latin2 iso-ir-101 csISOLatin2 KOI8-U KOI8-RU KOI8-R
-    // csKOI8R Iscii-Mlm Iscii-Knd Iscii-Tlg Iscii-Tml Iscii-Ori
-    // Iscii-Gjr Iscii-Pnj Iscii-Bng Iscii-Dev TSCII GBK gb2312.1980-0
-    // gbk-0 CP936 MS936 windows-936 jisx0201*-0 jisx0208*-0
-    // ksc5601.1987-0 cp949 Big5-HKSCS big5-0 big5hkscs-0
-
-    QStringList availableCodecsQt;
-    foreach(const QByteArray &ba, QTextCodec::availableCodecs())
-        availableCodecsQt << QString(ba);
-
-    // Charsets detectable by libicu 4.4.2:
-    QStringList allDetectableCharsetsICU;
-    allDetectableCharsetsICU
-    << "UTF-8"
-    << "UTF-16BE"
-    << "UTF-16LE"
-    << "UTF-32BE"
-    << "UTF-32LE"
-    << "ISO-8859-1"
-    << "ISO-8859-2"
-    << "ISO-8859-5"
-    << "ISO-8859-6"
-    << "ISO-8859-7"
-    << "ISO-8859-8-I"
-    << "ISO-8859-8"
-    << "ISO-8859-9"
-    << "KOI8-R"
-    << "KOI8-U"
-    << "Shift_JIS"
-    << "GB18030"
-    << "EUC-JP"
-    << "EUC-KR"
-    << "Big5"
-    << "ISO-2022-JP"
-    << "ISO-2022-KR"
-    << "ISO-2022-CN"
-    << "IBM424_rtl"
-    << "IBM424_ltr"
-    << "IBM420_rtl"
-    << "IBM420_ltr"
-    << "windows-1250"
-    << "windows-1251"
-    << "windows-1252"
-    << "windows-1253"
-    << "windows-1255"
-    << "windows-1256"
-    << "windows-1254";
-
-    // The charsets detectable by libicu can be determined by
-    // ucsdet_getAllDetectableCharsets() and the documentation for
-    // that function at
-    // http://icu-project.org/apiref/icu4c/ucsdet_8h.html says:
-    //
-    //     “The state of the Charset detector that is passed in does
-    //     not affect the result of this function, but requiring a
-    //     valid, open charset detector as a parameter insures that
-    //     the charset detection service has been safely initialized
-    //     and that the required detection data is available.”
-    //
-    // but that does not seem to be completely true, in fact it
-    // *does* depend on the state of the charset detector. For example
-    // sometimes "windows-1250" *is* among the returned charsets.
-    // This happens if some non-ASCII text
-    // is in the detector and a detection is attempted and *then*
-    // ucsdet_getAllDetectableCharsets() is called.
-    // And sometimes "windows-1250" is *not* among the returned
-    // charsets. This happens when an empty charset detector is created
-    // and then ucsdet_getAllDetectableCharsets() is called.
-    // If ucsdet_getAllDetectableCharsets() has been called once
-    // the list of returned charsets never seems to change anymore,
-    // even if the text in the detector is changed again and
-    // another detection attempted which would result in a different
-    // list if ucsdet_getAllDetectableCharsets() were called first
-    // in that state.
-    //
-    // Sometimes ucsdet_getAllDetectableCharsets() reports charsets
-    // multiple times depending on the number of languages it can
-    // detect for that charsets, i.e. it may report ISO-8859-2 four
-    // times because it can detect the languages “cs”, “hu”,
-    // “pl”, and “ro” with that charset.
-    //
-    // This looks like a bug to me, to get a reliable list,
-    // I have hardcoded the complete list of charsets which
-    // ucsdet_getAllDetectableCharsets() can possibly return
-    // for all states of the detector above.
-    //
-    // Therefore, the following code should not add any extra charsets
-    // anymore, at least not for libicu 4.4.2:
-    clearError();
-    UEnumeration *en =
-        ucsdet_getAllDetectableCharsets(d->_uCharsetDetector, &(d->_status));
-    if (!hasError()) {
-        qint32 len;
-        const UChar *uc;
-        while ((uc = uenum_unext(en, &len, &(d->_status))) != NULL) {
-            if(uc && !hasError())
-                allDetectableCharsetsICU << QString::fromUtf16(uc, len);
-        }
-    }
-    uenum_close(en);
-
-    // remove all charsets not supported by QTextCodec and all duplicates:
-    foreach(const QString &cs, allDetectableCharsetsICU) {
-        if(availableCodecsQt.contains(cs) && !d->_allDetectableCharsets.contains(cs))
-            d->_allDetectableCharsets << cs;
-    }
-
-    qSort(d->_allDetectableCharsets);
-
-    return d->_allDetectableCharsets;
+    if(d->_codecTable == NULL)
+        d->_codecTable = MCharsetDetectorPrivate::detectableCharsets();
+    return d->_codecTable->charsets;
 }
 
 void MCharsetDetector::enableInputFilter(bool enable)
@@ -193,6 +193,90 @@ public:
      */
     void setText(const QByteArray &ba);
 
+    /*!
+     * \brief sets the input byte data without copying it
+     * \param data the input byte data
+     * \param size the number of bytes
+     *
+     * Like setText() but the data is not copied, it has to stay
+     * valid and unchanged until other input is set or the detector
+     * is destroyed.
+     *
+     * \sa setText(const QByteArray &ba)
+     * \sa setFile(const QString &fileName)
+     */
+    void setRawData(const char *data, int size);
+
+    /*!
+     * \brief sets the contents of a file as the input byte data
+     * \param fileName the name of the file
+     *
+     * The file is mapped into memory instead of reading it, i.e. the
+     * detection and the decoding checks work on the file contents
+     * directly. The file stays mapped until other input is set or the
+     * detector is destroyed.
+     *
+     * Returns false and sets an error if the file cannot be opened
+     * or mapped.
+     *
+     * \sa setText(const QByteArray &ba)
+     */
+    bool setFile(const QString &fileName);
+
+    /*!
+     * \brief feeds the next part of the input byte data
+     * \param data the next bytes of the input
+     * \param size the number of bytes
+     *
+     * Instead of setting the complete input at once with setText(),
+     * it can be fed piece by piece, for example while reading a large
+     * file. After the last piece, call finish(), then detect() or
+     * detectAll() as usual. The first call of feed() after setText()
+     * or finish() starts a new input.
+     *
+     * Only the first sampleBudget() bytes are kept and used for the
+     * detection. The rest of the input is not kept, but it is still
+     * checked, and matches for charsets which cannot decode it are
+     * removed like in detectAll(). I.e. the memory needed does not
+     * grow with the size of the input. text() returns only the part
+     * of the input which has been kept.
+     *
+     * Returns false if the input fed so far is already conclusive,
+     * i.e. if it starts with a byte order mark, contains an ISO-2022
+     * escape sequence, or contains at least 16 UTF-8 multibyte
+     * sequences and no invalid UTF-8. Then more input is not needed
+     * and it is ignored until finish() is called.
+     *
+     * \sa finish()
+     * \sa setSampleBudget(int bytes)
+     */
+    bool feed(const char *data, int size);
+
+    /*!
+     * \brief ends the input fed with feed()
+     *
+     * \sa feed(const char *data, int size)
+     */
+    void finish();
+
+    /*!
+     * \brief sets how many bytes of the input fed with feed() are kept
+     * for the detection
+     *
+     * The default is 65536 bytes.
+     *
+     * \sa feed(const char *data, int size)
+     */
+    void setSampleBudget(int bytes);
+
+    /*!
+     * \brief returns how many bytes of the input fed with feed() are
+     * kept for the detection
+     *
+     * \sa setSampleBudget(int bytes)
+     */
+    int sampleBudget() const;
+
     /*!
      * \brief detects the most likely encoding
      *
@@ -224,6 +308,76 @@ public:
      */
     QList<MCharsetMatch> detectAll();
 
+    /*!
+     * \brief detects the most likely encoding and decodes the input with it
+     * \param text if not 0, the entire input text decoded with the
+     * best match is stored here
+     *
+     * Returns the same match as detect() and stores the same text
+     * as text() would return for it. But the input has already been
+     * decoded while checking the matches in detectAll(), this text is
+     * reused instead of decoding the input a second time.
+     *
+     * \sa detect()
+     * \sa text(const MCharsetMatch &charsetMatch)
+     * \sa detectAndDecodeToUtf8(QByteArray *utf8)
+     */
+    MCharsetMatch detectAndDecode(QString *text);
+
+    /*!
+     * \brief detects the most likely encoding and converts the input to UTF-8
+     * \param utf8 if not 0, the entire input text converted to UTF-8
+     * is stored here
+     *
+     * Like detectAndDecode(QString *text) but stores the text as
+     * UTF-8. If the input is detected as UTF-8, it is not converted
+     * at all.
+     *
+     * \sa detectAndDecode(QString *text)
+     */
+    MCharsetMatch detectAndDecodeToUtf8(QByteArray *utf8);
+
+    /*!
+     * \brief detects the most likely encodings of many buffers in parallel
+     * \param buffers the input byte data
+     * \param declaredLocale a locale name to give as a hint, see setDeclaredLocale()
+     * \param declaredEncoding an encoding to give as a hint, see setDeclaredEncoding()
+     * \param threads number of threads to use, 0 uses QThread::idealThreadCount()
+     *
+     * Returns the best match for each buffer, in the same order as
+     * the buffers. The result is the same as detect() on a new
+     * MCharsetDetector for each buffer, but the buffers are
+     * distributed over the threads of a thread pool and each thread
+     * reuses one detector for all the buffers it handles. If the
+     * detection fails for a buffer, an empty MCharsetMatch is
+     * returned for it.
+     *
+     * \sa detectFiles()
+     */
+    static QList<MCharsetMatch> detectBuffers(const QList<QByteArray> &buffers,
+                                              const QString &declaredLocale = QString(),
+                                              const QString &declaredEncoding = QString(),
+                                              int threads = 0);
+
+    /*!
+     * \brief detects the most likely encodings of many files in parallel
+     * \param fileNames the names of the files
+     * \param declaredLocale a locale name to give as a hint, see setDeclaredLocale()
+     * \param declaredEncoding an encoding to give as a hint, see setDeclaredEncoding()
+     * \param threads number of threads to use, 0 uses QThread::idealThreadCount()
+     *
+     * Like detectBuffers() but reads the files in the threads of the
+     * thread pool, using feed(), i.e. only the sample budget of each
+     * file is kept in memory. If a file cannot be read, an empty
+     * MCharsetMatch is returned for it.
+     *
+     * \sa detectBuffers()
+     */
+    static QList<MCharsetMatch> detectFiles(const QStringList &fileNames,
+                                            const QString &declaredLocale = QString(),
+                                            const QString &declaredEncoding = QString(),
+                                            int threads = 0);
+
     /*!
      * \brief get the entire input text converted to the encoding of a match
      */
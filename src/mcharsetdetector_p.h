@@ -23,11 +23,20 @@
 #include <unicode/utypes.h>
 
 #include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QTextCodec>
+
+#include "mcharsetmatch.h"
 
 class UCharsetDetector;
+class QFile;
 
 namespace ML10N {
 
+struct MCharsetDetectorCodecTable;
+
 class MCharsetDetectorPrivate
 {
     Q_DECLARE_PUBLIC(MCharsetDetector)
@@ -37,20 +46,105 @@ public:
 
     virtual ~MCharsetDetectorPrivate();
 
+    enum InputClass {
+        AsciiInput,
+        Utf8Input,
+        OtherInput
+    };
+
+    // the charsets and languages used by the heuristics in detectAll()
+    enum CharsetId {
+        OtherCharset = 0,
+        Utf8Charset,
+        Iso88591Charset,
+        Iso88595Charset,
+        Iso88596Charset,
+        Iso88597Charset,
+        Iso88598Charset,
+        Iso88599Charset,
+        Koi8rCharset,
+        Koi8uCharset,
+        Windows1251Charset,
+        Iso2022jpCharset,
+        Big5Charset,
+        Gb18030Charset,
+        CharsetIdCount
+    };
+
+    enum LanguageId {
+        OtherLanguage = 0,
+        RussianLanguage,
+        UkrainianLanguage
+    };
+
     bool hasError() const;
     void clearError();
     QString errorString() const;
 
+    static const MCharsetDetectorCodecTable *detectableCharsets();
+    static QTextCodec *codecForCharset(const QString &charsetName);
+    static QList<MCharsetMatch> detectBatch(const QList<QByteArray> *buffers,
+                                            const QStringList *fileNames,
+                                            const QString &declaredLocale,
+                                            const QString &declaredEncoding,
+                                            int threads);
+    static InputClass classifyInput(const QByteArray &ba, int *multibyteSequences);
+    static bool isAsciiCompatible(const QString &charsetName);
+    QStringList undecodableCharsets(const QStringList &charsetNames,
+                                    int textCandidates = 0,
+                                    QString *decodedText = 0,
+                                    QString *decodedTextCharset = 0) const;
+    void setIcuText();
+    void releaseFile();
+    void clearStream();
+    void scanSample(const char *data, int size);
+    void checkRest(const char *data, int size);
+
     QByteArray _ba;
     QByteArray _baExtended;
+    // set if _ba does not own its data, see setRawData() and setFile():
+    bool _isRawData;
+    QFile *_file;
+    InputClass _inputClass;
+    int _utf8Sequences;
 
     UErrorCode _status;
     UCharsetDetector *_uCharsetDetector;
 
     QString _declaredLocale;
     QString _declaredEncoding;
-
-    QStringList _allDetectableCharsets;
+    // derived from the declared locale and encoding when they are set:
+    QString _declaredLanguage;
+    int _declaredLanguageRow;
+    LanguageId _declaredLanguageId;
+    bool _declaredTraditionalChinese;
+    bool _declaredSimplifiedChinese;
+    bool _declaredEncodingIsSingleByte;
+
+    const MCharsetDetectorCodecTable *_codecTable;
+
+    // detectAndDecode() keeps the text decoded by the best ranked
+    // charset while checking the matches in detectAll():
+    bool _keepDecodedText;
+    QString _decodedText;
+    QString _decodedTextCharset;
+
+    // state of the input fed with feed()
+    int _sampleBudget;
+    bool _isFeeding;
+    bool _isConclusive;
+    bool _hasCheckedBom;
+    bool _afterEscape;
+    int _utf8Pending;
+    int _utf8Valid;
+    bool _utf8Invalid;
+    // when the sample is full, it is detected right away and only
+    // the matches found are checked against the rest of the input:
+    bool _hasSampleMatches;
+    QList<MCharsetMatch> _sampleMatches;
+    QStringList _restCharsets;
+    QList<QTextCodec *> _restCodecs;
+    QList<QTextCodec::ConverterState *> _restStates;
 
     MCharsetDetector *q_ptr;
 private:
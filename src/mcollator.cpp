@@ -22,42 +22,562 @@
 
 #include <unicode/unistr.h>
 #include <unicode/coll.h>
+#include <unicode/ucol.h>
+#include <unicode/ucoleitr.h>
+#include <unicode/uset.h>
 
 #include "mlocale.h"
 #include "micuconversions.h"
 #include "mlocale_p.h"
 
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QRunnable>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 #include <QDebug>
 
 namespace ML10N {
 
+/////////////////////////
+// MCollatorLatin1Table
+
+MCollatorLatin1Table::MCollatorLatin1Table(const char *localeName)
+    : _isValid(false)
+{
+    for (int c = 0; c < 256; ++c) {
+        _weights[c].primary = 0;
+        _weights[c].secondary = 0;
+        _weights[c].tertiary = 0;
+        _isFast[c] = false;
+    }
+
+    UErrorCode status = U_ZERO_ERROR;
+    UCollator *coll = ucol_open(localeName, &status);
+    if (U_FAILURE(status))
+        return;
+
+    // The weights alone are not enough to reproduce the comparison
+    // if one of these attributes is set, for example the French
+    // secondary ordering compares the secondary weights backwards:
+    if (ucol_getAttribute(coll, UCOL_FRENCH_COLLATION, &status) == UCOL_ON
+        || ucol_getAttribute(coll, UCOL_ALTERNATE_HANDLING, &status) == UCOL_SHIFTED
+        || ucol_getAttribute(coll, UCOL_CASE_FIRST, &status) != UCOL_OFF
+        || ucol_getAttribute(coll, UCOL_CASE_LEVEL, &status) == UCOL_ON
+        || ucol_getAttribute(coll, UCOL_NUMERIC_COLLATION, &status) == UCOL_ON
+        || ucol_getAttribute(coll, UCOL_HIRAGANA_QUATERNARY_MODE, &status) == UCOL_ON
+        || U_FAILURE(status)) {
+        ucol_close(coll);
+        return;
+    }
+
+    // characters which are part of a contraction like “ch” in Czech
+    // or “aa” in Danish cannot be handled character by character:
+    bool isInContraction[256];
+    for (int c = 0; c < 256; ++c)
+        isInContraction[c] = false;
+    USet *contractions = uset_openEmpty();
+    ucol_getContractionsAndExpansions(coll, contractions, NULL, true, &status);
+    int32_t itemCount = uset_getItemCount(contractions);
+    for (int32_t i = 0; i < itemCount && U_SUCCESS(status); ++i) {
+        UChar32 start;
+        UChar32 end;
+        UChar buffer[64];
+        int32_t length = uset_getItem(contractions, i, &start, &end,
+                                      buffer, 64, &status);
+        if (length == 0) {
+            for (UChar32 c = start; c <= end && c < 256; ++c)
+                isInContraction[c] = true;
+        }
+        else {
+            for (int32_t j = 0; j < length && j < 64; ++j)
+                if (buffer[j] < 256)
+                    isInContraction[buffer[j]] = true;
+        }
+    }
+    uset_close(contractions);
+    if (U_FAILURE(status)) {
+        ucol_close(coll);
+        return;
+    }
+
+    for (int c = 0; c < 256; ++c) {
+        if (isInContraction[c])
+            continue;
+        UChar uc = c;
+        UCollationElements *elements = ucol_openElements(coll, &uc, 1, &status);
+        int32_t ce;
+        int32_t firstCe = 0;
+        int count = 0;
+        while ((ce = ucol_next(elements, &status)) != UCOL_NULLORDER
+               && U_SUCCESS(status)) {
+            if (count == 0)
+                firstCe = ce;
+            ++count;
+        }
+        ucol_closeElements(elements);
+        if (U_FAILURE(status)) {
+            ucol_close(coll);
+            return;
+        }
+        // expansions like “ß” and continuations of long primary
+        // weights are left to icu:
+        if (count > 1 || (count == 1 && (firstCe & 0xC0) == 0xC0))
+            continue;
+        if (count == 1) {
+            _weights[c].primary = ucol_primaryOrder(firstCe);
+            _weights[c].secondary = ucol_secondaryOrder(firstCe);
+            // strip the case bits:
+            _weights[c].tertiary = ucol_tertiaryOrder(firstCe) & 0x3F;
+        }
+        // count == 0 is a completely ignorable character, all
+        // its weights stay 0
+        _isFast[c] = true;
+    }
+
+    // Verify that the table agrees with icu: sort the characters
+    // by their weights and check that icu orders each neighbour
+    // the same way. If it does not (for example because of a script
+    // reordering which is not visible in the collation elements),
+    // the table is not used at all.
+    QList<quint64> keys;
+    for (int c = 0; c < 256; ++c) {
+        if (_isFast[c])
+            keys << ((quint64(_weights[c].primary) << 32)
+                     | (quint64(_weights[c].secondary) << 24)
+                     | (quint64(_weights[c].tertiary) << 16)
+                     | quint64(c));
+    }
+    qSort(keys);
+    ucol_setStrength(coll, UCOL_TERTIARY);
+    bool isConsistent = true;
+    for (int i = 1; i < keys.size() && isConsistent; ++i) {
+        UChar previous = keys[i-1] & 0xFFFF;
+        UChar current = keys[i] & 0xFFFF;
+        UCollationResult expected =
+            ((keys[i-1] >> 16) < (keys[i] >> 16)) ? UCOL_LESS : UCOL_EQUAL;
+        if (ucol_strcoll(coll, &previous, 1, &current, 1) != expected)
+            isConsistent = false;
+    }
+    ucol_close(coll);
+    _isValid = isConsistent;
+}
+
+bool MCollatorLatin1Table::isValid() const
+{
+    return _isValid;
+}
+
+bool MCollatorLatin1Table::isFast(const QString &s) const
+{
+    const QChar *data = s.constData();
+    const int size = s.size();
+    for (int i = 0; i < size; ++i) {
+        const ushort c = data[i].unicode();
+        if (c > 0xFF || !_isFast[c])
+            return false;
+    }
+    return true;
+}
+
+// returns false if the strings cannot be compared with the table,
+// then icu has to be used.
+bool MCollatorLatin1Table::compare(const QString &s1, const QString &s2,
+                                   icu::Collator::ECollationStrength strength,
+                                   MLocale::Comparison *result) const
+{
+    if (!_isValid || strength == icu::Collator::IDENTICAL
+        || !isFast(s1) || !isFast(s2))
+        return false;
+
+    // Without case level, hiragana quaternary mode or shifted
+    // alternate handling there are no quaternary differences,
+    // therefore compare at most up to the tertiary level:
+    const int levels = (strength >= icu::Collator::TERTIARY) ? 3 : int(strength) + 1;
+    const ushort *d1 = s1.utf16();
+    const ushort *d2 = s2.utf16();
+    const int size1 = s1.size();
+    const int size2 = s2.size();
+    for (int level = 0; level < levels; ++level) {
+        int i = 0;
+        int j = 0;
+        forever {
+            uint w1 = 0;
+            uint w2 = 0;
+            // skip characters which are ignorable on this level:
+            while (i < size1 && w1 == 0) {
+                const Weights &w = _weights[d1[i++]];
+                w1 = level == 0 ? w.primary : (level == 1 ? w.secondary : w.tertiary);
+            }
+            while (j < size2 && w2 == 0) {
+                const Weights &w = _weights[d2[j++]];
+                w2 = level == 0 ? w.primary : (level == 1 ? w.secondary : w.tertiary);
+            }
+            if (w1 != w2) {
+                *result = (w1 < w2) ? MLocale::LessThan : MLocale::GreaterThan;
+                return true;
+            }
+            if (w1 == 0)
+                break; // both strings are at their end
+        }
+    }
+    *result = MLocale::Equal;
+    return true;
+}
+
+// mutex to guard the table cache
+static QMutex latin1TablesMutex;
+static QHash<QByteArray, MCollatorLatin1Table *> latin1Tables;
+
+struct MStaticLatin1TablesDestroyer {
+    ~MStaticLatin1TablesDestroyer() {
+        qDeleteAll(latin1Tables);
+        latin1Tables.clear();
+    }
+};
+static MStaticLatin1TablesDestroyer staticLatin1TablesDestroyer;
+
+// returns the table for a collation locale, building it the first
+// time it is needed in this process. Returns 0 if the locale cannot
+// use a table.
+const MCollatorLatin1Table *MCollatorLatin1Table::table(const icu::Locale &locale)
+{
+    QByteArray localeName(locale.getName());
+    QMutexLocker locker(&latin1TablesMutex);
+    MCollatorLatin1Table *table = latin1Tables.value(localeName);
+    if (!table) {
+        table = new MCollatorLatin1Table(localeName.constData());
+        latin1Tables.insert(localeName, table);
+    }
+    return table->isValid() ? table : 0;
+}
+
+static MLocale::Comparison toComparison(UCollationResult result)
+{
+    if (result == UCOL_LESS)
+        return MLocale::LessThan;
+    else if (result == UCOL_EQUAL)
+        return MLocale::Equal;
+    else
+        return MLocale::GreaterThan;
+}
+
+// compares with icu directly on the QString data, which avoids
+// copying both strings into icu::UnicodeStrings
+static MLocale::Comparison icuCompare(const icu::Collator *coll,
+                                      const QString &s1, const QString &s2)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UCollationResult result =
+        coll->compare(reinterpret_cast<const UChar *>(s1.utf16()), s1.size(),
+                      reinterpret_cast<const UChar *>(s2.utf16()), s2.size(),
+                      status);
+    if (U_FAILURE(status))
+        return MLocale::Equal; // ERROR
+    return toComparison(result);
+}
+
 /////////////////////
 // MCollatorPrivate
 
 MCollatorPrivate::MCollatorPrivate()
-    : _coll(0)
+    : _coll(0),
+      _latin1Table(0)
 {
-    // nothing
+    for (int i = 0; i < VariantCount; ++i)
+        _variants[i] = 0;
 }
 
 MCollatorPrivate::~MCollatorPrivate()
 {
-    delete _coll;
+    clearCollators();
 }
 
 // allocates an icu collator based on locale
 void MCollatorPrivate::initCollator(const icu::Locale &locale)
 {
     UErrorCode status = U_ZERO_ERROR;
-    _coll = icu::Collator::createInstance(locale, status);
+    icu::Collator *coll = icu::Collator::createInstance(locale, status);
     if(U_FAILURE(status)) {
         qWarning() << __PRETTY_FUNCTION__
                    << "icu::Collator::createInstance() failed with error"
                    << u_errorName(status);
     }
-    _coll->setStrength(icu::Collator::QUATERNARY);
+    if (!coll)
+        return;
+    coll->setStrength(icu::Collator::QUATERNARY);
     // This is default already in Japanese locales:
-    // _coll->setAttribute(UCOL_HIRAGANA_QUATERNARY_MODE, UCOL_ON, status);
+    // coll->setAttribute(UCOL_HIRAGANA_QUATERNARY_MODE, UCOL_ON, status);
+    _variants[variantIndex(MLocale::CollatorStrengthQuaternary)] = coll;
+    _coll = coll;
+    _latin1Table = MCollatorLatin1Table::table(locale);
+}
+
+// allocates an icu collator as a copy of another one, keeping its strength
+void MCollatorPrivate::initCollator(const icu::Collator *collator)
+{
+    if (!collator)
+        return;
+    icu::Collator *coll = collator->safeClone();
+    int index = 0;
+    switch (coll->getStrength()) {
+    case icu::Collator::PRIMARY:
+        index = variantIndex(MLocale::CollatorStrengthPrimary);
+        break;
+    case icu::Collator::SECONDARY:
+        index = variantIndex(MLocale::CollatorStrengthSecondary);
+        break;
+    case icu::Collator::TERTIARY:
+        index = variantIndex(MLocale::CollatorStrengthTertiary);
+        break;
+    case icu::Collator::IDENTICAL:
+        index = variantIndex(MLocale::CollatorStrengthIdentical);
+        break;
+    case icu::Collator::QUATERNARY:
+    default:
+        index = variantIndex(MLocale::CollatorStrengthQuaternary);
+        break;
+    }
+    _variants[index] = coll;
+    _coll = coll;
+}
+
+void MCollatorPrivate::clearCollators()
+{
+    for (int i = 0; i < VariantCount; ++i) {
+        delete _variants[i];
+        _variants[i] = 0;
+    }
+    _coll = 0;
+}
+
+int MCollatorPrivate::variantIndex(MLocale::CollatorStrength collatorStrength)
+{
+    switch(collatorStrength) {
+    case MLocale::CollatorStrengthPrimary:
+        return 0;
+    case MLocale::CollatorStrengthSecondary:
+        return 1;
+    case MLocale::CollatorStrengthTertiary:
+        return 2;
+    case MLocale::CollatorStrengthIdentical:
+        return 4;
+    case MLocale::CollatorStrengthQuaternary:
+    default:
+        return 3;
+    }
+}
+
+icu::Collator::ECollationStrength MCollatorPrivate::icuStrength(MLocale::CollatorStrength collatorStrength)
+{
+    switch(collatorStrength) {
+    case MLocale::CollatorStrengthPrimary:
+        return icu::Collator::PRIMARY;
+    case MLocale::CollatorStrengthSecondary:
+        return icu::Collator::SECONDARY;
+    case MLocale::CollatorStrengthTertiary:
+        return icu::Collator::TERTIARY;
+    case MLocale::CollatorStrengthIdentical:
+        return icu::Collator::IDENTICAL;
+    case MLocale::CollatorStrengthQuaternary:
+    default:
+        return icu::Collator::QUATERNARY;
+    }
+}
+
+// returns the variant of the collator for the given strength, the
+// variant is cloned from an existing one when it is needed first.
+// Switching between variants is much cheaper than calling
+// icu::Collator::setStrength() back and forth.
+icu::Collator *MCollatorPrivate::collatorForStrength(MLocale::CollatorStrength collatorStrength) const
+{
+    int index = variantIndex(collatorStrength);
+    if (!_variants[index] && _coll) {
+        _variants[index] = _coll->safeClone();
+        _variants[index]->setStrength(icuStrength(collatorStrength));
+    }
+    return _variants[index];
+}
+
+///////////////////////
+// parallel sorting
+
+// returns the sort key of the string without the terminating null
+// byte, buffer is reused between calls to avoid allocations
+static QByteArray icuSortKey(const icu::Collator *coll, const QString &string, QByteArray *buffer)
+{
+    const UChar *source = reinterpret_cast<const UChar *>(string.utf16());
+    int32_t length = coll->getSortKey(source, string.size(),
+                                      reinterpret_cast<uint8_t *>(buffer->data()),
+                                      buffer->size());
+    if (length > buffer->size()) {
+        buffer->resize(length);
+        length = coll->getSortKey(source, string.size(),
+                                  reinterpret_cast<uint8_t *>(buffer->data()),
+                                  buffer->size());
+    }
+    // the length includes the terminating null byte:
+    return QByteArray(buffer->constData(), qMax(0, length - 1));
+}
+
+// compares indices into a list of collation sort keys
+class MCollatorSortKeyLessThan
+{
+public:
+    MCollatorSortKeyLessThan(const QVector<QByteArray> *keys, Qt::SortOrder sortOrder)
+        : _keys(keys), _sortOrder(sortOrder)
+    {
+    }
+
+    bool operator()(int left, int right) const
+    {
+        // icu sort keys are null terminated and do not contain
+        // any other null bytes:
+        if (_sortOrder == Qt::DescendingOrder)
+            return qstrcmp(_keys->at(right), _keys->at(left)) < 0;
+        else
+            return qstrcmp(_keys->at(left), _keys->at(right)) < 0;
+    }
+
+private:
+    const QVector<QByteArray> *_keys;
+    Qt::SortOrder _sortOrder;
+};
+
+// creates the sort keys for a range of the list and sorts the
+// indices of that range
+class MCollatorSortTask : public QRunnable
+{
+public:
+    MCollatorSortTask(icu::Collator *coll, const QStringList *list,
+                      QVector<QByteArray> *keys, QVector<int> *indices,
+                      int begin, int end, Qt::SortOrder sortOrder, bool stable)
+        : _coll(coll), _list(list), _keys(keys), _indices(indices),
+          _begin(begin), _end(end), _sortOrder(sortOrder), _stable(stable)
+    {
+    }
+
+    ~MCollatorSortTask()
+    {
+        delete _coll;
+    }
+
+    void run()
+    {
+        QByteArray buffer(256, '\0');
+        for (int i = _begin; i < _end; ++i) {
+            (*_keys)[i] = icuSortKey(_coll, _list->at(i), &buffer);
+            (*_indices)[i] = i;
+        }
+        MCollatorSortKeyLessThan lessThan(_keys, _sortOrder);
+        if (_stable)
+            qStableSort(_indices->begin() + _begin, _indices->begin() + _end, lessThan);
+        else
+            qSort(_indices->begin() + _begin, _indices->begin() + _end, lessThan);
+    }
+
+private:
+    icu::Collator *_coll;
+    const QStringList *_list;
+    QVector<QByteArray> *_keys;
+    QVector<int> *_indices;
+    int _begin;
+    int _end;
+    Qt::SortOrder _sortOrder;
+    bool _stable;
+};
+
+// merges two adjacent sorted ranges of indices into the target,
+// taking from the left range first if keys are equal to keep the
+// merge stable
+class MCollatorMergeTask : public QRunnable
+{
+public:
+    MCollatorMergeTask(const QVector<QByteArray> *keys,
+                       const QVector<int> *source, QVector<int> *target,
+                       int begin, int middle, int end, Qt::SortOrder sortOrder)
+        : _keys(keys), _source(source), _target(target),
+          _begin(begin), _middle(middle), _end(end), _sortOrder(sortOrder)
+    {
+    }
+
+    void run()
+    {
+        MCollatorSortKeyLessThan lessThan(_keys, _sortOrder);
+        int left = _begin;
+        int right = _middle;
+        int out = _begin;
+        while (left < _middle && right < _end) {
+            if (lessThan(_source->at(right), _source->at(left)))
+                (*_target)[out++] = _source->at(right++);
+            else
+                (*_target)[out++] = _source->at(left++);
+        }
+        while (left < _middle)
+            (*_target)[out++] = _source->at(left++);
+        while (right < _end)
+            (*_target)[out++] = _source->at(right++);
+    }
+
+private:
+    const QVector<QByteArray> *_keys;
+    const QVector<int> *_source;
+    QVector<int> *_target;
+    int _begin;
+    int _middle;
+    int _end;
+    Qt::SortOrder _sortOrder;
+};
+
+// compares the current heads of sorted lists of sort keys, for the
+// heap used in the k-way merge. Heads with equal keys are ordered by
+// list index to keep the merge stable.
+class MCollatorMergeHeadLessThan
+{
+public:
+    MCollatorMergeHeadLessThan(const QList<QList<QByteArray> > *keys,
+                               const QVector<int> *positions, Qt::SortOrder sortOrder)
+        : _keys(keys), _positions(positions), _sortOrder(sortOrder)
+    {
+    }
+
+    bool operator()(int left, int right) const
+    {
+        int result = qstrcmp(_keys->at(left).at(_positions->at(left)),
+                             _keys->at(right).at(_positions->at(right)));
+        if (_sortOrder == Qt::DescendingOrder)
+            result = -result;
+        if (result != 0)
+            return result < 0;
+        return left < right;
+    }
+
+private:
+    const QList<QList<QByteArray> > *_keys;
+    const QVector<int> *_positions;
+    Qt::SortOrder _sortOrder;
+};
+
+static void siftDown(QVector<int> &heap, int i, const MCollatorMergeHeadLessThan &lessThan)
+{
+    const int size = heap.size();
+    for (;;) {
+        int smallest = i;
+        const int left = 2 * i + 1;
+        const int right = left + 1;
+        if (left < size && lessThan(heap.at(left), heap.at(smallest)))
+            smallest = left;
+        if (right < size && lessThan(heap.at(right), heap.at(smallest)))
+            smallest = right;
+        if (smallest == i)
+            return;
+        qSwap(heap[i], heap[smallest]);
+        i = smallest;
+    }
 }
 
 //////////////////////
@@ -114,7 +634,8 @@ MCollator::MCollator(const MCollator &other)
 {
     Q_D(MCollator);
 
-    d->_coll = other.d_ptr->_coll->safeClone();
+    d->initCollator(other.d_ptr->_coll);
+    d->_latin1Table = other.d_ptr->_latin1Table;
 }
 
 MCollator::~MCollator()
@@ -150,26 +671,9 @@ MLocale::CollatorStrength MCollator::strength() const
 void MCollator::setStrength(MLocale::CollatorStrength collatorStrength)
 {
     Q_D(MCollator);
-    switch(collatorStrength) {
-    case MLocale::CollatorStrengthPrimary:
-        d->_coll->setStrength(icu::Collator::PRIMARY);
-        break;
-    case MLocale::CollatorStrengthSecondary:
-        d->_coll->setStrength(icu::Collator::SECONDARY);
-        break;
-    case MLocale::CollatorStrengthTertiary:
-        d->_coll->setStrength(icu::Collator::TERTIARY);
-        break;
-    case MLocale::CollatorStrengthQuaternary:
-        d->_coll->setStrength(icu::Collator::QUATERNARY);
-        break;
-    case MLocale::CollatorStrengthIdentical:
-        d->_coll->setStrength(icu::Collator::IDENTICAL);
-        break;
-    default:
-        d->_coll->setStrength(icu::Collator::QUATERNARY);
-        break;
-    }
+    icu::Collator *coll = d->collatorForStrength(collatorStrength);
+    if (coll)
+        d->_coll = coll;
 }
 
 //! operator () works as lessThan comparison.
@@ -178,15 +682,151 @@ bool MCollator::operator()(const QString &s1, const QString &s2) const
 {
     Q_D(const MCollator);
 
-    const icu::UnicodeString us1 = MIcuConversions::qStringToUnicodeString(s1);
-    const icu::UnicodeString us2 = MIcuConversions::qStringToUnicodeString(s2);
-    icu::Collator::EComparisonResult result =  d->_coll->compare(us1, us2);
+    MLocale::Comparison result;
+    if (!d->_latin1Table
+        || !d->_latin1Table->compare(s1, s2, d->_coll->getStrength(), &result))
+        result = icuCompare(d->_coll, s1, s2);
 
-    if (result == Collator::LESS) {
-        return true;
-    } else {
-        return false;
+    return result == MLocale::LessThan;
+}
+
+//! Compares two strings with the collator variant for the given
+//! strength, the strength set by setStrength() is not changed
+MLocale::Comparison MCollator::compare(const QString &first, const QString &second,
+                                       MLocale::CollatorStrength collatorStrength) const
+{
+    Q_D(const MCollator);
+
+    icu::Collator *coll = d->collatorForStrength(collatorStrength);
+    if (!coll)
+        return MLocale::Equal; // ERROR
+
+    MLocale::Comparison result;
+    if (d->_latin1Table
+        && d->_latin1Table->compare(first, second, coll->getStrength(), &result))
+        return result;
+
+    return icuCompare(coll, first, second);
+}
+
+void MCollator::sort(QStringList &list, Qt::SortOrder sortOrder, int threads, bool stable) const
+{
+    Q_D(const MCollator);
+
+    // below this size per thread, starting threads costs more than
+    // it gains:
+    const int minimumChunkSize = 512;
+
+    const int size = list.size();
+    if (size < 2 || !d->_coll)
+        return;
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qBound(1, threads, (size + minimumChunkSize - 1) / minimumChunkSize);
+
+    QVector<QByteArray> keys(size);
+    QVector<int> indices(size);
+    QVector<int> bounds;
+    for (int i = 0; i <= threads; ++i)
+        bounds << int(qint64(size) * i / threads);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threads);
+    // icu collators must not be shared between threads, therefore
+    // each task gets its own clone:
+    for (int i = 0; i < threads; ++i)
+        pool.start(new MCollatorSortTask(d->_coll->safeClone(), &list, &keys, &indices,
+                                         bounds[i], bounds[i+1], sortOrder, stable));
+    pool.waitForDone();
+
+    // merge the sorted chunks pairwise until only one is left:
+    QVector<int> merged(size);
+    while (bounds.size() > 2) {
+        QVector<int> newBounds;
+        newBounds << 0;
+        int i = 0;
+        for (; i + 2 < bounds.size(); i += 2) {
+            pool.start(new MCollatorMergeTask(&keys, &indices, &merged,
+                                              bounds[i], bounds[i+1], bounds[i+2],
+                                              sortOrder));
+            newBounds << bounds[i+2];
+        }
+        if (i + 1 < bounds.size()) {
+            // odd number of chunks, the last one is only copied:
+            for (int j = bounds[i]; j < size; ++j)
+                merged[j] = indices[j];
+            newBounds << size;
+        }
+        pool.waitForDone();
+        qSwap(indices, merged);
+        bounds = newBounds;
     }
+
+    QStringList sorted;
+    sorted.reserve(size);
+    for (int i = 0; i < size; ++i)
+        sorted << list.at(indices.at(i));
+    list = sorted;
+}
+
+QByteArray MCollator::sortKey(const QString &string) const
+{
+    Q_D(const MCollator);
+
+    if (!d->_coll)
+        return QByteArray();
+    QByteArray buffer(256, '\0');
+    return icuSortKey(d->_coll, string, &buffer);
+}
+
+QList<QPair<int, int> > MCollator::merge(const QList<QStringList> &sortedLists,
+                                         Qt::SortOrder sortOrder) const
+{
+    Q_D(const MCollator);
+
+    QList<QList<QByteArray> > keys;
+    if (!d->_coll)
+        return QList<QPair<int, int> >();
+    QByteArray buffer(256, '\0');
+    foreach (const QStringList &list, sortedLists) {
+        QList<QByteArray> listKeys;
+        listKeys.reserve(list.size());
+        foreach (const QString &string, list)
+            listKeys << icuSortKey(d->_coll, string, &buffer);
+        keys << listKeys;
+    }
+    return mergeSortKeys(keys, sortOrder);
+}
+
+QList<QPair<int, int> > MCollator::mergeSortKeys(const QList<QList<QByteArray> > &sortedKeys,
+                                                 Qt::SortOrder sortOrder)
+{
+    QList<QPair<int, int> > result;
+    int total = 0;
+    QVector<int> positions(sortedKeys.size(), 0);
+    QVector<int> heap;
+    for (int i = 0; i < sortedKeys.size(); ++i) {
+        total += sortedKeys.at(i).size();
+        if (!sortedKeys.at(i).isEmpty())
+            heap << i;
+    }
+    result.reserve(total);
+
+    MCollatorMergeHeadLessThan lessThan(&sortedKeys, &positions, sortOrder);
+    for (int i = heap.size() / 2 - 1; i >= 0; --i)
+        siftDown(heap, i, lessThan);
+
+    while (!heap.isEmpty()) {
+        const int list = heap.first();
+        result << qMakePair(list, positions.at(list));
+        if (++positions[list] == sortedKeys.at(list).size()) {
+            heap[0] = heap.last();
+            heap.pop_back();
+        }
+        if (!heap.isEmpty())
+            siftDown(heap, 0, lessThan);
+    }
+    return result;
 }
 
 //! Compares two strings with the default MLocale
@@ -204,6 +844,14 @@ MLocale::Comparison MCollator::compare(MLocale &locale, const QString &first,
     UErrorCode status = U_ZERO_ERROR;
     icu::Locale icuLocale
     = locale.d_ptr->getCategoryLocale(MLocale::MLcCollate);
+
+    // no need to create a collator if the Latin-1 table can decide:
+    const MCollatorLatin1Table *latin1Table = MCollatorLatin1Table::table(icuLocale);
+    MLocale::Comparison result;
+    if (latin1Table
+        && latin1Table->compare(first, second, icu::Collator::QUATERNARY, &result))
+        return result;
+
     icu::Collator *collator = icu::Collator::createInstance(icuLocale, status);
     if (!U_SUCCESS(status)) {
         return MLocale::Equal; // ERROR
@@ -212,30 +860,23 @@ MLocale::Comparison MCollator::compare(MLocale &locale, const QString &first,
     // This is default already in Japanese locales:
     // collator->setAttribute(UCOL_HIRAGANA_QUATERNARY_MODE, UCOL_ON, status);
 
-    const icu::UnicodeString us1 = MIcuConversions::qStringToUnicodeString(first);
-    const icu::UnicodeString us2 = MIcuConversions::qStringToUnicodeString(second);
-
     // do the comparison
-    icu::Collator::EComparisonResult result = collator->compare(us1, us2);
+    result = icuCompare(collator, first, second);
     delete collator;
 
-    if (result == icu::Collator::LESS) {
-        return MLocale::LessThan;
-
-    } else if (result == icu::Collator::EQUAL) {
-        return MLocale::Equal;
-
-    } else {
-        return MLocale::GreaterThan;
-    }
+    return result;
 }
 
 MCollator &MCollator::operator =(const MCollator &other)
 {
     Q_D(MCollator);
 
-    delete d->_coll;
-    d->_coll = other.d_ptr->_coll->safeClone();
+    if (this == &other)
+        return *this;
+
+    d->clearCollators();
+    d->initCollator(other.d_ptr->_coll);
+    d->_latin1Table = other.d_ptr->_latin1Table;
     return *this;
 }
 
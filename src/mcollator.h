@@ -23,7 +23,12 @@
 #include "mlocaleexport.h"
 #include "mlocale.h"
 
+#include <QList>
+#include <QPair>
+
+class QByteArray;
 class QString;
+class QStringList;
 
 namespace ML10N {
 
@@ -53,6 +58,77 @@ public:
 
     bool operator()(const QString &s1, const QString &s2) const;
 
+    /*!
+     * \brief compares two strings using the given strength
+     *
+     * Unlike setStrength() this does not change the strength of
+     * the MCollator. Use this instead of toggling setStrength()
+     * when the same collator is used both for primary strength
+     * matching (bucketing, searching) and for sorting.
+     *
+     * \sa setStrength(MLocale::CollatorStrength collatorStrength)
+     */
+    MLocale::Comparison compare(const QString &first, const QString &second,
+                                MLocale::CollatorStrength collatorStrength) const;
+
+    /*!
+     * \brief sorts a list of strings using this collator
+     * \param list the list to sort
+     * \param sortOrder ascending or descending order
+     * \param threads number of threads to use, 0 uses QThread::idealThreadCount()
+     * \param stable whether strings which compare equal keep their order
+     *
+     * This gives the same order as
+     * \code
+     * qStableSort(list.begin(), list.end(), collator);
+     * \endcode
+     * but is much faster for long lists: the collation sort keys
+     * of the strings are created once, in parallel, using a clone
+     * of the collator per thread, and the list is then sorted with a
+     * parallel merge sort on these keys.
+     *
+     * If \a stable is false, strings which compare equal at the
+     * strength of this collator may end up in any order.
+     */
+    void sort(QStringList &list, Qt::SortOrder sortOrder = Qt::AscendingOrder,
+              int threads = 0, bool stable = false) const;
+
+    /*!
+     * \brief returns the collation sort key of a string
+     *
+     * Comparing the sort keys of two strings bytewise, for example
+     * with qstrcmp(), gives the same result as comparing the strings
+     * with this collator. This is faster if the same strings are
+     * compared many times.
+     */
+    QByteArray sortKey(const QString &string) const;
+
+    /*!
+     * \brief merges lists which are already sorted with this collator
+     * \param sortedLists the lists, each sorted in \a sortOrder
+     * \param sortOrder the order the lists are sorted in
+     *
+     * Returns the merged order as pairs of (index of the list in \a
+     * sortedLists, index of the string in that list). Strings which
+     * compare equal are taken from the earlier list first, so the
+     * result is the same as stable sorting the concatenated lists.
+     *
+     * The sort key of each string is created once and the lists are
+     * merged with a heap, which needs O(n log k) comparisons for n strings
+     * in k lists instead of sorting everything again.
+     */
+    QList<QPair<int, int> > merge(const QList<QStringList> &sortedLists,
+                                  Qt::SortOrder sortOrder = Qt::AscendingOrder) const;
+
+    /*!
+     * \brief merges lists of sort keys which are already sorted
+     *
+     * Same as merge() but for lists of sort keys created with
+     * sortKey(), for callers which keep the sort keys around.
+     */
+    static QList<QPair<int, int> > mergeSortKeys(const QList<QList<QByteArray> > &sortedKeys,
+                                                 Qt::SortOrder sortOrder = Qt::AscendingOrder);
+
     static MLocale::Comparison compare(const QString &first, const QString &second);
 
     static MLocale::Comparison compare(MLocale &locale, const QString &first,
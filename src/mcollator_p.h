@@ -22,8 +22,42 @@
 
 #include <unicode/coll.h>
 
+#include <QString>
+
+#include "mlocale.h"
+
 namespace ML10N {
 
+// Collation weights of the Latin-1 characters in one collation
+// locale. Strings consisting only of Latin-1 characters which map
+// to a single collation element and do not take part in any
+// contraction can be compared with these weights directly, which
+// gives the same result as icu but is much faster.
+class MCollatorLatin1Table
+{
+public:
+    explicit MCollatorLatin1Table(const char *localeName);
+
+    bool isValid() const;
+    bool compare(const QString &s1, const QString &s2,
+                 icu::Collator::ECollationStrength strength,
+                 MLocale::Comparison *result) const;
+
+    static const MCollatorLatin1Table *table(const icu::Locale &locale);
+
+private:
+    bool isFast(const QString &s) const;
+
+    struct Weights {
+        quint16 primary;
+        quint8 secondary;
+        quint8 tertiary;
+    };
+    Weights _weights[256];
+    bool _isFast[256];
+    bool _isValid;
+};
+
 class MCollatorPrivate
 {
 public:
@@ -31,8 +65,22 @@ public:
     virtual ~MCollatorPrivate();
 
     void initCollator(const icu::Locale &locale);
+    void initCollator(const icu::Collator *collator);
+    void clearCollators();
+
+    static int variantIndex(MLocale::CollatorStrength collatorStrength);
+    static icu::Collator::ECollationStrength icuStrength(MLocale::CollatorStrength collatorStrength);
+    icu::Collator *collatorForStrength(MLocale::CollatorStrength collatorStrength) const;
+
+    enum { VariantCount = 5 };
 
+    // one lazily created icu collator per collator strength, cloned
+    // from the first one created. _coll points to the variant
+    // selected by setStrength().
+    mutable icu::Collator *_variants[VariantCount];
     icu::Collator *_coll;
+    // shared between all collators for the same locale, not owned
+    const MCollatorLatin1Table *_latin1Table;
 
 private:
     MCollatorPrivate(const MCollatorPrivate &other);
@@ -20,13 +20,28 @@
 #include "mlocalebuckets.h"
 #include "mlocalebuckets_p.h"
 
+#ifdef HAVE_ICU
+#include <unicode/uversion.h>
+#include <unicode/ucol.h>
+#endif
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QHash>
+#include <QDebug>
+
 namespace ML10N {
 
+static const char IndexMagic[8] = { 'M', 'L', 'B', 'I', 'N', 'D', 'E', 'X' };
+static const quint32 IndexVersion = 1;
+static const quint32 IndexByteOrderMark = 0x01020304;
+
 MLocaleBucketsPrivate::MLocaleBucketsPrivate() :
     locale(),
 #ifdef HAVE_ICU
     collator(locale),
 #endif
+    sortOrder(Qt::AscendingOrder),
     q_ptr(0)
 {
 #ifdef HAVE_ICU
@@ -44,7 +59,45 @@ void MLocaleBucketsPrivate::setItems(const QStringList &unsortedItems, Qt::SortO
         items.append(MLocaleBucketItem(unsortedItems.at(i), i));
     }
     qStableSort(items.begin(), items.end(), MLocaleBucketItemComparator(sortOrder));
+    this->sortOrder = sortOrder;
+    fillBuckets(items);
+}
+
+void MLocaleBucketsPrivate::setSortedItems(const QList<QStringList> &sortedItemLists,
+                                           Qt::SortOrder sortOrder)
+{
+    // Remember to call clear() first if this is called from somewhere else than a constructor!
+#ifdef HAVE_ICU
+    // same collator as in MLocaleBucketItemComparator:
+    MCollator mergeCollator((MLocale()));
+    mergeCollator.setStrength(MLocale::CollatorStrengthQuaternary);
+    const QList<QPair<int, int> > order = mergeCollator.merge(sortedItemLists, sortOrder);
+
+    QVector<int> offsets;
+    int offset = 0;
+    foreach (const QStringList &list, sortedItemLists) {
+        offsets << offset;
+        offset += list.size();
+    }
+    QList<MLocaleBucketItem> items;
+    items.reserve(order.size());
+    for (int i = 0; i < order.size(); ++i) {
+        const QPair<int, int> &origin = order.at(i);
+        items.append(MLocaleBucketItem(sortedItemLists.at(origin.first).at(origin.second),
+                                       offsets.at(origin.first) + origin.second));
+    }
+    this->sortOrder = sortOrder;
+    fillBuckets(items);
+#else
+    QStringList items;
+    foreach (const QStringList &list, sortedItemLists)
+        items << list;
+    setItems(items, sortOrder);
+#endif
+}
 
+void MLocaleBucketsPrivate::fillBuckets(const QList<MLocaleBucketItem> &items)
+{
     QString lastBucket;
     QStringList lastBucketItems;
     QList<int>  lastBucketOrigIndices;
@@ -79,6 +132,283 @@ void MLocaleBucketsPrivate::setItems(const QStringList &unsortedItems, Qt::SortO
     }
 }
 
+QByteArray MLocaleBucketsPrivate::indexFingerprint(Qt::SortOrder sortOrder) const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray collationLocaleName = locale.categoryName(MLocale::MLcCollate).toUtf8();
+    hash.addData(collationLocaleName.constData(), collationLocaleName.size() + 1);
+#ifdef HAVE_ICU
+    UVersionInfo icuVersion;
+    u_getVersion(icuVersion);
+    hash.addData(reinterpret_cast<const char *>(icuVersion), sizeof(icuVersion));
+    UErrorCode status = U_ZERO_ERROR;
+    UCollator *coll = ucol_open(collationLocaleName.constData(), &status);
+    if (U_SUCCESS(status)) {
+        UVersionInfo collatorVersion;
+        ucol_getVersion(coll, collatorVersion);
+        hash.addData(reinterpret_cast<const char *>(collatorVersion), sizeof(collatorVersion));
+    }
+    ucol_close(coll);
+#endif
+    // the bucket names depend on the locale data as well:
+    foreach (const QString &bucket, allBuckets) {
+        hash.addData(reinterpret_cast<const char *>(bucket.utf16()), (bucket.size() + 1) * sizeof(ushort));
+    }
+    quint32 order = sortOrder;
+    hash.addData(reinterpret_cast<const char *>(&order), sizeof(order));
+    return hash.result();
+}
+
+QByteArray MLocaleBucketsPrivate::itemsChecksum(const QStringList &items)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    foreach (const QString &item, items) {
+        quint32 size = item.size();
+        hash.addData(reinterpret_cast<const char *>(&size), sizeof(size));
+        hash.addData(reinterpret_cast<const char *>(item.utf16()), size * sizeof(ushort));
+    }
+    return hash.result();
+}
+
+bool MLocaleBucketsPrivate::setItemsFromIndex(const QStringList &unsortedItems,
+                                              const QString &fileName,
+                                              Qt::SortOrder sortOrder)
+{
+    // Remember to call clear() first if this is called from somewhere else than a constructor!
+    const QByteArray fingerprint = indexFingerprint(sortOrder);
+    const QByteArray checksum = itemsChecksum(unsortedItems);
+    const quint32 itemCount = unsortedItems.size();
+
+    QFile file(fileName);
+    const uchar *data = 0;
+    qint64 fileSize = 0;
+    if (file.open(QIODevice::ReadOnly)) {
+        fileSize = file.size();
+        if (fileSize >= qint64(sizeof(MLocaleBucketsIndexHeader)))
+            data = file.map(0, fileSize);
+    }
+
+    const MLocaleBucketsIndexHeader *header =
+        reinterpret_cast<const MLocaleBucketsIndexHeader *>(data);
+    if (header
+        && (memcmp(header->magic, IndexMagic, sizeof(IndexMagic)) != 0
+            || header->version != IndexVersion
+            || header->byteOrderMark != IndexByteOrderMark
+            || header->fileSize != fileSize
+            || memcmp(header->fingerprint, fingerprint.constData(), sizeof(header->fingerprint)) != 0
+            // check that all tables are inside of the file:
+            || header->entriesOffset % 4 != 0
+            || header->bucketsOffset % 4 != 0
+            || header->namesOffset % 2 != 0
+            || header->entriesOffset < sizeof(MLocaleBucketsIndexHeader)
+            || header->entriesOffset + qint64(header->itemCount) * sizeof(MLocaleBucketsIndexEntry) > header->bucketsOffset
+            || header->bucketsOffset + qint64(header->bucketCount) * sizeof(MLocaleBucketsIndexBucket) > header->namesOffset
+            || header->namesOffset > fileSize)) {
+        // written by a different version, for a different locale or
+        // broken, nothing can be reused:
+        header = 0;
+    }
+
+    if (header
+        && header->itemCount == itemCount
+        && memcmp(header->itemsChecksum, checksum.constData(), sizeof(header->itemsChecksum)) == 0) {
+        // The index is up to date, take the order and the buckets from
+        // there without any collation:
+        const MLocaleBucketsIndexEntry *entries =
+            reinterpret_cast<const MLocaleBucketsIndexEntry *>(data + header->entriesOffset);
+        const MLocaleBucketsIndexBucket *indexBuckets =
+            reinterpret_cast<const MLocaleBucketsIndexBucket *>(data + header->bucketsOffset);
+        const QChar *names = reinterpret_cast<const QChar *>(data + header->namesOffset);
+        const quint32 namesSize = (fileSize - header->namesOffset) / sizeof(QChar);
+        QVector<bool> seen(itemCount, false);
+        bool valid = (itemCount == 0) == (header->bucketCount == 0);
+        for (quint32 b = 0; valid && b < header->bucketCount; ++b) {
+            const MLocaleBucketsIndexBucket &bucket = indexBuckets[b];
+            const quint32 end = b + 1 < header->bucketCount ?
+                indexBuckets[b + 1].firstEntry : itemCount;
+            if ((b == 0 && bucket.firstEntry != 0)
+                || bucket.firstEntry >= end || end > itemCount
+                || bucket.nameOffset > namesSize
+                || bucket.nameLength > namesSize - bucket.nameOffset) {
+                valid = false;
+                break;
+            }
+            QStringList items;
+            QList<int> indices;
+            for (quint32 e = bucket.firstEntry; e < end; ++e) {
+                const quint32 origIndex = entries[e].origIndex;
+                if (origIndex >= itemCount || seen[origIndex]) {
+                    valid = false;
+                    break;
+                }
+                seen[origIndex] = true;
+                items << unsortedItems.at(origIndex);
+                indices << origIndex;
+            }
+            buckets << QString(names + bucket.nameOffset, bucket.nameLength);
+            bucketItems << items;
+            origIndices << indices;
+        }
+        if (valid) {
+            this->sortOrder = sortOrder;
+            return true;
+        }
+        clear();
+        header = 0;
+    }
+
+    // The index is outdated. If it was written for the same locale,
+    // the order of the items which are still there can be reused and
+    // only the new items need to be sorted and merged in.
+    QList<MLocaleBucketItem> sortedItems;
+    MLocaleBucketItemComparator comparator(sortOrder);
+    bool reused = false;
+    if (header) {
+        QHash<uint, QList<int> > newIndicesByHash;
+        for (quint32 i = 0; i < itemCount; ++i)
+            newIndicesByHash[qHash(unsortedItems.at(i))].append(i);
+
+        const MLocaleBucketsIndexEntry *entries =
+            reinterpret_cast<const MLocaleBucketsIndexEntry *>(data + header->entriesOffset);
+        QVector<bool> used(itemCount, false);
+        QList<MLocaleBucketItem> oldItems;
+        for (quint32 e = 0; e < header->itemCount; ++e) {
+            QHash<uint, QList<int> >::iterator it = newIndicesByHash.find(entries[e].itemHash);
+            if (it == newIndicesByHash.end() || it->isEmpty())
+                continue;
+            const int i = it->takeFirst();
+            used[i] = true;
+            oldItems.append(MLocaleBucketItem(unsortedItems.at(i), i));
+        }
+
+        // The hashes only say which items are probably the same, the
+        // order is verified with the collator. This needs only one
+        // comparison per item and guarantees that the result is
+        // exactly the same as sorting from scratch:
+        reused = true;
+        for (int k = 1; k < oldItems.size(); ++k) {
+            if (!comparator.stableLessThan(oldItems.at(k - 1), oldItems.at(k))) {
+                reused = false;
+                break;
+            }
+        }
+
+        if (reused) {
+            QList<MLocaleBucketItem> newItems;
+            for (quint32 i = 0; i < itemCount; ++i) {
+                if (!used[i])
+                    newItems.append(MLocaleBucketItem(unsortedItems.at(i), i));
+            }
+            qStableSort(newItems.begin(), newItems.end(), comparator);
+
+            int o = 0;
+            int n = 0;
+            while (o < oldItems.size() && n < newItems.size()) {
+                if (comparator.stableLessThan(newItems.at(n), oldItems.at(o)))
+                    sortedItems.append(newItems.at(n++));
+                else
+                    sortedItems.append(oldItems.at(o++));
+            }
+            while (o < oldItems.size())
+                sortedItems.append(oldItems.at(o++));
+            while (n < newItems.size())
+                sortedItems.append(newItems.at(n++));
+        }
+    }
+
+    if (data)
+        file.unmap(const_cast<uchar *>(data));
+    file.close();
+
+    if (reused) {
+        this->sortOrder = sortOrder;
+        fillBuckets(sortedItems);
+    }
+    else {
+        setItems(unsortedItems, sortOrder);
+    }
+
+    if (!writeIndex(fileName))
+        qWarning() << __PRETTY_FUNCTION__ << "could not write index file" << fileName;
+    return false;
+}
+
+bool MLocaleBucketsPrivate::writeIndex(const QString &fileName) const
+{
+    // Restore the original item list, the original indices are
+    // always 0 ... n-1, even after removeBucketItems():
+    int itemCount = 0;
+    foreach (const QStringList &items, bucketItems)
+        itemCount += items.size();
+    QVector<QString> origItems(itemCount);
+    for (int b = 0; b < bucketItems.size(); ++b) {
+        const QStringList &items = bucketItems.at(b);
+        const QList<int> &indices = origIndices.at(b);
+        for (int i = 0; i < items.size(); ++i) {
+            const int origIndex = indices.at(i);
+            if (origIndex < 0 || origIndex >= itemCount)
+                return false;
+            origItems[origIndex] = items.at(i);
+        }
+    }
+
+    QByteArray entries;
+    QByteArray indexBuckets;
+    QByteArray names;
+    quint32 entryCount = 0;
+    for (int b = 0; b < bucketItems.size(); ++b) {
+        MLocaleBucketsIndexBucket bucket;
+        bucket.firstEntry = entryCount;
+        bucket.nameOffset = names.size() / sizeof(QChar);
+        bucket.nameLength = buckets.at(b).size();
+        indexBuckets.append(reinterpret_cast<const char *>(&bucket), sizeof(bucket));
+        names.append(reinterpret_cast<const char *>(buckets.at(b).utf16()),
+                     buckets.at(b).size() * sizeof(QChar));
+        const QStringList &items = bucketItems.at(b);
+        const QList<int> &indices = origIndices.at(b);
+        for (int i = 0; i < items.size(); ++i) {
+            MLocaleBucketsIndexEntry entry;
+            entry.origIndex = indices.at(i);
+            entry.itemHash = qHash(items.at(i));
+            entries.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+            ++entryCount;
+        }
+    }
+
+    MLocaleBucketsIndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    header.version = IndexVersion;
+    header.byteOrderMark = IndexByteOrderMark;
+    memcpy(header.fingerprint, indexFingerprint(sortOrder).constData(), sizeof(header.fingerprint));
+    memcpy(header.itemsChecksum, itemsChecksum(origItems.toList()).constData(), sizeof(header.itemsChecksum));
+    header.itemCount = entryCount;
+    header.bucketCount = bucketItems.size();
+    header.entriesOffset = sizeof(header);
+    header.bucketsOffset = header.entriesOffset + entries.size();
+    header.namesOffset = header.bucketsOffset + indexBuckets.size();
+    header.fileSize = header.namesOffset + names.size();
+
+    // write to a temporary file first so that readers never see a
+    // half written index:
+    const QString tmpFileName = fileName + QLatin1String(".tmp");
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+        && file.write(entries) == entries.size()
+        && file.write(indexBuckets) == indexBuckets.size()
+        && file.write(names) == names.size();
+    file.close();
+    if (ok) {
+        QFile::remove(fileName);
+        ok = QFile::rename(tmpFileName, fileName);
+    }
+    if (!ok)
+        QFile::remove(tmpFileName);
+    return ok;
+}
+
 void MLocaleBucketsPrivate::clear()
 {
     buckets.clear();
@@ -134,6 +464,7 @@ void MLocaleBucketsPrivate::copy(const MLocaleBuckets &other)
     buckets     = other.d_func()->buckets;
     locale      = other.d_func()->locale;
     origIndices = other.d_func()->origIndices;
+    sortOrder   = other.d_func()->sortOrder;
 #ifdef HAVE_ICU
     collator    = other.d_func()->collator;
 #endif
@@ -189,6 +520,31 @@ void MLocaleBuckets::setItems(const QStringList &items, Qt::SortOrder sortOrder)
     d->setItems(items, sortOrder);
 }
 
+void MLocaleBuckets::setSortedItems(const QList<QStringList> &sortedItemLists,
+                                    Qt::SortOrder sortOrder)
+{
+    Q_D(MLocaleBuckets);
+
+    d->clear();
+    d->setSortedItems(sortedItemLists, sortOrder);
+}
+
+bool MLocaleBuckets::setItems(const QStringList &items, const QString &indexFileName,
+                              Qt::SortOrder sortOrder)
+{
+    Q_D(MLocaleBuckets);
+
+    d->clear();
+    return d->setItemsFromIndex(items, indexFileName, sortOrder);
+}
+
+bool MLocaleBuckets::writeIndex(const QString &indexFileName) const
+{
+    Q_D(const MLocaleBuckets);
+
+    return d->writeIndex(indexFileName);
+}
+
 int MLocaleBuckets::bucketCount() const
 {
     Q_D(const MLocaleBuckets);
@@ -158,6 +158,55 @@ public:
      */
     void setItems(const QStringList &unsortedItems, Qt::SortOrder sortOrder = Qt::AscendingOrder);
 
+    /*!
+     * \brief Set the items for this MLocaleBuckets object from lists which
+     * are already sorted.
+     *
+     * Each of the lists must already be sorted in \a sortOrder according to
+     * locale rules, for example because it comes from another MLocaleBuckets
+     * object. The lists are merged instead of sorting all items again.
+     *
+     * The result is the same as calling setItems() with all lists
+     * concatenated, the original index of an item is its index in that
+     * concatenated list.
+     */
+    void setSortedItems(const QList<QStringList> &sortedItemLists,
+                        Qt::SortOrder sortOrder = Qt::AscendingOrder);
+
+    /*!
+     * \brief Set the items for this MLocaleBuckets object, using an index
+     * file to avoid sorting them again.
+     *
+     * This gives the same result as setItems() without an index file, but
+     * if the same list is set again, for example whenever an application
+     * starts, the sorted order and the buckets are taken from the memory
+     * mapped index file written the last time instead of collating all
+     * items again.
+     *
+     * The index file is only used if it was written for the same
+     * collation locale, ICU version, collator version and sort order.
+     * If the items have changed since it was written, the order of
+     * the items which are still in the list is reused and only new
+     * items are sorted and merged in. In any case the index file is
+     * then rewritten for the current items.
+     *
+     * Returns true if the index file was up to date, false if the
+     * items had to be sorted (partially) again.
+     *
+     * \sa writeIndex()
+     */
+    bool setItems(const QStringList &unsortedItems, const QString &indexFileName,
+                  Qt::SortOrder sortOrder = Qt::AscendingOrder);
+
+    /*!
+     * \brief Write an index file for the current items and buckets.
+     *
+     * The file can be used later with setItems() to restore the
+     * buckets without sorting the items again. Returns false if the file
+     * could not be written.
+     */
+    bool writeIndex(const QString &indexFileName) const;
+
     /*!
      * \brief Return the number of buckets.
      */
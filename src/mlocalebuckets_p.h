@@ -32,6 +32,47 @@ namespace ML10N {
 
 class MLocaleBuckets;
 
+// Helper class to retain the original index for items during sorting
+struct MLocaleBucketItem
+{
+    QString text;
+    int origIndex;
+
+    MLocaleBucketItem(QString text, int origIndex) :
+        text(text), origIndex(origIndex) {}
+};
+
+// Layout of the index files written by MLocaleBuckets::writeIndex().
+// All numbers are in the byte order of the machine which wrote the
+// file, all offsets are relative to the start of the file.
+struct MLocaleBucketsIndexHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    char fingerprint[20];      // sha1 of collation locale, icu version, sort order, ...
+    char itemsChecksum[20];    // sha1 of the items in their original order
+    quint32 itemCount;
+    quint32 bucketCount;
+    quint32 entriesOffset;     // itemCount MLocaleBucketsIndexEntry in sorted order
+    quint32 bucketsOffset;     // bucketCount MLocaleBucketsIndexBucket
+    quint32 namesOffset;       // utf-16 bucket names
+    quint32 fileSize;
+};
+
+struct MLocaleBucketsIndexEntry
+{
+    quint32 origIndex;
+    quint32 itemHash;          // qHash() of the item
+};
+
+struct MLocaleBucketsIndexBucket
+{
+    quint32 firstEntry;
+    quint32 nameOffset;        // in QChars, relative to namesOffset
+    quint32 nameLength;        // in QChars
+};
+
 class MLocaleBucketsPrivate
 {
     Q_DECLARE_PUBLIC(MLocaleBuckets)
@@ -40,6 +81,13 @@ class MLocaleBucketsPrivate
     void copy(const MLocaleBuckets &other);
 
     void setItems(const QStringList &items, Qt::SortOrder sortOrder);
+    void setSortedItems(const QList<QStringList> &sortedItemLists, Qt::SortOrder sortOrder);
+    void fillBuckets(const QList<MLocaleBucketItem> &sortedItems);
+    bool setItemsFromIndex(const QStringList &items, const QString &fileName,
+                           Qt::SortOrder sortOrder);
+    bool writeIndex(const QString &fileName) const;
+    QByteArray indexFingerprint(Qt::SortOrder sortOrder) const;
+    static QByteArray itemsChecksum(const QStringList &items);
     void clear();
     bool removeBucketItems(int bucketIndex, int itemIndex, int count);
     void removeEmptyBucket(int bucketIndex);
@@ -58,21 +106,12 @@ class MLocaleBucketsPrivate
     // Intentionally not using QList to avoid flattening the list
     // when trying to append another QStringList
     QVector<QList<int> > origIndices;
+    Qt::SortOrder sortOrder;
 
     MLocaleBuckets *q_ptr;
 };
 
 
-// Helper class to retain the original index for items during sorting
-struct MLocaleBucketItem
-{
-    QString text;
-    int origIndex;
-
-    MLocaleBucketItem(QString text, int origIndex) :
-        text(text), origIndex(origIndex) {}
-};
-
 
 
 // Functor for qStableSort() comparison
@@ -103,6 +142,17 @@ public:
 #endif
     }
 
+    // The order qStableSort() creates with operator(): items which
+    // compare equal keep the order of their original indices
+    bool stableLessThan(const MLocaleBucketItem &left, const MLocaleBucketItem &right)
+    {
+        if (operator()(left, right))
+            return true;
+        if (operator()(right, left))
+            return false;
+        return left.origIndex < right.origIndex;
+    }
+
 private:
 #ifdef HAVE_ICU
     MCollator collator;
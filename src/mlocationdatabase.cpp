@@ -20,11 +20,24 @@
 #include "mlocationdatabase.h"
 
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDir>
 #include <QTextStream>
 #include <QDomDocument>
-#include <QStringMatcher>
 #include <QStringList>
+#include <QVector>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QFutureInterface>
 #include <QDebug>
+#include <qnumeric.h>
+
+#include <string.h>
+#include <math.h>
 
 #ifdef HAVE_ICU
 #include <unicode/timezone.h>
@@ -35,25 +48,248 @@ namespace ML10N {
 static const QString path = "/usr/share/meegotouch/locationdatabase/";
 static const QString zoneAliasFile = "/usr/share/tzdata-timed/zone.alias";
 static const QString zoneAliasFileFallback = ":/zone.alias.fallback";
+static const QString binaryDatabaseFile = path + "locationdatabase.bin";
+
+static const char BinaryDatabaseMagic[8] = { 'M', 'L', 'O', 'C', 'D', 'B', 'I', 'N' };
+static const quint32 BinaryDatabaseVersion = 1;
+static const quint32 BinaryDatabaseByteOrderMark = 0x01020304;
+static const int BinaryDatabaseSourceCount = 3;
+// mean radius of the earth:
+static const double EarthRadiusKm = 6371.0;
+
+// Layout of the binary location database written by
+// MLocationDatabase::writeBinaryDatabase(). All numbers are in the
+// byte order of the machine which wrote the file, all offsets are
+// relative to the start of the file and all tables are 8 byte aligned.
+// There are no index tables, loadBinaryDatabase() copies the records
+// and buildIndexes() indexes them like the data parsed from the xml.
+struct MLocationDatabaseHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrderMark;
+    // countries.xml, cities.xml and zone.alias the file was generated
+    // from, -1 if the file did not exist:
+    qint64 sourceModified[BinaryDatabaseSourceCount]; // msecs since the epoch
+    qint64 sourceSize[BinaryDatabaseSourceCount];
+    quint32 countryCount;
+    quint32 cityCount;
+    quint32 aliasCount;
+    quint32 countriesOffset;   // countryCount MLocationDatabaseCountryRecord
+    quint32 citiesOffset;      // cityCount MLocationDatabaseCityRecord
+    quint32 aliasesOffset;     // aliasCount MLocationDatabaseAliasRecord
+    quint32 stringsOffset;     // utf-16 string pool up to the end of the file
+    quint32 fileSize;
+};
+
+struct MLocationDatabaseString
+{
+    quint32 offset;            // in QChars, relative to stringsOffset
+    quint32 length;            // in QChars
+};
+
+struct MLocationDatabaseCountryRecord
+{
+    MLocationDatabaseString key;
+    MLocationDatabaseString englishName;
+    MLocationDatabaseString localName;
+    MLocationDatabaseString countryCode;
+};
+
+struct MLocationDatabaseCityRecord
+{
+    MLocationDatabaseString key;
+    MLocationDatabaseString englishName;
+    MLocationDatabaseString localName;
+    MLocationDatabaseString timeZone;
+    qint32 country;            // index into the country table, -1 if none
+    quint32 reserved;
+    double latitude;
+    double longitude;
+};
+
+struct MLocationDatabaseAliasRecord
+{
+    MLocationDatabaseString alias;
+    MLocationDatabaseString canonical;
+};
+
+static QString removeAccents(const QString &str)
+{
+    QString result;
+    for(int i = 0; i < str.size(); ++i) {
+        QString decomposition = str[i].decomposition();
+        if(decomposition == "")
+            result += str[i];
+        else
+            for(int j = 0; j < decomposition.size(); ++j)
+                if(!decomposition[j].isMark())
+                    result += decomposition[j];
+    }
+    return result;
+}
+
+// matchingCities() ignores case and accents
+static QString foldForMatching(const QString &str)
+{
+    return removeAccents(str).toCaseFolded();
+}
+
+static quint64 trigramKey(const QChar *trigram)
+{
+    return quint64(trigram[0].unicode()) << 32
+        | quint64(trigram[1].unicode()) << 16
+        | quint64(trigram[2].unicode());
+}
 
+static bool postingListLessThan(const QVector<int> *left, const QVector<int> *right)
+{
+    return left->size() < right->size();
+}
+
+// Node of the k-d tree over the positions of the cities as points on
+// the unit sphere. The tree is stored implicitly in one array, the
+// root of the subtree in [begin, end) is at (begin + end) / 2.
+struct MLocationDatabaseKdNode
+{
+    double point[3];
+    int city;                  // index into MLocationDatabasePrivate::cityList
+    int axis;                  // axis this node splits its subtree at
+};
+
+class MLocationDatabaseKdNodeLessThan
+{
+public:
+    MLocationDatabaseKdNodeLessThan(int axis)
+        : axis(axis)
+    {
+    }
+
+    bool operator()(const MLocationDatabaseKdNode &left, const MLocationDatabaseKdNode &right) const
+    {
+        return left.point[axis] < right.point[axis];
+    }
+
+    int axis;
+};
+
+// A city found in the k-d tree and its squared chord distance
+struct MLocationDatabaseNeighbour
+{
+    MLocationDatabaseNeighbour()
+        : distance(0), city(-1)
+    {
+    }
+
+    MLocationDatabaseNeighbour(double distance, int city)
+        : distance(distance), city(city)
+    {
+    }
+
+    bool operator<(const MLocationDatabaseNeighbour &other) const
+    {
+        return distance < other.distance
+            || (distance == other.distance && city < other.city);
+    }
+
+    double distance;
+    int city;
+};
+
+// The data is shared by all MLocationDatabase instances of the process
+// and freed with the last of them. It is loaded on the first query or by
+// loadInBackground() and is not modified after that, so it can be read
+// from several threads without locking.
 class MLocationDatabasePrivate
 {
 public:
     MLocationDatabasePrivate();
+    static MLocationDatabasePrivate *acquire();
+    static void release(MLocationDatabasePrivate *d);
+    void load();
     bool loadCountries();
     bool loadCities();
     bool loadTimeZoneData();
     bool loadCapitals();
+    void buildIndexes();
+    QVector<int> orderTimeZoneCities(const QString &timeZoneId,
+                                     const QVector<int> &timeZoneCities) const;
+    QList<MCity> indexedCities(const QVector<int> &indices) const;
+    bool nameMatches(int city, const QString &foldedSearchString) const;
+    void buildKdTree(int begin, int end);
+    void nearestInKdTree(int begin, int end, const double *point,
+                         int *bestCity, double *bestDistance) const;
+    void nearestInKdTree(int begin, int end, const double *point, int count,
+                         QVector<MLocationDatabaseNeighbour> *nearest) const;
+    void withinInKdTree(int begin, int end, const double *point, double maxDistance,
+                        QVector<MLocationDatabaseNeighbour> *within) const;
+    QList<MCity> neighbourCities(const QVector<MLocationDatabaseNeighbour> &neighbours) const;
+    static double squaredDistance(const double *point1, const double *point2);
+    static void unitVector(qreal latitude, qreal longitude, double *point);
+    bool loadXml();
+    bool loadBinaryDatabase(const QString &fileName);
+    bool writeBinaryDatabase(const QString &fileName) const;
+    static void sourceStamps(qint64 *modified, qint64 *size);
+    static QString userBinaryDatabaseFile();
     QString canonicalizeTimeZoneId(QString timeZoneId);
 
     QHash<QString, MCity> cities;
     QHash<QString, MCountry> countries;
     QHash<QString, QString> canonicalTimeZoneIds;
     QHash<QString, QString> capitals;
+    // the cities in the order of the indexes below:
+    QVector<MCity> cityList;
+    QVector<MLocationDatabaseKdNode> kdTree;
+    // indices into cityList by country key and canonical time zone id
+    // in the order citiesInCountry() and citiesInTimeZone() return them:
+    QHash<QString, QVector<int> > citiesByCountry;
+    QHash<QString, QVector<int> > citiesByTimeZone;
+    // the english and local names of the cities, folded for matching,
+    // and the cities containing each trigram of them in ascending order:
+    QVector<QString> foldedNames;
+    QHash<quint64, QVector<int> > trigramIndex;
+    // stamps of the source files the data was loaded from:
+    qint64 sourceModified[BinaryDatabaseSourceCount];
+    qint64 sourceSize[BinaryDatabaseSourceCount];
+
+    QAtomicInt ref;
+    QMutex loadMutex;
+    mutable QAtomicInt loaded;
+};
+
+static QMutex sharedDatabaseMutex;
+static MLocationDatabasePrivate *sharedDatabase = 0;
+
+// Loads the shared data on a thread of the global thread pool, keeping
+// it alive even if all MLocationDatabase instances are deleted meanwhile
+class MLocationDatabaseLoadTask : public QRunnable
+{
+public:
+    MLocationDatabaseLoadTask(MLocationDatabasePrivate *d)
+        : d(d)
+    {
+        future.reportStarted();
+    }
+
+    virtual void run()
+    {
+        d->load();
+        MLocationDatabasePrivate::release(d);
+        future.reportFinished();
+    }
+
+    MLocationDatabasePrivate *d;
+    QFutureInterface<void> future;
 };
 
 MLocationDatabasePrivate::MLocationDatabasePrivate()
+    : ref(0),
+      loaded(0)
 {
+    for (int i = 0; i < BinaryDatabaseSourceCount; ++i) {
+        sourceModified[i] = -1;
+        sourceSize[i] = -1;
+    }
 }
 
 bool MLocationDatabasePrivate::loadCountries()
@@ -245,7 +481,7 @@ bool MLocationDatabasePrivate::loadTimeZoneData()
 QString MLocationDatabasePrivate::canonicalizeTimeZoneId(QString timeZoneId)
 {
     // returns an empty string if the hash does not contain the key:
-    return canonicalTimeZoneIds[timeZoneId];
+    return canonicalTimeZoneIds.value(timeZoneId);
 }
 
 bool MLocationDatabasePrivate::loadCapitals()
@@ -274,39 +510,595 @@ bool MLocationDatabasePrivate::loadCapitals()
     return true;
 }
 
-MLocationDatabase::MLocationDatabase()
-    : d_ptr( new MLocationDatabasePrivate )
+bool MLocationDatabasePrivate::loadXml()
 {
-    if ( ! d_ptr->loadTimeZoneData() )
+    // take the stamps before reading, a source file changing while it
+    // is read makes the binary database stale instead of wrong:
+    sourceStamps(sourceModified, sourceSize);
+
+    bool ok = true;
+    if ( ! loadTimeZoneData() )
     {
         qWarning( "loading of time zone data failed." );
+        ok = false;
     }
-    if ( ! d_ptr->loadCountries() )
+    if ( ! loadCountries() )
     {
         qWarning( "loading of country list failed." );
+        ok = false;
     }
 
-    if ( ! d_ptr->loadCities() )
+    if ( ! loadCities() )
     {
         qWarning( "loading of city list failed." );
+        ok = false;
+    }
+    return ok;
+}
+
+void MLocationDatabasePrivate::sourceStamps(qint64 *modified, qint64 *size)
+{
+    const QString sources[BinaryDatabaseSourceCount] = {
+        path + "countries.xml",
+        path + "cities.xml",
+        zoneAliasFile
+    };
+    for (int i = 0; i < BinaryDatabaseSourceCount; ++i) {
+        QFileInfo info(sources[i]);
+        if (info.exists()) {
+#if QT_VERSION >= 0x040700
+            modified[i] = info.lastModified().toMSecsSinceEpoch();
+#else
+            // Qt < 4.7 lacks QDateTime::toMSecsSinceEpoch(), seconds
+            // are precise enough to notice a changed file:
+            modified[i] = info.lastModified().toTime_t() * 1000LL;
+#endif
+            size[i] = info.size();
+        }
+        else {
+            modified[i] = -1;
+            size[i] = -1;
+        }
+    }
+}
+
+QString MLocationDatabasePrivate::userBinaryDatabaseFile()
+{
+    QString cacheDir = QFile::decodeName(qgetenv("XDG_CACHE_HOME"));
+    if (cacheDir.isEmpty())
+        cacheDir = QDir::homePath() + QLatin1String("/.cache");
+    return cacheDir + QLatin1String("/mlocale/locationdatabase.bin");
+}
+
+static bool binaryDatabaseString(const QChar *strings, quint32 stringCount,
+                                 const MLocationDatabaseString &string, QString *result)
+{
+    if (string.offset > stringCount || string.length > stringCount - string.offset)
+        return false;
+    *result = QString(strings + string.offset, string.length);
+    return true;
+}
+
+bool MLocationDatabasePrivate::loadBinaryDatabase(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    const qint64 fileSize = file.size();
+    if (fileSize < qint64(sizeof(MLocationDatabaseHeader)))
+        return false;
+    const uchar *data = file.map(0, fileSize);
+    if (!data)
+        return false;
+
+    qint64 modified[BinaryDatabaseSourceCount];
+    qint64 size[BinaryDatabaseSourceCount];
+    sourceStamps(modified, size);
+
+    const MLocationDatabaseHeader *header =
+        reinterpret_cast<const MLocationDatabaseHeader *>(data);
+    bool valid =
+        memcmp(header->magic, BinaryDatabaseMagic, sizeof(BinaryDatabaseMagic)) == 0
+        && header->version == BinaryDatabaseVersion
+        && header->byteOrderMark == BinaryDatabaseByteOrderMark
+        && header->fileSize == fileSize
+        // generated from different xml files, the database is stale:
+        && memcmp(header->sourceModified, modified, sizeof(modified)) == 0
+        && memcmp(header->sourceSize, size, sizeof(size)) == 0
+        // check that all tables are inside of the file:
+        && header->countriesOffset % 8 == 0
+        && header->citiesOffset % 8 == 0
+        && header->aliasesOffset % 8 == 0
+        && header->stringsOffset % 2 == 0
+        && header->countriesOffset >= sizeof(MLocationDatabaseHeader)
+        && header->countriesOffset + qint64(header->countryCount) * sizeof(MLocationDatabaseCountryRecord) <= header->citiesOffset
+        && header->citiesOffset + qint64(header->cityCount) * sizeof(MLocationDatabaseCityRecord) <= header->aliasesOffset
+        && header->aliasesOffset + qint64(header->aliasCount) * sizeof(MLocationDatabaseAliasRecord) <= header->stringsOffset
+        && header->stringsOffset <= fileSize;
+
+    QHash<QString, MCountry> binaryCountries;
+    QHash<QString, MCity> binaryCities;
+    QHash<QString, QString> binaryTimeZoneIds;
+    if (valid) {
+        const QChar *strings = reinterpret_cast<const QChar *>(data + header->stringsOffset);
+        const quint32 stringCount = (fileSize - header->stringsOffset) / sizeof(QChar);
+
+        const MLocationDatabaseCountryRecord *countryRecords =
+            reinterpret_cast<const MLocationDatabaseCountryRecord *>(data + header->countriesOffset);
+        QVector<MCountry> countryList(header->countryCount);
+        QString text;
+        for (quint32 i = 0; valid && i < header->countryCount; ++i) {
+            const MLocationDatabaseCountryRecord &record = countryRecords[i];
+            MCountry &country = countryList[i];
+            valid = binaryDatabaseString(strings, stringCount, record.key, &text);
+            country.setKey(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.englishName, &text);
+            country.setEnglishName(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.localName, &text);
+            country.setLocalName(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.countryCode, &text);
+            country.setCountryCode(text);
+            binaryCountries[country.key()] = country;
+        }
+
+        const MLocationDatabaseCityRecord *cityRecords =
+            reinterpret_cast<const MLocationDatabaseCityRecord *>(data + header->citiesOffset);
+        for (quint32 i = 0; valid && i < header->cityCount; ++i) {
+            const MLocationDatabaseCityRecord &record = cityRecords[i];
+            MCity city;
+            valid = binaryDatabaseString(strings, stringCount, record.key, &text);
+            city.setKey(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.englishName, &text);
+            city.setEnglishName(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.localName, &text);
+            city.setLocalName(text);
+            valid = valid && binaryDatabaseString(strings, stringCount, record.timeZone, &text);
+            city.setTimeZone(text);
+            if (record.country >= 0 && quint32(record.country) < header->countryCount)
+                city.setCountry(countryList.at(record.country));
+            else if (record.country != -1)
+                valid = false;
+            city.setLatitude(record.latitude);
+            city.setLongitude(record.longitude);
+            binaryCities[city.key()] = city;
+        }
+
+        const MLocationDatabaseAliasRecord *aliasRecords =
+            reinterpret_cast<const MLocationDatabaseAliasRecord *>(data + header->aliasesOffset);
+        QString alias;
+        for (quint32 i = 0; valid && i < header->aliasCount; ++i) {
+            valid = binaryDatabaseString(strings, stringCount, aliasRecords[i].alias, &alias)
+                && binaryDatabaseString(strings, stringCount, aliasRecords[i].canonical, &text);
+            binaryTimeZoneIds[alias] = text;
+        }
     }
 
-    if ( ! d_ptr->loadCapitals() )
+    if (valid) {
+        countries = binaryCountries;
+        cities = binaryCities;
+        canonicalTimeZoneIds = binaryTimeZoneIds;
+        memcpy(sourceModified, header->sourceModified, sizeof(sourceModified));
+        memcpy(sourceSize, header->sourceSize, sizeof(sourceSize));
+    }
+    file.unmap(const_cast<uchar *>(data));
+    file.close();
+    return valid;
+}
+
+static MLocationDatabaseString appendBinaryDatabaseString(const QString &text, QByteArray *strings,
+                                                          QHash<QString, quint32> *stringOffsets)
+{
+    MLocationDatabaseString string;
+    string.length = text.size();
+    // many cities share their names and time zones:
+    QHash<QString, quint32>::const_iterator it = stringOffsets->constFind(text);
+    if (it != stringOffsets->constEnd()) {
+        string.offset = it.value();
+    }
+    else {
+        string.offset = strings->size() / sizeof(QChar);
+        strings->append(reinterpret_cast<const char *>(text.utf16()), text.size() * sizeof(QChar));
+        stringOffsets->insert(text, string.offset);
+    }
+    return string;
+}
+
+bool MLocationDatabasePrivate::writeBinaryDatabase(const QString &fileName) const
+{
+    QByteArray countryRecords;
+    QByteArray cityRecords;
+    QByteArray aliasRecords;
+    QByteArray strings;
+    QHash<QString, quint32> stringOffsets;
+    QHash<QString, qint32> countryIndices;
+
+    foreach (const MCountry &country, countries) {
+        MLocationDatabaseCountryRecord record;
+        record.key = appendBinaryDatabaseString(country.key(), &strings, &stringOffsets);
+        record.englishName = appendBinaryDatabaseString(country.englishName(), &strings, &stringOffsets);
+        record.localName = appendBinaryDatabaseString(country.localName(), &strings, &stringOffsets);
+        record.countryCode = appendBinaryDatabaseString(country.countryCode(), &strings, &stringOffsets);
+        countryIndices.insert(country.key(), countryRecords.size() / sizeof(record));
+        countryRecords.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+
+    foreach (const MCity &city, cities) {
+        MLocationDatabaseCityRecord record;
+        memset(&record, 0, sizeof(record));
+        record.key = appendBinaryDatabaseString(city.key(), &strings, &stringOffsets);
+        record.englishName = appendBinaryDatabaseString(city.englishName(), &strings, &stringOffsets);
+        record.localName = appendBinaryDatabaseString(city.localName(), &strings, &stringOffsets);
+        record.timeZone = appendBinaryDatabaseString(city.timeZone(), &strings, &stringOffsets);
+        record.country = countryIndices.value(city.country().key(), -1);
+        record.latitude = city.latitude();
+        record.longitude = city.longitude();
+        cityRecords.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+
+    QHash<QString, QString>::const_iterator it = canonicalTimeZoneIds.constBegin();
+    for (; it != canonicalTimeZoneIds.constEnd(); ++it) {
+        MLocationDatabaseAliasRecord record;
+        record.alias = appendBinaryDatabaseString(it.key(), &strings, &stringOffsets);
+        record.canonical = appendBinaryDatabaseString(it.value(), &strings, &stringOffsets);
+        aliasRecords.append(reinterpret_cast<const char *>(&record), sizeof(record));
+    }
+
+    MLocationDatabaseHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BinaryDatabaseMagic, sizeof(BinaryDatabaseMagic));
+    header.version = BinaryDatabaseVersion;
+    header.byteOrderMark = BinaryDatabaseByteOrderMark;
+    memcpy(header.sourceModified, sourceModified, sizeof(sourceModified));
+    memcpy(header.sourceSize, sourceSize, sizeof(sourceSize));
+    header.countryCount = countries.size();
+    header.cityCount = cities.size();
+    header.aliasCount = canonicalTimeZoneIds.size();
+    header.countriesOffset = sizeof(header);
+    header.citiesOffset = header.countriesOffset + countryRecords.size();
+    header.aliasesOffset = header.citiesOffset + cityRecords.size();
+    header.stringsOffset = header.aliasesOffset + aliasRecords.size();
+    header.fileSize = header.stringsOffset + strings.size();
+
+    // write to a temporary file first so that readers never see a
+    // half written database, several applications may be started at
+    // the same time:
+    const QString tmpFileName = fileName + QLatin1Char('.')
+        + QString::number(QCoreApplication::applicationPid()) + QLatin1String(".tmp");
+    QFile file(tmpFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+    bool ok = file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header)
+        && file.write(countryRecords) == countryRecords.size()
+        && file.write(cityRecords) == cityRecords.size()
+        && file.write(aliasRecords) == aliasRecords.size()
+        && file.write(strings) == strings.size();
+    file.close();
+    if (ok) {
+        QFile::remove(fileName);
+        ok = QFile::rename(tmpFileName, fileName);
+    }
+    if (!ok)
+        QFile::remove(tmpFileName);
+    return ok;
+}
+
+MLocationDatabasePrivate *MLocationDatabasePrivate::acquire()
+{
+    QMutexLocker locker(&sharedDatabaseMutex);
+    if (!sharedDatabase)
+        sharedDatabase = new MLocationDatabasePrivate;
+    sharedDatabase->ref.ref();
+    return sharedDatabase;
+}
+
+void MLocationDatabasePrivate::release(MLocationDatabasePrivate *d)
+{
+    QMutexLocker locker(&sharedDatabaseMutex);
+    if (!d->ref.deref()) {
+        if (sharedDatabase == d)
+            sharedDatabase = 0;
+        delete d;
+    }
+}
+
+void MLocationDatabasePrivate::load()
+{
+    if (loaded.testAndSetAcquire(1, 1))
+        return;
+    // blocks if another thread is loading already:
+    QMutexLocker locker(&loadMutex);
+    if (loaded.testAndSetAcquire(1, 1))
+        return;
+
+    // The binary database installed next to the xml files is
+    // preferred, then the one cached for this user. Both are only
+    // used if they were generated from the current xml files.
+    const QString userFile = userBinaryDatabaseFile();
+    if ( ! loadBinaryDatabase( binaryDatabaseFile )
+         && ! loadBinaryDatabase( userFile )
+         && loadXml() )
+    {
+        QDir().mkpath( QFileInfo( userFile ).absolutePath() );
+        if ( ! writeBinaryDatabase( userFile ) )
+        {
+            qDebug() << __PRETTY_FUNCTION__ << "could not write" << userFile;
+        }
+    }
+
+    if ( ! loadCapitals() )
     {
         qWarning( "loading of city list failed." );
     }
+    buildIndexes();
+    loaded.fetchAndStoreRelease(1);
+}
+
+void MLocationDatabasePrivate::buildIndexes()
+{
+    cityList.clear();
+    cityList.reserve(cities.size());
+    kdTree.resize(cities.size());
+    citiesByCountry.clear();
+    citiesByTimeZone.clear();
+    foreach (const MCity &city, cities) {
+        MLocationDatabaseKdNode &node = kdTree[cityList.size()];
+        unitVector(city.latitude(), city.longitude(), node.point);
+        node.city = cityList.size();
+        citiesByCountry[city.country().key()].append(cityList.size());
+        // city.timeZone is already canonical
+        citiesByTimeZone[city.timeZone()].append(cityList.size());
+        cityList.append(city);
+    }
+    buildKdTree(0, kdTree.size());
+
+    QHash<QString, QVector<int> >::iterator it = citiesByTimeZone.begin();
+    for (; it != citiesByTimeZone.end(); ++it)
+        it.value() = orderTimeZoneCities(it.key(), it.value());
+
+    foldedNames.resize(2 * cityList.size());
+    trigramIndex.clear();
+    for (int i = 0; i < cityList.size(); ++i) {
+        foldedNames[2 * i] = foldForMatching(cityList.at(i).englishName());
+        foldedNames[2 * i + 1] = foldForMatching(cityList.at(i).localName());
+        for (int n = 2 * i; n <= 2 * i + 1; ++n) {
+            const QString &name = foldedNames.at(n);
+            for (int j = 0; j + 3 <= name.size(); ++j) {
+                QVector<int> &postings = trigramIndex[trigramKey(name.constData() + j)];
+                if (postings.isEmpty() || postings.last() != i)
+                    postings.append(i);
+            }
+        }
+    }
+}
+
+bool MLocationDatabasePrivate::nameMatches(int city, const QString &foldedSearchString) const
+{
+    return foldedNames.at(2 * city).contains(foldedSearchString)
+        || foldedNames.at(2 * city + 1).contains(foldedSearchString);
+}
+
+QVector<int> MLocationDatabasePrivate::orderTimeZoneCities(const QString &timeZoneId,
+                                                           const QVector<int> &timeZoneCities) const
+{
+    // Cut out last section of timezone id, for example cut out
+    // “Tell_City” out of “America/Indiana/Tell_City” In case of
+    // canonical time zone ids, the part after the last / seems to be
+    // a city in most cases, although there are exceptions (For
+    // example “Indian/Mahe” is a canonical id but “Mahe” is an
+    // island, not a city. There are many non-canonical time zone ids
+    // which do not have a city name in the last part, for example
+    // “US/Pacific”.
+    QString canonicalCity = timeZoneId.section('/', -1);
+    canonicalCity.replace('_', ' ');
+
+    QVector<int> olsonCities;
+    QVector<int> capitalCities;
+    QVector<int> otherCities;
+    foreach (int index, timeZoneCities) {
+        const MCity &city = cityList.at(index);
+        if (removeAccents(city.englishName()).contains(canonicalCity))
+            olsonCities.append(index);
+        else if (!capitals.value(city.key()).isEmpty())
+            capitalCities.append(index);
+        else
+            otherCities.append(index);
+    }
+
+    // capitals first, then the cities named like the time zone id,
+    // each group in reverse order:
+    QVector<int> ordered;
+    ordered.reserve(timeZoneCities.size());
+    for (int i = capitalCities.size() - 1; i >= 0; --i)
+        ordered.append(capitalCities.at(i));
+    for (int i = olsonCities.size() - 1; i >= 0; --i)
+        ordered.append(olsonCities.at(i));
+    ordered += otherCities;
+    return ordered;
+}
+
+QList<MCity> MLocationDatabasePrivate::indexedCities(const QVector<int> &indices) const
+{
+    QList<MCity> list;
+#if QT_VERSION >= 0x040700
+    list.reserve(indices.size());
+#endif
+    foreach (int index, indices)
+        list.append(cityList.at(index));
+    return list;
+}
+
+void MLocationDatabasePrivate::unitVector(qreal latitude, qreal longitude, double *point)
+{
+    const double radiansPerDegree = M_PI / 180.0;
+    const double lat = latitude * radiansPerDegree;
+    const double lon = longitude * radiansPerDegree;
+    point[0] = cos(lat) * cos(lon);
+    point[1] = cos(lat) * sin(lon);
+    point[2] = sin(lat);
+}
+
+void MLocationDatabasePrivate::buildKdTree(int begin, int end)
+{
+    if (end - begin < 2) {
+        if (begin < end)
+            kdTree[begin].axis = 0;
+        return;
+    }
+    // split at the axis along which the points spread most:
+    double minimum[3] = { 2, 2, 2 };
+    double maximum[3] = { -2, -2, -2 };
+    for (int i = begin; i < end; ++i) {
+        for (int axis = 0; axis < 3; ++axis) {
+            minimum[axis] = qMin(minimum[axis], kdTree.at(i).point[axis]);
+            maximum[axis] = qMax(maximum[axis], kdTree.at(i).point[axis]);
+        }
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; ++a) {
+        if (maximum[a] - minimum[a] > maximum[axis] - minimum[axis])
+            axis = a;
+    }
+    qSort(kdTree.begin() + begin, kdTree.begin() + end, MLocationDatabaseKdNodeLessThan(axis));
+    const int middle = (begin + end) / 2;
+    kdTree[middle].axis = axis;
+    buildKdTree(begin, middle);
+    buildKdTree(middle + 1, end);
+}
+
+void MLocationDatabasePrivate::nearestInKdTree(int begin, int end, const double *point,
+                                               int *bestCity, double *bestDistance) const
+{
+    if (begin >= end)
+        return;
+    const int middle = (begin + end) / 2;
+    const MLocationDatabaseKdNode &node = kdTree.at(middle);
+    // The squared chord length grows with the great circle distance,
+    // comparing it gives the same nearest city:
+    const double distance = squaredDistance(point, node.point);
+    if (distance < *bestDistance) {
+        *bestDistance = distance;
+        *bestCity = node.city;
+    }
+    const double difference = point[node.axis] - node.point[node.axis];
+    if (difference < 0) {
+        nearestInKdTree(begin, middle, point, bestCity, bestDistance);
+        if (difference * difference < *bestDistance)
+            nearestInKdTree(middle + 1, end, point, bestCity, bestDistance);
+    }
+    else {
+        nearestInKdTree(middle + 1, end, point, bestCity, bestDistance);
+        if (difference * difference < *bestDistance)
+            nearestInKdTree(begin, middle, point, bestCity, bestDistance);
+    }
+}
+
+double MLocationDatabasePrivate::squaredDistance(const double *point1, const double *point2)
+{
+    double distance = 0;
+    for (int axis = 0; axis < 3; ++axis)
+        distance += (point1[axis] - point2[axis]) * (point1[axis] - point2[axis]);
+    return distance;
+}
+
+void MLocationDatabasePrivate::nearestInKdTree(int begin, int end, const double *point, int count,
+                                               QVector<MLocationDatabaseNeighbour> *nearest) const
+{
+    if (begin >= end)
+        return;
+    const int middle = (begin + end) / 2;
+    const MLocationDatabaseKdNode &node = kdTree.at(middle);
+    // nearest is sorted and holds at most count cities:
+    const MLocationDatabaseNeighbour neighbour(squaredDistance(point, node.point), node.city);
+    if (nearest->size() < count || neighbour < nearest->last()) {
+        nearest->insert(qUpperBound(nearest->begin(), nearest->end(), neighbour), neighbour);
+        if (nearest->size() > count)
+            nearest->remove(count);
+    }
+    const double difference = point[node.axis] - node.point[node.axis];
+    const int nearBegin = difference < 0 ? begin : middle + 1;
+    const int nearEnd = difference < 0 ? middle : end;
+    nearestInKdTree(nearBegin, nearEnd, point, count, nearest);
+    if (nearest->size() < count || difference * difference < nearest->last().distance) {
+        if (difference < 0)
+            nearestInKdTree(middle + 1, end, point, count, nearest);
+        else
+            nearestInKdTree(begin, middle, point, count, nearest);
+    }
+}
+
+void MLocationDatabasePrivate::withinInKdTree(int begin, int end, const double *point, double maxDistance,
+                                              QVector<MLocationDatabaseNeighbour> *within) const
+{
+    if (begin >= end)
+        return;
+    const int middle = (begin + end) / 2;
+    const MLocationDatabaseKdNode &node = kdTree.at(middle);
+    const double distance = squaredDistance(point, node.point);
+    if (distance <= maxDistance)
+        within->append(MLocationDatabaseNeighbour(distance, node.city));
+    const double difference = point[node.axis] - node.point[node.axis];
+    if (difference < 0 || difference * difference <= maxDistance)
+        withinInKdTree(begin, middle, point, maxDistance, within);
+    if (difference >= 0 || difference * difference <= maxDistance)
+        withinInKdTree(middle + 1, end, point, maxDistance, within);
+}
+
+QList<MCity> MLocationDatabasePrivate::neighbourCities(const QVector<MLocationDatabaseNeighbour> &neighbours) const
+{
+    QList<MCity> list;
+#if QT_VERSION >= 0x040700
+    list.reserve(neighbours.size());
+#endif
+    foreach (const MLocationDatabaseNeighbour &neighbour, neighbours)
+        list.append(cityList.at(neighbour.city));
+    return list;
+}
+
+MLocationDatabase::MLocationDatabase()
+    : d_ptr( MLocationDatabasePrivate::acquire() )
+{
 }
 
 
 MLocationDatabase::~MLocationDatabase()
 {
-    delete d_ptr;
+    MLocationDatabasePrivate::release( d_ptr );
+}
+
+bool MLocationDatabase::isLoaded() const
+{
+    Q_D(const MLocationDatabase);
+
+    // does not block while the data is being loaded:
+    return d->loaded.testAndSetAcquire( 1, 1 );
+}
+
+QFuture<void> MLocationDatabase::loadInBackground()
+{
+    Q_D(MLocationDatabase);
+
+    d->ref.ref();
+    MLocationDatabaseLoadTask *task = new MLocationDatabaseLoadTask( d );
+    QFuture<void> future = task->future.future();
+    QThreadPool::globalInstance()->start( task );
+    return future;
+}
+
+bool MLocationDatabase::writeBinaryDatabase( const QString& fileName )
+{
+    MLocationDatabasePrivate d;
+    if ( ! d.loadXml() )
+    {
+        return false;
+    }
+    return d.writeBinaryDatabase( fileName );
 }
 
 
 QList<MCountry> MLocationDatabase::countries()
 {
     Q_D(MLocationDatabase);
+    d->load();
 
     QList<MCountry> list;
 
@@ -321,6 +1113,7 @@ QList<MCountry> MLocationDatabase::countries()
 QList<MCity> MLocationDatabase::cities()
 {
     Q_D(MLocationDatabase);
+    d->load();
 
     QList<MCity> list;
 
@@ -335,109 +1128,126 @@ QList<MCity> MLocationDatabase::cities()
 QList<MCity> MLocationDatabase::citiesInCountry( const QString& countryKey )
 {
     Q_D(MLocationDatabase);
+    d->load();
 
-    QList<MCity> list;
-
-    foreach( const MCity& city, d->cities )
-    {
-        if ( city.country().key() == countryKey )
-        {
-            list.append( city );
-        }
-    }
-
-    return list;
-}
-
-static QString removeAccents(const QString &str)
-{
-    QString result;
-    for(int i = 0; i < str.size(); ++i) {
-        QString decomposition = str[i].decomposition();
-        if(decomposition == "")
-            result += str[i];
-        else
-            for(int j = 0; j < decomposition.size(); ++j)
-                if(!decomposition[j].isMark())
-                    result += decomposition[j];
-    }
-    return result;
+    return d->indexedCities( d->citiesByCountry.value( countryKey ) );
 }
 
 QList<MCity> MLocationDatabase::citiesInTimeZone(const QString& timeZoneId)
 {
     Q_D(MLocationDatabase);
-    QList<MCity> list;
+    d->load();
     QString canonicalTimeZoneId = d->canonicalizeTimeZoneId(timeZoneId);
     if(canonicalTimeZoneId.isEmpty())
-        return list;
-    // Cut out last section of timezone id, for example cut out
-    // “Tell_City” out of “America/Indiana/Tell_City” In case of
-    // canonical time zone ids, the part after the last / seems to be
-    // a city in most cases, although there are exceptions (For
-    // example “Indian/Mahe” is a canonical id but “Mahe” is an
-    // island, not a city. There are many non-canonical time zone ids
-    // which do not have a city name in the last part, for example
-    // “US/Pacific”.
-    QString canonicalCity = canonicalTimeZoneId.section('/', -1);
-    canonicalCity.replace('_', ' ');
-
-    QList<MCity> olsonCities;
-    QList<MCity> capitalCities;
-    foreach(const MCity& city, d->cities) {
-        // city.timeZone is already canonical
-        if (city.timeZone() == canonicalTimeZoneId) {
-            if(removeAccents(city.englishName()).contains(canonicalCity))
-                olsonCities.append(city);
-            else if (!d->capitals[city.key()].isEmpty())
-                capitalCities.append(city);
-            else
-                list.append(city);
-        }
-    }
-    foreach(const MCity &olsonCity, olsonCities)
-        list.prepend(olsonCity);
-    foreach(const MCity &capitalCity, capitalCities)
-        list.prepend(capitalCity);
-    return list;
+        return QList<MCity>();
+    // the order with the “most important” city first is computed
+    // when loading, see orderTimeZoneCities():
+    return d->indexedCities(d->citiesByTimeZone.value(canonicalTimeZoneId));
 }
 
 QList<MCity> MLocationDatabase::matchingCities(const QString& searchString)
 {
     Q_D(MLocationDatabase);
+    d->load();
 
     QList<MCity> list;
-    QStringMatcher *matcher = new QStringMatcher(searchString, Qt::CaseInsensitive);
-    foreach (const MCity &city, d->cities) {
-        if (matcher->indexIn(city.englishName()) != -1
-            || matcher->indexIn(city.localName()) != -1)
-        {
-            list.append( city );
+    const QString folded = foldForMatching(searchString);
+    if (folded.size() < 3) {
+        // too short for the trigram index:
+        for (int i = 0; i < d->cityList.size(); ++i) {
+            if (d->nameMatches(i, folded))
+                list.append(d->cityList.at(i));
         }
+        return list;
+    }
+
+    // Only the cities containing all trigrams of the search string can
+    // match, intersect their lists starting with the shortest:
+    QVector<const QVector<int> *> postingLists;
+    for (int j = 0; j + 3 <= folded.size(); ++j) {
+        QHash<quint64, QVector<int> >::const_iterator it =
+            d->trigramIndex.constFind(trigramKey(folded.constData() + j));
+        if (it == d->trigramIndex.constEnd())
+            return list;
+        postingLists.append(&it.value());
+    }
+    qSort(postingLists.begin(), postingLists.end(), postingListLessThan);
+    QVector<int> candidates = *postingLists.first();
+    for (int p = 1; p < postingLists.size() && !candidates.isEmpty(); ++p) {
+        const QVector<int> &postings = *postingLists.at(p);
+        if (&postings == postingLists.at(p - 1))
+            continue;
+        QVector<int> remaining;
+        foreach (int candidate, candidates) {
+            if (qBinaryFind(postings.constBegin(), postings.constEnd(), candidate) != postings.constEnd())
+                remaining.append(candidate);
+        }
+        candidates = remaining;
+    }
+
+    // the trigrams may be in a different order or in different names:
+    foreach (int candidate, candidates) {
+        if (d->nameMatches(candidate, folded))
+            list.append(d->cityList.at(candidate));
     }
-    delete matcher;
     return list;
 }
 
 MCity MLocationDatabase::nearestCity(qreal latitude, qreal longitude)
 {
     Q_D(MLocationDatabase);
+    d->load();
+
+    // positioning APIs report an unknown position as NaN, no distance
+    // to it compares smaller than any other:
+    if (d->kdTree.isEmpty() || !qIsFinite(latitude) || !qIsFinite(longitude))
+        return MCity();
+
+    double point[3];
+    MLocationDatabasePrivate::unitVector(latitude, longitude, point);
+    int bestCity = -1;
+    // larger than the longest possible squared chord, 4:
+    double bestDistance = 5;
+    d->nearestInKdTree(0, d->kdTree.size(), point, &bestCity, &bestDistance);
+    return d->cityList.at(bestCity);
+}
 
-    MCity bestCity;
-
-    qreal bestDistance = 1000000;
+QList<MCity> MLocationDatabase::nearestCities(qreal latitude, qreal longitude, int count)
+{
+    Q_D(MLocationDatabase);
+    d->load();
+
+    if (count <= 0 || !qIsFinite(latitude) || !qIsFinite(longitude))
+        return QList<MCity>();
+    QVector<MLocationDatabaseNeighbour> nearest;
+    nearest.reserve(qMin(count, d->kdTree.size()) + 1);
+    double point[3];
+    MLocationDatabasePrivate::unitVector(latitude, longitude, point);
+    d->nearestInKdTree(0, d->kdTree.size(), point, count, &nearest);
+    return d->neighbourCities(nearest);
+}
 
-    QList<MCity> list;
-    foreach(const MCity &city, d->cities) {
-        qreal distance =
-            (latitude - city.latitude()) * (latitude - city.latitude())
-            + (longitude - city.longitude()) * (longitude - city.longitude());
-        if ( distance < bestDistance ) {
-            bestDistance = distance;
-            bestCity = city;
-        }
+QList<MCity> MLocationDatabase::citiesWithin(qreal latitude, qreal longitude, qreal radiusKm)
+{
+    Q_D(MLocationDatabase);
+    d->load();
+
+    if (radiusKm < 0 || qIsNaN(radiusKm) || !qIsFinite(latitude) || !qIsFinite(longitude))
+        return QList<MCity>();
+    // the squared chord length of the radius, a radius of half the
+    // circumference or more covers the whole globe:
+    const double angle = radiusKm / EarthRadiusKm;
+    double maxDistance = 5;
+    if (angle < M_PI) {
+        const double chord = 2 * sin(angle / 2);
+        maxDistance = chord * chord;
     }
-    return bestCity;
+    QVector<MLocationDatabaseNeighbour> within;
+    double point[3];
+    MLocationDatabasePrivate::unitVector(latitude, longitude, point);
+    d->withinInKdTree(0, d->kdTree.size(), point, maxDistance, &within);
+    qSort(within.begin(), within.end());
+    return d->neighbourCities(within);
 }
 
 }
@@ -23,6 +23,7 @@
 #include "mlocaleexport.h"
 
 #include <QList>
+#include <QFuture>
 
 #include "mcity.h"
 #include "mcountry.h"
@@ -34,9 +35,73 @@ class MLocationDatabasePrivate;
 class MLOCALE_EXPORT MLocationDatabase
 {
   public:
+    /**
+     * \brief creates a location database
+     *
+     * All instances in a process share the same data, which is loaded
+     * on the first query, or by loadInBackground(), and freed with the
+     * last instance. Creating further instances costs nothing extra.
+     *
+     * The data is taken from a binary database if one was generated
+     * from the current xml files: first
+     * /usr/share/meegotouch/locationdatabase/locationdatabase.bin,
+     * then the per user cache
+     * $XDG_CACHE_HOME/mlocale/locationdatabase.bin (~/.cache if
+     * XDG_CACHE_HOME is not set). Otherwise the xml files are parsed
+     * and the per user cache is written for the next time.
+     *
+     * The binary database only replaces the parsing of the xml files.
+     * It is memory mapped while loading, all countries, cities and
+     * time zone aliases are copied into memory and the file is
+     * unmapped again. It holds no lookup tables, the indexes used by
+     * the queries are built in memory on every load.
+     *
+     * \sa writeBinaryDatabase()
+     */
     MLocationDatabase();
     virtual ~MLocationDatabase();
 
+    /**
+     * \brief generates a binary database from the xml files
+     *
+     * Parses the xml files of the location database and writes the
+     * countries, cities and time zone aliases to \a fileName as a
+     * string pool and tables of fixed size records. This is meant to
+     * be called when the xml files are installed, writing
+     * /usr/share/meegotouch/locationdatabase/locationdatabase.bin.
+     * The binary database records the modification times and sizes
+     * of the xml files and is ignored when they change.
+     *
+     * Returns false if the xml files could not be loaded or the file
+     * could not be written.
+     */
+    static bool writeBinaryDatabase( const QString& fileName );
+
+    /**
+     * \brief returns true if the data has been loaded already
+     *
+     * Queries do not block on loading then.
+     */
+    bool isLoaded() const;
+
+    /**
+     * \brief starts loading the data on a thread of the global thread pool
+     *
+     * The returned future finishes when the data is loaded. Watch it
+     * with a QFutureWatcher to get a signal without blocking the main
+     * thread, for example:
+     *
+     * \code
+     * QFutureWatcher<void> *watcher = new QFutureWatcher<void>(this);
+     * connect(watcher, SIGNAL(finished()), this, SLOT(locationDatabaseLoaded()));
+     * watcher->setFuture(db->loadInBackground());
+     * \endcode
+     *
+     * Queries made before that wait until the data is loaded. Deleting
+     * this instance before the future finishes is fine.
+     */
+    QFuture<void> loadInBackground();
+
     /**
      * \brief returns a list with all known countries
      */
@@ -76,14 +141,45 @@ class MLOCALE_EXPORT MLocationDatabase
 
     /**
      * \brief returns a list with all cities that contain the given searchString
+     *
+     * The english and the local names of the cities are searched,
+     * ignoring case and accents, i.e. "sao paulo" matches “São Paulo”.
+     * Search strings of three or more characters are looked up in a
+     * trigram index of the names.
      */
     QList<MCity> matchingCities( const QString& searchString );
 
     /**
      * \brief returns the city with the nearest position to the given location.
+     *
+     * The distance is the great circle distance, so this works across
+     * the 180th meridian and near the poles as well. The cities are
+     * kept in a k-d tree, a query takes O(log n) time on average.
+     * An invalid city is returned if the database is empty or if the
+     * latitude or the longitude is NaN or infinite.
      */
     MCity nearestCity( qreal latitude, qreal longitude );
 
+    /**
+     * \brief returns the \a count cities nearest to the given location
+     *
+     * The cities are sorted by their great circle distance to the
+     * location, the nearest first. Fewer cities are returned if the
+     * database does not have that many, and none if the latitude or
+     * the longitude is NaN or infinite.
+     */
+    QList<MCity> nearestCities( qreal latitude, qreal longitude, int count );
+
+    /**
+     * \brief returns all cities within \a radiusKm kilometers of the given location
+     *
+     * The cities are sorted by their great circle distance to the
+     * location, the nearest first. The earth is taken to be a sphere
+     * with a radius of 6371 km. No cities are returned if the latitude
+     * or the longitude is NaN or infinite, or if the radius is NaN.
+     */
+    QList<MCity> citiesWithin( qreal latitude, qreal longitude, qreal radiusKm );
+
   private:
     MLocationDatabasePrivate *const d_ptr;
     Q_DECLARE_PRIVATE(MLocationDatabase)
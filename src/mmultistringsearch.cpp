@@ -0,0 +1,314 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "mmultistringsearch.h"
+#include "mmultistringsearch_p.h"
+#include "mstringsearch.h"
+#include "mstringsearch_p.h"
+
+#include <unicode/utypes.h>
+
+#include <QtAlgorithms>
+#include <QDebug>
+
+namespace ML10N {
+
+MMultiStringSearchGroup::MMultiStringSearchGroup(const QString &collatorLocaleName,
+                                                 MBreakIterator::Type breakIteratorType)
+    : _collatorLocaleName(collatorLocaleName),
+      _patternTable(new MStringSearchIndexTable(collatorLocaleName, breakIteratorType,
+                                                QStringList()))
+{
+    addNode();
+}
+
+MMultiStringSearchGroup::~MMultiStringSearchGroup()
+{
+    delete _patternTable;
+}
+
+int MMultiStringSearchGroup::addNode()
+{
+    _edges.append(QVector<QPair<quint64, int> >());
+    _failure.append(0);
+    _outputLink.append(-1);
+    _outputs.append(QVector<int>());
+    return _failure.size() - 1;
+}
+
+int MMultiStringSearchGroup::goTo(int node, quint64 ce) const
+{
+    return _transitions.value(qMakePair(node, ce), -1);
+}
+
+void MMultiStringSearchGroup::addPattern(int pattern,
+                                         const QVector<MStringSearchIndexCe> &patternCes)
+{
+    int node = 0;
+    for(int i = 0; i < patternCes.size(); ++i) {
+        const quint64 ce = patternCes.at(i).ce;
+        int next = goTo(node, ce);
+        if(next < 0) {
+            next = addNode();
+            _transitions.insert(qMakePair(node, ce), next);
+            _edges[node].append(qMakePair(ce, next));
+        }
+        node = next;
+    }
+    _outputs[node].append(_patterns.size());
+    _patterns.append(pattern);
+    _patternCes.append(patternCes);
+}
+
+// sets the failure links breadth first, the failure link of a node
+// points to the node of the longest proper suffix of its sequence
+void MMultiStringSearchGroup::build()
+{
+    QVector<int> queue;
+    queue.reserve(_failure.size());
+    queue.append(0);
+    for(int head = 0; head < queue.size(); ++head) {
+        const int node = queue.at(head);
+        const QVector<QPair<quint64, int> > &edges = _edges.at(node);
+        for(int i = 0; i < edges.size(); ++i) {
+            const quint64 ce = edges.at(i).first;
+            const int child = edges.at(i).second;
+            int failure = 0;
+            if(node != 0) {
+                int suffix = _failure.at(node);
+                while(suffix != 0 && goTo(suffix, ce) < 0)
+                    suffix = _failure.at(suffix);
+                failure = qMax(goTo(suffix, ce), 0);
+            }
+            _failure[child] = failure;
+            _outputLink[child] = _outputs.at(failure).isEmpty()
+                ? _outputLink.at(failure) : failure;
+            queue.append(child);
+        }
+    }
+}
+
+MMultiStringSearchPrivate::MMultiStringSearchPrivate()
+    : _breakIteratorType(MBreakIterator::CharacterIterator),
+      _collatorStrength(MLocale::CollatorStrengthPrimary),
+      _alternateHandlingShifted(true),
+      _status(U_ZERO_ERROR),
+      _hasGroups(false),
+      q_ptr(0)
+{
+}
+
+MMultiStringSearchPrivate::~MMultiStringSearchPrivate()
+{
+    clearGroups();
+}
+
+bool MMultiStringSearchPrivate::hasError() const
+{
+    return(!U_SUCCESS(_status));
+}
+
+void MMultiStringSearchPrivate::clearError() const
+{
+    _status = U_ZERO_ERROR;
+}
+
+QString MMultiStringSearchPrivate::errorString() const
+{
+    if (hasError())
+        return QString(u_errorName(_status));
+    else
+        return QString();
+}
+
+void MMultiStringSearchPrivate::clearGroups()
+{
+    qDeleteAll(_groups);
+    _groups.clear();
+    _hasGroups = false;
+}
+
+// Puts every pattern into the group of its search collator locale,
+// Chinese patterns with and without Hani characters are searched with
+// different collators like in MStringSearch.
+void MMultiStringSearchPrivate::buildGroups() const
+{
+    if(_hasGroups)
+        return;
+    QHash<QString, MMultiStringSearchGroup *> groups;
+    for(int i = 0; i < _patterns.size(); ++i) {
+        const QString &pattern = _patterns.at(i);
+        const QString collatorLocaleName =
+            MStringSearchPrivate::searchCollatorLocaleName(pattern, _locale);
+        MMultiStringSearchGroup *group = groups.value(collatorLocaleName);
+        if(!group) {
+            group = new MMultiStringSearchGroup(collatorLocaleName, _breakIteratorType);
+            groups.insert(collatorLocaleName, group);
+            _groups.append(group);
+            if(!group->_patternTable->isValid()) {
+                _status = group->_patternTable->_status;
+                continue;
+            }
+            group->_patternTable->processCes(_collatorStrength, _alternateHandlingShifted);
+        }
+        if(!group->_patternTable->isValid())
+            continue;
+        const QVector<MStringSearchIndexCe> patternCes =
+            group->_patternTable->patternCes(pattern);
+        if(MStringSearchIndexTable::isSearchable(patternCes, _alternateHandlingShifted))
+            group->addPattern(i, patternCes);
+    }
+    foreach(MMultiStringSearchGroup *group, _groups)
+        group->build();
+    _hasGroups = true;
+}
+
+static bool matchLessThan(const MMultiStringSearch::Match &match1,
+                          const MMultiStringSearch::Match &match2)
+{
+    if(match1.start != match2.start)
+        return match1.start < match2.start;
+    return match1.pattern < match2.pattern;
+}
+
+MMultiStringSearch::MMultiStringSearch(const QStringList &patterns, const MLocale &locale,
+                                       MBreakIterator::Type breakIteratorType)
+    : d_ptr(new MMultiStringSearchPrivate)
+{
+    Q_D(MMultiStringSearch);
+    d->q_ptr = this;
+    d->_locale = locale;
+    d->_breakIteratorType = breakIteratorType;
+    d->_patterns = patterns;
+}
+
+MMultiStringSearch::~MMultiStringSearch()
+{
+    delete d_ptr;
+}
+
+QString MMultiStringSearch::errorString() const
+{
+    Q_D(const MMultiStringSearch);
+    return d->errorString();
+}
+
+void MMultiStringSearch::setLocale(const MLocale &locale)
+{
+    Q_D(MMultiStringSearch);
+    d->clearError();
+    d->_locale = locale;
+    d->clearGroups();
+}
+
+void MMultiStringSearch::setPatterns(const QStringList &patterns)
+{
+    Q_D(MMultiStringSearch);
+    d->clearError();
+    d->_patterns = patterns;
+    d->clearGroups();
+}
+
+QStringList MMultiStringSearch::patterns() const
+{
+    Q_D(const MMultiStringSearch);
+    return d->_patterns;
+}
+
+void MMultiStringSearch::setCollatorStrength(MLocale::CollatorStrength collatorStrength)
+{
+    Q_D(MMultiStringSearch);
+    d->_collatorStrength = collatorStrength;
+    d->clearGroups();
+}
+
+MLocale::CollatorStrength MMultiStringSearch::collatorStrength() const
+{
+    Q_D(const MMultiStringSearch);
+    return d->_collatorStrength;
+}
+
+void MMultiStringSearch::setAlternateHandlingShifted(bool isShifted)
+{
+    Q_D(MMultiStringSearch);
+    d->_alternateHandlingShifted = isShifted;
+    d->clearGroups();
+}
+
+bool MMultiStringSearch::alternateHandlingShifted() const
+{
+    Q_D(const MMultiStringSearch);
+    return d->_alternateHandlingShifted;
+}
+
+QList<MMultiStringSearch::Match> MMultiStringSearch::findAll(const QString &text) const
+{
+    Q_D(const MMultiStringSearch);
+    d->clearError();
+    d->buildGroups();
+    QList<Match> matches;
+    // like MStringSearch::next(), the search for a pattern continues
+    // after the end of its previous match:
+    QVector<int> searchStart(d->_patterns.size(), 0);
+    foreach(const MMultiStringSearchGroup *group, d->_groups) {
+        if(group->_patterns.isEmpty())
+            continue;
+        MStringSearchIndexTable table(group->_collatorLocaleName, d->_breakIteratorType,
+                                      QStringList() << text);
+        if(!table.isValid()) {
+            d->_status = table._status;
+            continue;
+        }
+        table.processCes(d->_collatorStrength, d->_alternateHandlingShifted);
+        const int rowEnd = table._rowStart.at(1);
+        int node = 0;
+        for(int i = table._rowStart.at(0); i < rowEnd; ++i) {
+            const quint64 ce = table._ces.at(i).ce;
+            int next;
+            while((next = group->goTo(node, ce)) < 0 && node != 0)
+                node = group->_failure.at(node);
+            node = qMax(next, 0);
+            for(int output = node; output > 0; output = group->_outputLink.at(output)) {
+                const QVector<int> &outputs = group->_outputs.at(output);
+                for(int j = 0; j < outputs.size(); ++j) {
+                    const int pattern = group->_patterns.at(outputs.at(j));
+                    const QVector<MStringSearchIndexCe> &patternCes =
+                        group->_patternCes.at(outputs.at(j));
+                    Match match;
+                    match.pattern = pattern;
+                    if(table.matchAt(0, i - patternCes.size() + 1, patternCes,
+                                     text, d->_patterns.at(pattern),
+                                     &match.start, &match.length)
+                       && match.start >= searchStart.at(pattern)) {
+                        searchStart[pattern] = match.start + match.length;
+                        matches.append(match);
+                    }
+                }
+            }
+        }
+    }
+    qStableSort(matches.begin(), matches.end(), matchLessThan);
+    if(d->hasError())
+        qWarning() << __PRETTY_FUNCTION__
+                   << "searching failed with error"
+                   << d->errorString();
+    return matches;
+}
+
+}
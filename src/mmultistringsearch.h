@@ -0,0 +1,163 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef ML10N_MMULTISTRINGSEARCH_H
+#define ML10N_MMULTISTRINGSEARCH_H
+
+#include "mlocaleexport.h"
+#include "mlocale.h"
+#include "mbreakiterator.h"
+
+#include <QList>
+#include <QStringList>
+
+namespace ML10N {
+
+class MMultiStringSearchPrivate;
+
+/*!
+ * \class MMultiStringSearch
+ *
+ * \brief searches for many patterns at once, for example to highlight
+ * several keywords in a text
+ *
+ * MMultiStringSearch finds the same matches as one MStringSearch per
+ * pattern with the same locale, break iterator type, collator
+ * strength and alternate handling, iterated with
+ * MStringSearch::first() and MStringSearch::next(). But instead of
+ * going through the text once for every pattern, it goes through the
+ * collation elements of the text only once and finds all patterns
+ * in the same pass.
+ *
+ * Example:
+ *
+ * \code
+ * QStringList keywords;
+ * keywords << "muller" << "strasse";
+ * MLocale locale("de_DE");
+ * MMultiStringSearch search(keywords, locale);
+ * QList<MMultiStringSearch::Match> matches
+ *     = search.findAll("Müller, Hauptstraße 1");
+ * // matches contains (0, 0, 6) and (1, 13, 6)
+ * \endcode
+ *
+ * \sa MStringSearch
+ */
+class MLOCALE_EXPORT MMultiStringSearch
+{
+public:
+    /*!
+     * \brief a match of one of the patterns in the text
+     */
+    struct Match
+    {
+        //! the index of the pattern in patterns()
+        int pattern;
+        //! the index in the text where the match starts
+        int start;
+        //! the length of the match in the text
+        int length;
+    };
+
+    /*!
+     * \brief constructs a MMultiStringSearch
+     * \param patterns: the strings to search for
+     * \param locale: the locale which determines the language-specific rules
+     * \param breakIteratorType: the break iterator type to use
+     *
+     * The break iterator type has the same meaning as in the
+     * constructor of MStringSearch.
+     */
+    MMultiStringSearch(const QStringList &patterns, const MLocale &locale,
+                       MBreakIterator::Type breakIteratorType = MBreakIterator::CharacterIterator);
+
+    /*!
+     * \brief destructor for MMultiStringSearch
+     */
+    virtual ~MMultiStringSearch();
+
+    /*!
+     * \brief text describing the error which occurred during the last action
+     */
+    QString errorString() const;
+
+    /*!
+     * \brief sets the locale used for the language-sensitive text searching
+     */
+    void setLocale(const MLocale &locale);
+
+    /*!
+     * \brief sets the strings to search for
+     */
+    void setPatterns(const QStringList &patterns);
+
+    /*!
+     * \brief returns the strings to search for
+     */
+    QStringList patterns() const;
+
+    /*!
+     * \brief set the strength of the collator used for searching
+     *
+     * The default strength is MLocale::CollatorStrengthPrimary, like
+     * in MStringSearch.
+     *
+     * \sa MStringSearch::setCollatorStrength()
+     */
+    void setCollatorStrength(MLocale::CollatorStrength collatorStrength);
+
+    /*!
+     * \brief gets the strength of the collator currently used for searching
+     */
+    MLocale::CollatorStrength collatorStrength() const;
+
+    /*!
+     * \brief sets whether the alternate characters are handled shifted or not
+     *
+     * The default is true, like in MStringSearch.
+     *
+     * \sa MStringSearch::setAlternateHandlingShifted()
+     */
+    void setAlternateHandlingShifted(bool isShifted);
+
+    /*!
+     * \brief gets whether alternate characters are handled shifted or not
+     */
+    bool alternateHandlingShifted() const;
+
+    /*!
+     * \brief returns the matches of all patterns in the text
+     *
+     * The matches are sorted by their start, matches with the same
+     * start by the index of the pattern. For every single pattern the
+     * matches are the same as the ones MStringSearch::first() and
+     * MStringSearch::next() return, i.e. they do not overlap each
+     * other, but matches of different patterns may overlap.
+     */
+    QList<Match> findAll(const QString &text) const;
+
+private:
+    Q_DISABLE_COPY(MMultiStringSearch)
+    MMultiStringSearchPrivate *const d_ptr;
+    Q_DECLARE_PRIVATE(MMultiStringSearch)
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef MMULTISTRINGSEARCH_P_H
+#define MMULTISTRINGSEARCH_P_H
+
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "mstringsearchindex_p.h"
+
+namespace ML10N {
+
+class MMultiStringSearch;
+
+// An Aho-Corasick automaton over the collation elements of the
+// patterns which are searched with the same collator. Node 0 is the
+// root, every other node stands for a sequence of collation elements
+// which is the beginning of at least one pattern.
+class MMultiStringSearchGroup
+{
+public:
+    MMultiStringSearchGroup(const QString &collatorLocaleName,
+                            MBreakIterator::Type breakIteratorType);
+    ~MMultiStringSearchGroup();
+
+    int addNode();
+    int goTo(int node, quint64 ce) const;
+    void addPattern(int pattern, const QVector<MStringSearchIndexCe> &patternCes);
+    void build();
+
+    QString _collatorLocaleName;
+    // only used to get the collation elements of the patterns
+    MStringSearchIndexTable *_patternTable;
+
+    // the patterns of this group as indices into the list of all
+    // patterns, and their collation elements
+    QVector<int> _patterns;
+    QVector<QVector<MStringSearchIndexCe> > _patternCes;
+
+    QHash<QPair<int, quint64>, int> _transitions;
+    QVector<QVector<QPair<quint64, int> > > _edges;
+    QVector<int> _failure;
+    // the next node on the failure chain with outputs, -1 if none
+    QVector<int> _outputLink;
+    // the patterns ending at a node, as indices into _patterns
+    QVector<QVector<int> > _outputs;
+
+private:
+    Q_DISABLE_COPY(MMultiStringSearchGroup)
+};
+
+class MMultiStringSearchPrivate
+{
+    Q_DECLARE_PUBLIC(MMultiStringSearch)
+
+public:
+    MMultiStringSearchPrivate();
+
+    virtual ~MMultiStringSearchPrivate();
+
+    bool hasError() const;
+    void clearError() const;
+    QString errorString() const;
+
+    void clearGroups();
+    void buildGroups() const;
+
+    MLocale _locale;
+    MBreakIterator::Type _breakIteratorType;
+    QStringList _patterns;
+    MLocale::CollatorStrength _collatorStrength;
+    bool _alternateHandlingShifted;
+
+    mutable UErrorCode _status;
+    // one group per search collator locale, built when searching for
+    // the first time after the patterns or options changed:
+    mutable QList<MMultiStringSearchGroup *> _groups;
+    mutable bool _hasGroups;
+
+    MMultiStringSearch *q_ptr;
+
+private:
+    Q_DISABLE_COPY(MMultiStringSearchPrivate)
+};
+
+}
+
+#endif
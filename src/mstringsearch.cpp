@@ -28,6 +28,8 @@
 #include <unicode/uenum.h>
 #include <unicode/ucsdet.h>
 
+#include <QHash>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 #include <QTextCodec>
@@ -74,7 +76,7 @@ QString MStringSearchPrivate::errorString() const
         return QString();
 }
 
-bool MStringSearchPrivate::containsHani(const QString &text) const
+bool MStringSearchPrivate::containsHani(const QString &text)
 {
     for(int i = 0; i < text.size(); ++i) {
         if(text.at(i).isHighSurrogate()) {
@@ -94,7 +96,7 @@ bool MStringSearchPrivate::containsHani(const QString &text) const
     return false;
 }
 
-QString MStringSearchPrivate::searchCollatorLocaleName(const QString &pattern, const MLocale &locale) const
+QString MStringSearchPrivate::searchCollatorLocaleName(const QString &pattern, const MLocale &locale)
 {
     QString categoryCollateName = locale.categoryName(MLocale::MLcCollate);
     if(!categoryCollateName.startsWith("zh")) {
@@ -115,26 +117,30 @@ QString MStringSearchPrivate::searchCollatorLocaleName(const QString &pattern, c
     }
 }
 
-void MStringSearchPrivate::setIcuCollatorOptions()
+void MStringSearchPrivate::setIcuCollatorOptions(icu::Collator *icuCollator,
+                                                 MLocale::CollatorStrength collatorStrength,
+                                                 Qt::CaseSensitivity caseSensitivity,
+                                                 bool alternateHandlingShifted,
+                                                 UErrorCode &status)
 {
-    switch(_collatorStrength) {
+    switch(collatorStrength) {
     case MLocale::CollatorStrengthPrimary:
-        _icuCollator->setStrength(icu::Collator::PRIMARY);
+        icuCollator->setStrength(icu::Collator::PRIMARY);
         break;
     case MLocale::CollatorStrengthSecondary:
-        _icuCollator->setStrength(icu::Collator::SECONDARY);
+        icuCollator->setStrength(icu::Collator::SECONDARY);
         break;
     case MLocale::CollatorStrengthTertiary:
-        _icuCollator->setStrength(icu::Collator::TERTIARY);
+        icuCollator->setStrength(icu::Collator::TERTIARY);
         break;
     case MLocale::CollatorStrengthQuaternary:
-        _icuCollator->setStrength(icu::Collator::QUATERNARY);
+        icuCollator->setStrength(icu::Collator::QUATERNARY);
         break;
     case MLocale::CollatorStrengthIdentical:
-        _icuCollator->setStrength(icu::Collator::IDENTICAL);
+        icuCollator->setStrength(icu::Collator::IDENTICAL);
         break;
     default:
-        _icuCollator->setStrength(icu::Collator::QUATERNARY);
+        icuCollator->setStrength(icu::Collator::QUATERNARY);
         break;
     }
     // unfortunately this attempt to set the case sensitivity does not
@@ -153,61 +159,167 @@ void MStringSearchPrivate::setIcuCollatorOptions()
     // enable case level.
     //
     // But this just doesn’t seem to work.
-    switch(_caseSensitivity) {
+    switch(caseSensitivity) {
     case Qt::CaseSensitive:
-        clearError();
-        _icuCollator->setAttribute(UCOL_CASE_FIRST, UCOL_LOWER_FIRST, _status);
-        if(hasError())
+        status = U_ZERO_ERROR;
+        icuCollator->setAttribute(UCOL_CASE_FIRST, UCOL_LOWER_FIRST, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_CASE_FIRST, UCOL_LOWER_FIRST) failed with error"
-                       << errorString();
-        _icuCollator->setAttribute(UCOL_CASE_LEVEL, UCOL_ON, _status);
-        if(hasError())
+                       << u_errorName(status);
+        icuCollator->setAttribute(UCOL_CASE_LEVEL, UCOL_ON, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_CASE_LEVEL, UCOL_ON) failed with error"
-                       << errorString();
+                       << u_errorName(status);
         break;
     case Qt::CaseInsensitive:
     default:
-        clearError();
-        _icuCollator->setAttribute(UCOL_CASE_FIRST, UCOL_OFF, _status);
-        if(hasError())
+        status = U_ZERO_ERROR;
+        icuCollator->setAttribute(UCOL_CASE_FIRST, UCOL_OFF, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_CASE_FIRST, UCOL_OFF, UCOL_OFF) failed with error"
-                       << errorString();
-        clearError();
-        _icuCollator->setAttribute(UCOL_CASE_LEVEL, UCOL_OFF, _status);
-        if(hasError())
+                       << u_errorName(status);
+        status = U_ZERO_ERROR;
+        icuCollator->setAttribute(UCOL_CASE_LEVEL, UCOL_OFF, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_CASE_LEVEL, UCOL_OFF) failed with error"
-                       << errorString();
+                       << u_errorName(status);
         break;
     }
-    if(_alternateHandlingShifted) {
+    if(alternateHandlingShifted) {
         // ignore space and punctuation characters (simplified, real explanation is longer ...)
-        clearError();
-        _icuCollator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_SHIFTED, _status);
-        if(hasError())
+        status = U_ZERO_ERROR;
+        icuCollator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_SHIFTED, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_SHIFTED) failed with error"
-                       << errorString();
+                       << u_errorName(status);
     }
     else {
         // don’t ignore space and punctuation characters
-        clearError();
-        _icuCollator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_NON_IGNORABLE, _status);
-        if(hasError())
+        status = U_ZERO_ERROR;
+        icuCollator->setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_NON_IGNORABLE, status);
+        if(U_FAILURE(status))
             qWarning() << __PRETTY_FUNCTION__
                        << "icu::Collator::setAttribute(UCOL_ALTERNATE_HANDLING, UCOL_NON_IGNORABLE) failed with error"
-                       << errorString();
+                       << u_errorName(status);
     }
     // force normalization:
-    clearError();
-    _icuCollator->setAttribute(UCOL_NORMALIZATION_MODE, UCOL_ON, _status);
-    if(hasError())
+    status = U_ZERO_ERROR;
+    icuCollator->setAttribute(UCOL_NORMALIZATION_MODE, UCOL_ON, status);
+    if(U_FAILURE(status))
         qWarning() << __PRETTY_FUNCTION__
                    << "icu::Collator::setAttribute(UCOL_NORMALIZATION_MODE, UCOL_ON) failed with error"
-                   << errorString();
+                   << u_errorName(status);
+}
+
+void MStringSearchPrivate::setIcuCollatorOptions()
+{
+    setIcuCollatorOptions(_icuCollator, _collatorStrength, _caseSensitivity,
+                          _alternateHandlingShifted, _status);
+}
+
+icu::BreakIterator *MStringSearchPrivate::createIcuBreakIterator(MBreakIterator::Type breakIteratorType,
+                                                                 const QString &localeName,
+                                                                 UErrorCode &status)
+{
+    icu::Locale locale(qPrintable(localeName));
+    switch(breakIteratorType) {
+    case MBreakIterator::SentenceIterator:
+        return icu::BreakIterator::createSentenceInstance(locale, status);
+    case MBreakIterator::TitleIterator:
+        return icu::BreakIterator::createTitleInstance(locale, status);
+    case MBreakIterator::LineIterator:
+        return icu::BreakIterator::createLineInstance(locale, status);
+    case MBreakIterator::WordIterator:
+        return icu::BreakIterator::createWordInstance(locale, status);
+    case MBreakIterator::CharacterIterator:
+    default:
+        return icu::BreakIterator::createCharacterInstance(locale, status);
+    }
+}
+
+// mutex to guard the caches of configured collators and break iterators
+static QMutex searchCacheMutex;
+static QHash<QString, icu::Collator *> searchCollators;
+static QHash<QString, icu::BreakIterator *> searchBreakIterators;
+
+struct MStaticSearchCacheDestroyer {
+    ~MStaticSearchCacheDestroyer() {
+        qDeleteAll(searchCollators);
+        searchCollators.clear();
+        qDeleteAll(searchBreakIterators);
+        searchBreakIterators.clear();
+    }
+};
+static MStaticSearchCacheDestroyer staticSearchCacheDestroyer;
+
+// returns a new collator for the locale with all the search options
+// already set. Creating and configuring a collator is expensive, the
+// first one for each combination of options is kept for the rest of
+// the process and every later call just clones it. The caller owns
+// the returned collator.
+icu::Collator *MStringSearchPrivate::cachedIcuCollator(const QString &localeName,
+                                                       MLocale::CollatorStrength collatorStrength,
+                                                       Qt::CaseSensitivity caseSensitivity,
+                                                       bool alternateHandlingShifted,
+                                                       UErrorCode &status)
+{
+    QString key = localeName
+        + QLatin1Char('|') + QString::number(collatorStrength)
+        + QLatin1Char('|') + QString::number(caseSensitivity)
+        + QLatin1Char('|') + QString::number(alternateHandlingShifted);
+    QMutexLocker locker(&searchCacheMutex);
+    icu::Collator *icuCollator = searchCollators.value(key);
+    if(!icuCollator) {
+        status = U_ZERO_ERROR;
+        icuCollator = icu::Collator::createInstance(
+            icu::Locale(qPrintable(localeName)), status);
+        if(U_FAILURE(status)) {
+            qWarning() << __PRETTY_FUNCTION__
+                       << "icu::Collator::createInstance() failed with error"
+                       << u_errorName(status);
+            delete icuCollator;
+            return 0;
+        }
+        setIcuCollatorOptions(icuCollator, collatorStrength, caseSensitivity,
+                              alternateHandlingShifted, status);
+        searchCollators.insert(key, icuCollator);
+    }
+    status = U_ZERO_ERROR;
+    icu::Collator *clone = icuCollator->safeClone();
+    if(!clone)
+        status = U_MEMORY_ALLOCATION_ERROR;
+    return clone;
+}
+
+// like cachedIcuCollator(), returns a new break iterator cloned from
+// the one cached for this type and locale. The caller owns it.
+icu::BreakIterator *MStringSearchPrivate::cachedIcuBreakIterator(MBreakIterator::Type breakIteratorType,
+                                                                 const QString &localeName,
+                                                                 UErrorCode &status)
+{
+    QString key = localeName
+        + QLatin1Char('|') + QString::number(breakIteratorType);
+    QMutexLocker locker(&searchCacheMutex);
+    icu::BreakIterator *icuBreakIterator = searchBreakIterators.value(key);
+    if(!icuBreakIterator) {
+        status = U_ZERO_ERROR;
+        icuBreakIterator = createIcuBreakIterator(breakIteratorType, localeName, status);
+        if(U_FAILURE(status)) {
+            delete icuBreakIterator;
+            return 0;
+        }
+        searchBreakIterators.insert(key, icuBreakIterator);
+    }
+    status = U_ZERO_ERROR;
+    icu::BreakIterator *clone = icuBreakIterator->clone();
+    if(!clone)
+        status = U_MEMORY_ALLOCATION_ERROR;
+    return clone;
 }
 
 void MStringSearchPrivate::updateOrInitIcuCollator()
@@ -219,13 +331,15 @@ void MStringSearchPrivate::updateOrInitIcuCollator()
         if(_icuCollator)
             delete _icuCollator;
         clearError();
-        _icuCollator = icu::Collator::createInstance(
-            icu::Locale(qPrintable(_searchCollatorLocaleName)),
-            _status);
+        // the clone from the cache has the options set already:
+        _icuCollator = cachedIcuCollator(_searchCollatorLocaleName, _collatorStrength,
+                                         _caseSensitivity, _alternateHandlingShifted,
+                                         _status);
         if(hasError())
             qWarning() << __PRETTY_FUNCTION__
-                       << "icu::Collator::createInstance() failed with error"
+                       << "creating the collator failed with error"
                        << errorString();
+        return;
     }
     setIcuCollatorOptions();
 }
@@ -251,34 +365,8 @@ MStringSearch::MStringSearch(const QString &pattern, const QString &text, const
     d->_pattern = pattern;
     d->_text = text;
     d->updateOrInitIcuCollator();
-    switch(breakIteratorType) {
-    case MBreakIterator::SentenceIterator:
-        d->_icuBreakIterator = icu::BreakIterator::createSentenceInstance(
-            icu::Locale(qPrintable(d->_searchCollatorLocaleName)),
-            d->_status);
-        break;
-    case MBreakIterator::TitleIterator:
-        d->_icuBreakIterator = icu::BreakIterator::createTitleInstance(
-            icu::Locale(qPrintable(d->_searchCollatorLocaleName)),
-            d->_status);
-        break;
-    case MBreakIterator::LineIterator:
-        d->_icuBreakIterator = icu::BreakIterator::createLineInstance(
-        icu::Locale(qPrintable(d->_searchCollatorLocaleName)),
-        d->_status);
-        break;
-    case MBreakIterator::WordIterator:
-        d->_icuBreakIterator = icu::BreakIterator::createWordInstance(
-            icu::Locale(qPrintable(d->_searchCollatorLocaleName)),
-            d->_status);
-        break;
-    case MBreakIterator::CharacterIterator:
-    default:
-        d->_icuBreakIterator = icu::BreakIterator::createCharacterInstance(
-            icu::Locale(qPrintable(d->_searchCollatorLocaleName)),
-            d->_status);
-        break;
-    }
+    d->_icuBreakIterator = MStringSearchPrivate::cachedIcuBreakIterator(
+        breakIteratorType, d->_searchCollatorLocaleName, d->_status);
     if(d->hasError())
         qWarning() << __PRETTY_FUNCTION__
                    << "breakIteratorType =" << breakIteratorType
@@ -493,4 +581,25 @@ QString MStringSearch::matchedText() const
     return MIcuConversions::unicodeStringToQString(uString);
 }
 
+QVector<QPair<int, int> > MStringSearch::findAll(int maxCount)
+{
+    Q_D(MStringSearch);
+    QVector<QPair<int, int> > matches;
+    d->clearError();
+    if(maxCount == 0)
+        return matches;
+    for(int start = d->_icuStringSearch->first(d->_status);
+        start != USEARCH_DONE && !d->hasError();
+        start = d->_icuStringSearch->next(d->_status)) {
+        matches.append(qMakePair(start, int(d->_icuStringSearch->getMatchedLength())));
+        if(maxCount > 0 && matches.size() >= maxCount)
+            break;
+    }
+    if(d->hasError())
+        qWarning() << __PRETTY_FUNCTION__
+                   << "icu::StringSearch::next() failed with error"
+                   << errorString();
+    return matches;
+}
+
 }
@@ -24,6 +24,9 @@
 #include "mlocale.h"
 #include "mbreakiterator.h"
 
+#include <QPair>
+#include <QVector>
+
 namespace ML10N {
 
 class MStringSearchPrivate;
@@ -380,6 +383,23 @@ public:
      */
     QString matchedText() const;
 
+    /*!
+     * \brief returns all matches of the search pattern in the text
+     * \param maxCount the maximum number of matches to return, -1 returns all
+     *
+     * Returns the start index and the length of every match, in the
+     * same order and with the same results as calling first() and then
+     * next() until it returns “-1”, but without the overhead of a
+     * separate call for every match.
+     *
+     * Afterwards the current search position is at the last match
+     * returned, or at the end of the text if there are no more matches.
+     *
+     * \sa first()
+     * \sa next()
+     */
+    QVector<QPair<int, int> > findAll(int maxCount = -1);
+
 private:
     Q_DISABLE_COPY(MStringSearch)
     MStringSearchPrivate *const d_ptr;
@@ -41,8 +41,24 @@ public:
     void clearError();
     QString errorString() const;
 
-    bool containsHani(const QString &text) const;
-    QString searchCollatorLocaleName(const QString &pattern, const MLocale &locale) const;
+    static bool containsHani(const QString &text);
+    static QString searchCollatorLocaleName(const QString &pattern, const MLocale &locale);
+    static void setIcuCollatorOptions(icu::Collator *icuCollator,
+                                      MLocale::CollatorStrength collatorStrength,
+                                      Qt::CaseSensitivity caseSensitivity,
+                                      bool alternateHandlingShifted,
+                                      UErrorCode &status);
+    static icu::BreakIterator *createIcuBreakIterator(MBreakIterator::Type breakIteratorType,
+                                                      const QString &localeName,
+                                                      UErrorCode &status);
+    static icu::Collator *cachedIcuCollator(const QString &localeName,
+                                            MLocale::CollatorStrength collatorStrength,
+                                            Qt::CaseSensitivity caseSensitivity,
+                                            bool alternateHandlingShifted,
+                                            UErrorCode &status);
+    static icu::BreakIterator *cachedIcuBreakIterator(MBreakIterator::Type breakIteratorType,
+                                                      const QString &localeName,
+                                                      UErrorCode &status);
     void setIcuCollatorOptions();
     void updateOrInitIcuCollator();
     void icuStringSearchSetCollator();
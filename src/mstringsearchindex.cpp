@@ -0,0 +1,728 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "mstringsearchindex.h"
+#include "mstringsearchindex_p.h"
+#include "mstringsearch.h"
+#include "mstringsearch_p.h"
+
+#include <unicode/utypes.h>
+#include <unicode/unistr.h>
+#include <unicode/coleitr.h>
+#include <unicode/tblcoll.h>
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QtAlgorithms>
+#include <QDebug>
+
+namespace ML10N {
+
+static int icuStrength(MLocale::CollatorStrength collatorStrength)
+{
+    switch(collatorStrength) {
+    case MLocale::CollatorStrengthPrimary:
+        return icu::Collator::PRIMARY;
+    case MLocale::CollatorStrengthSecondary:
+        return icu::Collator::SECONDARY;
+    case MLocale::CollatorStrengthTertiary:
+        return icu::Collator::TERTIARY;
+    case MLocale::CollatorStrengthIdentical:
+        return icu::Collator::IDENTICAL;
+    case MLocale::CollatorStrengthQuaternary:
+    default:
+        return icu::Collator::QUATERNARY;
+    }
+}
+
+MStringSearchIndexTable::MStringSearchIndexTable(const QString &collatorLocaleName,
+                                                 MBreakIterator::Type breakIteratorType,
+                                                 const QStringList &texts)
+    : _collatorLocaleName(collatorLocaleName),
+      _icuCollator(0),
+      _variableTop(0),
+      _status(U_ZERO_ERROR),
+      _processedStrength(-1),
+      _processedShifted(false),
+      _hasPrefixIndex(false)
+{
+    // the collation elements themselves do not depend on the strength
+    // and the alternate handling, these are applied later when
+    // processing them:
+    _icuCollator = MStringSearchPrivate::cachedIcuCollator(
+        _collatorLocaleName, MLocale::CollatorStrengthPrimary, Qt::CaseInsensitive, true, _status);
+    if(U_FAILURE(_status)) {
+        qWarning() << __PRETTY_FUNCTION__
+                   << "creating the collator failed with error"
+                   << u_errorName(_status);
+        delete _icuCollator;
+        _icuCollator = 0;
+        return;
+    }
+    _variableTop = _icuCollator->getVariableTop(_status);
+
+    icu::BreakIterator *icuBreakIterator =
+        MStringSearchPrivate::cachedIcuBreakIterator(breakIteratorType, _collatorLocaleName, _status);
+    icu::CollationElementIterator *icuElements =
+        static_cast<icu::RuleBasedCollator *>(_icuCollator)->createCollationElementIterator(icu::UnicodeString());
+    if(U_FAILURE(_status) || !icuBreakIterator || !icuElements) {
+        qWarning() << __PRETTY_FUNCTION__
+                   << "creating the break iterator or collation element iterator failed with error"
+                   << u_errorName(_status);
+        if(U_SUCCESS(_status))
+            _status = U_MEMORY_ALLOCATION_ERROR;
+        delete icuBreakIterator;
+        delete icuElements;
+        return;
+    }
+
+    int totalLength = 0;
+    foreach(const QString &text, texts)
+        totalLength += text.size() + 1;
+    _boundaries.resize(totalLength);
+    _rawRowStart.reserve(texts.size() + 1);
+    _textRowStart.reserve(texts.size() + 1);
+
+    int textRowStart = 0;
+    for(int row = 0; row < texts.size(); ++row) {
+        const QString &text = texts.at(row);
+        _rawRowStart << _rawCes.size();
+        _textRowStart << textRowStart;
+        // read only alias, nothing is copied:
+        const icu::UnicodeString icuText(
+            false, reinterpret_cast<const UChar *>(text.utf16()), text.size());
+        icuElements->setText(icuText, _status);
+        rawCes(icuElements, &_rawCes);
+        icuBreakIterator->setText(icuText);
+        for(int32_t boundary = icuBreakIterator->first();
+            boundary != icu::BreakIterator::DONE;
+            boundary = icuBreakIterator->next())
+            _boundaries.setBit(textRowStart + boundary);
+        textRowStart += text.size() + 1;
+    }
+    _rawRowStart << _rawCes.size();
+    _textRowStart << textRowStart;
+
+    delete icuBreakIterator;
+    delete icuElements;
+    if(U_FAILURE(_status))
+        qWarning() << __PRETTY_FUNCTION__
+                   << "icu::CollationElementIterator::setText() failed with error"
+                   << u_errorName(_status);
+}
+
+MStringSearchIndexTable::~MStringSearchIndexTable()
+{
+    delete _icuCollator;
+}
+
+bool MStringSearchIndexTable::isValid() const
+{
+    return _icuCollator && U_SUCCESS(_status);
+}
+
+void MStringSearchIndexTable::rawCes(icu::CollationElementIterator *iterator,
+                                     QVector<MStringSearchIndexCe> *ces)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    for(;;) {
+        MStringSearchIndexCe element;
+        element.low = iterator->getOffset();
+        int32_t ce = iterator->next(status);
+        if(ce == icu::CollationElementIterator::NULLORDER || U_FAILURE(status))
+            break;
+        element.ce = quint32(ce);
+        element.high = iterator->getOffset();
+        ces->append(element);
+    }
+}
+
+// This processes the collation elements exactly like icu::StringSearch
+// does, i.e. it masks them according to the strength, handles variable
+// collation elements if the alternate handling is shifted and drops
+// collation elements which are ignorable at that strength.
+void MStringSearchIndexTable::processCes(const MStringSearchIndexCe *raw, int count,
+                                         int strength, bool shifted, quint32 variableTop,
+                                         QVector<MStringSearchIndexCe> *processed)
+{
+    bool isShifted = false;
+    for(int i = 0; i < count; ++i) {
+        const quint32 ce = raw[i].ce;
+        quint64 primary = (ce >> 16) & 0xFFFF;
+        quint64 secondary = 0;
+        quint64 tertiary = 0;
+        quint64 quaternary = 0;
+        if(strength >= icu::Collator::SECONDARY)
+            secondary = (ce >> 8) & 0xFF;
+        if(strength >= icu::Collator::TERTIARY)
+            tertiary = ce & 0xFF;
+        if((shifted && variableTop > ce && primary != 0)
+           || (isShifted && primary == 0)) {
+            if(primary == 0)
+                continue;
+            if(strength >= icu::Collator::QUATERNARY)
+                quaternary = primary;
+            primary = secondary = tertiary = 0;
+            isShifted = true;
+        }
+        else {
+            if(strength >= icu::Collator::QUATERNARY)
+                quaternary = 0xFFFF;
+            isShifted = false;
+        }
+        MStringSearchIndexCe element;
+        element.ce = primary << 48 | secondary << 32 | tertiary << 16 | quaternary;
+        if(element.ce == 0)
+            continue;
+        element.low = raw[i].low;
+        element.high = raw[i].high;
+        processed->append(element);
+    }
+}
+
+void MStringSearchIndexTable::processCes(MLocale::CollatorStrength collatorStrength,
+                                         bool alternateHandlingShifted)
+{
+    const int strength = icuStrength(collatorStrength);
+    if(strength == _processedStrength && alternateHandlingShifted == _processedShifted)
+        return;
+    _processedStrength = strength;
+    _processedShifted = alternateHandlingShifted;
+    _prefixIndex.clear();
+    _hasPrefixIndex = false;
+    _ces.clear();
+    _ces.reserve(_rawCes.size());
+    _rowStart.clear();
+    _rowStart.reserve(_rawRowStart.size());
+    for(int row = 0; row + 1 < _rawRowStart.size(); ++row) {
+        _rowStart << _ces.size();
+        processCes(_rawCes.constData() + _rawRowStart.at(row),
+                   _rawRowStart.at(row + 1) - _rawRowStart.at(row),
+                   _processedStrength, _processedShifted, _variableTop, &_ces);
+    }
+    _rowStart << _ces.size();
+}
+
+QVector<MStringSearchIndexCe> MStringSearchIndexTable::patternCes(const QString &pattern) const
+{
+    QVector<MStringSearchIndexCe> raw;
+    QVector<MStringSearchIndexCe> processed;
+    const icu::UnicodeString icuPattern(
+        false, reinterpret_cast<const UChar *>(pattern.utf16()), pattern.size());
+    icu::CollationElementIterator *icuElements =
+        static_cast<icu::RuleBasedCollator *>(_icuCollator)->createCollationElementIterator(icuPattern);
+    if(!icuElements)
+        return processed;
+    rawCes(icuElements, &raw);
+    delete icuElements;
+    processCes(raw.constData(), raw.size(),
+               _processedStrength, _processedShifted, _variableTop, &processed);
+    return processed;
+}
+
+bool MStringSearchIndexTable::isSearchable(const QVector<MStringSearchIndexCe> &patternCes,
+                                           bool shifted)
+{
+    if(patternCes.isEmpty())
+        return false;
+    if(!shifted)
+        return true;
+    // With shifted alternate handling, icu::StringSearch never matches
+    // patterns which consist only of collation elements without a
+    // primary weight, like a lone combining accent:
+    for(int i = 0; i < patternCes.size(); ++i) {
+        const quint64 ce = patternCes.at(i).ce;
+        if((ce >> 48) != 0 || ((ce >> 16) & Q_UINT64_C(0xFFFFFFFF)) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Checks the conditions for the start of a match which do not depend
+// on the pattern
+bool MStringSearchIndexTable::isMatchStart(int row, int ceIndex) const
+{
+    const MStringSearchIndexCe &first = _ces.at(ceIndex);
+    return isBoundary(row, first.low) && first.low != first.high;
+}
+
+bool MStringSearchIndexTable::matchesPrefix(int row, int ceIndex,
+                                            const QVector<MStringSearchIndexCe> &patternCes) const
+{
+    const int patternSize = patternCes.size();
+    if(ceIndex + patternSize > _rowStart.at(row + 1))
+        return false;
+    for(int i = 0; i < patternSize; ++i) {
+        if(_ces.at(ceIndex + i).ce != patternCes.at(i).ce)
+            return false;
+    }
+    return true;
+}
+
+bool MStringSearchIndexTable::isBoundary(int row, int index) const
+{
+    return _boundaries.testBit(_textRowStart.at(row) + index);
+}
+
+int MStringSearchIndexTable::followingBoundary(int row, int index) const
+{
+    const int length = _textRowStart.at(row + 1) - _textRowStart.at(row) - 1;
+    for(int i = index + 1; i < length; ++i) {
+        if(isBoundary(row, i))
+            return i;
+    }
+    return length;
+}
+
+// finds where words start, i.e. the word boundaries followed by a
+// letter or a number, not by spaces or punctuation
+void MStringSearchIndexTable::buildWordStarts(const QStringList &texts)
+{
+    if(!_wordRowStart.isEmpty())
+        return;
+    _wordRowStart.reserve(texts.size() + 1);
+    UErrorCode status = U_ZERO_ERROR;
+    icu::BreakIterator *icuBreakIterator = MStringSearchPrivate::cachedIcuBreakIterator(
+        MBreakIterator::WordIterator, _collatorLocaleName, status);
+    if(!icuBreakIterator)
+        qWarning() << __PRETTY_FUNCTION__
+                   << "creating the word break iterator failed with error"
+                   << u_errorName(status);
+    for(int row = 0; row < texts.size(); ++row) {
+        _wordRowStart << _wordStarts.size();
+        if(!icuBreakIterator)
+            continue;
+        const QString &text = texts.at(row);
+        const icu::UnicodeString icuText(
+            false, reinterpret_cast<const UChar *>(text.utf16()), text.size());
+        icuBreakIterator->setText(icuText);
+        for(int32_t boundary = icuBreakIterator->first();
+            boundary != icu::BreakIterator::DONE && boundary < text.size();
+            boundary = icuBreakIterator->next()) {
+            const QChar c = text.at(boundary);
+            if(c.isLetterOrNumber() || c.isHighSurrogate())
+                _wordStarts << boundary;
+        }
+    }
+    _wordRowStart << _wordStarts.size();
+    delete icuBreakIterator;
+}
+
+class MStringSearchIndexWordStartLessThan
+{
+public:
+    explicit MStringSearchIndexWordStartLessThan(const MStringSearchIndexTable *table)
+        : _table(table)
+    {
+    }
+    bool operator()(const MStringSearchIndexWordStart &wordStart1,
+                    const MStringSearchIndexWordStart &wordStart2) const
+    {
+        return _table->comparePrimaries(wordStart1, wordStart2) < 0;
+    }
+private:
+    const MStringSearchIndexTable *_table;
+};
+
+void MStringSearchIndexTable::buildPrefixIndex()
+{
+    if(_hasPrefixIndex)
+        return;
+    _prefixIndex.clear();
+    _prefixIndex.reserve(_wordStarts.size());
+    for(int row = 0; row + 1 < _rowStart.size(); ++row) {
+        int ceIndex = _rowStart.at(row);
+        const int rowEnd = _rowStart.at(row + 1);
+        const int wordEnd = _wordRowStart.at(row + 1);
+        for(int word = _wordRowStart.at(row); word < wordEnd; ++word) {
+            // the first collation element of the word, words which
+            // consist only of ignorable characters have none:
+            const int wordStart = _wordStarts.at(word);
+            while(ceIndex < rowEnd && _ces.at(ceIndex).low < wordStart)
+                ++ceIndex;
+            if(ceIndex == rowEnd)
+                break;
+            if(word + 1 < wordEnd && _ces.at(ceIndex).low >= _wordStarts.at(word + 1))
+                continue;
+            MStringSearchIndexWordStart entry;
+            entry.row = row;
+            entry.ceIndex = ceIndex;
+            _prefixIndex.append(entry);
+        }
+    }
+    qSort(_prefixIndex.begin(), _prefixIndex.end(), MStringSearchIndexWordStartLessThan(this));
+    _hasPrefixIndex = true;
+}
+
+// compares the primary weights from two word starts to the ends of
+// their rows, ignoring collation elements without a primary weight
+int MStringSearchIndexTable::comparePrimaries(const MStringSearchIndexWordStart &wordStart1,
+                                              const MStringSearchIndexWordStart &wordStart2) const
+{
+    int i1 = wordStart1.ceIndex;
+    int i2 = wordStart2.ceIndex;
+    const int end1 = _rowStart.at(wordStart1.row + 1);
+    const int end2 = _rowStart.at(wordStart2.row + 1);
+    for(;;) {
+        while(i1 < end1 && (_ces.at(i1).ce >> 48) == 0)
+            ++i1;
+        while(i2 < end2 && (_ces.at(i2).ce >> 48) == 0)
+            ++i2;
+        if(i1 == end1 || i2 == end2)
+            return (i1 == end1 ? 0 : 1) - (i2 == end2 ? 0 : 1);
+        const quint64 primary1 = _ces.at(i1).ce >> 48;
+        const quint64 primary2 = _ces.at(i2).ce >> 48;
+        if(primary1 != primary2)
+            return primary1 < primary2 ? -1 : 1;
+        ++i1;
+        ++i2;
+    }
+}
+
+// returns 0 if the primary weights from the word start begin with
+// the given primary weights, otherwise the same as comparePrimaries()
+int MStringSearchIndexTable::comparePrimaryPrefix(const MStringSearchIndexWordStart &wordStart,
+                                                  const QVector<quint16> &primaries) const
+{
+    int i = wordStart.ceIndex;
+    const int end = _rowStart.at(wordStart.row + 1);
+    for(int j = 0; j < primaries.size(); ++j) {
+        while(i < end && (_ces.at(i).ce >> 48) == 0)
+            ++i;
+        if(i == end)
+            return -1;
+        const quint16 primary = _ces.at(i).ce >> 48;
+        if(primary != primaries.at(j))
+            return primary < primaries.at(j) ? -1 : 1;
+        ++i;
+    }
+    return 0;
+}
+
+// Finds the rows where the pattern matches at the start of a word. The
+// word starts with the same primary weights as the pattern are found
+// with a binary search in the prefix index, only these are checked
+// with matchAt().
+QList<int> MStringSearchIndexTable::prefixMatchingRows(const QVector<MStringSearchIndexCe> &patternCes,
+                                                       const QStringList &texts,
+                                                       const QString &pattern)
+{
+    buildWordStarts(texts);
+    buildPrefixIndex();
+    QVector<quint16> primaries;
+    primaries.reserve(patternCes.size());
+    for(int i = 0; i < patternCes.size(); ++i) {
+        const quint16 primary = patternCes.at(i).ce >> 48;
+        if(primary != 0)
+            primaries << primary;
+    }
+    int low = 0;
+    int high = _prefixIndex.size();
+    while(low < high) {
+        const int middle = low + (high - low) / 2;
+        if(comparePrimaryPrefix(_prefixIndex.at(middle), primaries) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    QList<int> rows;
+    for(int i = low; i < _prefixIndex.size()
+            && comparePrimaryPrefix(_prefixIndex.at(i), primaries) == 0; ++i) {
+        const MStringSearchIndexWordStart &wordStart = _prefixIndex.at(i);
+        if(matchAt(wordStart.row, wordStart.ceIndex, patternCes,
+                   texts.at(wordStart.row), pattern, 0, 0))
+            rows << wordStart.row;
+    }
+    // a row is found once for every word matching:
+    qSort(rows);
+    QList<int> uniqueRows;
+    for(int i = 0; i < rows.size(); ++i) {
+        if(i == 0 || rows.at(i) != rows.at(i - 1))
+            uniqueRows << rows.at(i);
+    }
+    return uniqueRows;
+}
+
+// Checks whether the pattern matches at the collation element with
+// index ceIndex, using the same rules as icu::StringSearch for
+// the boundaries of the match.
+bool MStringSearchIndexTable::matchAt(int row, int ceIndex,
+                                      const QVector<MStringSearchIndexCe> &patternCes,
+                                      const QString &text, const QString &pattern,
+                                      int *matchedStart, int *matchedLength) const
+{
+    const int rowEnd = _rowStart.at(row + 1);
+    const int patternSize = patternCes.size();
+    if(ceIndex + patternSize > rowEnd)
+        return false;
+    for(int i = 0; i < patternSize; ++i) {
+        if(_ces.at(ceIndex + i).ce != patternCes.at(i).ce)
+            return false;
+    }
+    const MStringSearchIndexCe &first = _ces.at(ceIndex);
+    const MStringSearchIndexCe &last = _ces.at(ceIndex + patternSize - 1);
+    const int start = first.low;
+    int maxLimit = text.size();
+    if(ceIndex + patternSize < rowEnd) {
+        // the collation element after the match must not belong to
+        // the same character as the last one of the match:
+        const MStringSearchIndexCe &next = _ces.at(ceIndex + patternSize);
+        if(next.low == next.high)
+            return false;
+        maxLimit = next.low;
+    }
+    // the match must not start in the middle of a character or of an
+    // expansion:
+    if(!isBoundary(row, start) || start == first.high)
+        return false;
+    // extend the end of the match over combining characters:
+    const int minLimit = last.low;
+    int limit = maxLimit;
+    if(minLimit < maxLimit) {
+        if(minLimit == last.high && isBoundary(row, minLimit)) {
+            limit = minLimit;
+        }
+        else {
+            const int following = followingBoundary(row, minLimit);
+            if(following >= last.high)
+                limit = following;
+        }
+    }
+    if(limit > maxLimit || !isBoundary(row, limit))
+        return false;
+    if(_processedStrength == icu::Collator::IDENTICAL
+       && text.mid(start, limit - start).normalized(QString::NormalizationForm_D)
+       != pattern.normalized(QString::NormalizationForm_D))
+        return false;
+    if(matchedStart)
+        *matchedStart = start;
+    if(matchedLength)
+        *matchedLength = limit - start;
+    return true;
+}
+
+int MStringSearchIndexTable::indexIn(int row, const QVector<MStringSearchIndexCe> &patternCes,
+                                     const QString &text, const QString &pattern,
+                                     int *matchedLength) const
+{
+    const quint64 firstCe = patternCes.first().ce;
+    const int end = _rowStart.at(row + 1) - patternCes.size();
+    for(int i = _rowStart.at(row); i <= end; ++i) {
+        int start;
+        if(_ces.at(i).ce == firstCe
+           && matchAt(row, i, patternCes, text, pattern, &start, matchedLength))
+            return start;
+    }
+    return -1;
+}
+
+MStringSearchIndexPrivate::MStringSearchIndexPrivate()
+    : _breakIteratorType(MBreakIterator::CharacterIterator),
+      _collatorStrength(MLocale::CollatorStrengthPrimary),
+      _alternateHandlingShifted(true),
+      _revision(0),
+      _status(U_ZERO_ERROR),
+      q_ptr(0)
+{
+}
+
+MStringSearchIndexPrivate::~MStringSearchIndexPrivate()
+{
+    clearTables();
+}
+
+bool MStringSearchIndexPrivate::hasError() const
+{
+    return(!U_SUCCESS(_status));
+}
+
+void MStringSearchIndexPrivate::clearError() const
+{
+    _status = U_ZERO_ERROR;
+}
+
+QString MStringSearchIndexPrivate::errorString() const
+{
+    if (hasError())
+        return QString(u_errorName(_status));
+    else
+        return QString();
+}
+
+void MStringSearchIndexPrivate::clearTables()
+{
+    qDeleteAll(_tables);
+    _tables.clear();
+}
+
+MStringSearchIndexTable *MStringSearchIndexPrivate::table(const QString &pattern) const
+{
+    const QString collatorLocaleName =
+        MStringSearchPrivate::searchCollatorLocaleName(pattern, _locale);
+    MStringSearchIndexTable *table = _tables.value(collatorLocaleName);
+    if(!table) {
+        table = new MStringSearchIndexTable(collatorLocaleName, _breakIteratorType, _texts);
+        _tables.insert(collatorLocaleName, table);
+    }
+    if(!table->isValid()) {
+        _status = table->_status;
+        return table;
+    }
+    table->processCes(_collatorStrength, _alternateHandlingShifted);
+    return table;
+}
+
+MStringSearchIndex::MStringSearchIndex(const QStringList &texts, const MLocale &locale,
+                                       MBreakIterator::Type breakIteratorType)
+    : d_ptr(new MStringSearchIndexPrivate)
+{
+    Q_D(MStringSearchIndex);
+    d->q_ptr = this;
+    d->_locale = locale;
+    d->_breakIteratorType = breakIteratorType;
+    d->_texts = texts;
+    d->table(QString());
+}
+
+MStringSearchIndex::~MStringSearchIndex()
+{
+    delete d_ptr;
+}
+
+QString MStringSearchIndex::errorString() const
+{
+    Q_D(const MStringSearchIndex);
+    return d->errorString();
+}
+
+void MStringSearchIndex::setLocale(const MLocale &locale)
+{
+    Q_D(MStringSearchIndex);
+    d->clearError();
+    d->_locale = locale;
+    ++d->_revision;
+    d->clearTables();
+    d->table(QString());
+}
+
+void MStringSearchIndex::setTexts(const QStringList &texts)
+{
+    Q_D(MStringSearchIndex);
+    d->clearError();
+    d->_texts = texts;
+    ++d->_revision;
+    d->clearTables();
+    d->table(QString());
+}
+
+void MStringSearchIndex::setTexts(int rowCount, TextProvider textProvider, void *userData)
+{
+    QStringList texts;
+    texts.reserve(rowCount);
+    for(int row = 0; row < rowCount; ++row)
+        texts << textProvider(row, userData);
+    setTexts(texts);
+}
+
+int MStringSearchIndex::rowCount() const
+{
+    Q_D(const MStringSearchIndex);
+    return d->_texts.size();
+}
+
+QString MStringSearchIndex::text(int row) const
+{
+    Q_D(const MStringSearchIndex);
+    return d->_texts.value(row);
+}
+
+void MStringSearchIndex::setCollatorStrength(MLocale::CollatorStrength collatorStrength)
+{
+    Q_D(MStringSearchIndex);
+    d->_collatorStrength = collatorStrength;
+    ++d->_revision;
+}
+
+MLocale::CollatorStrength MStringSearchIndex::collatorStrength() const
+{
+    Q_D(const MStringSearchIndex);
+    return d->_collatorStrength;
+}
+
+void MStringSearchIndex::setAlternateHandlingShifted(bool isShifted)
+{
+    Q_D(MStringSearchIndex);
+    d->_alternateHandlingShifted = isShifted;
+    ++d->_revision;
+}
+
+bool MStringSearchIndex::alternateHandlingShifted() const
+{
+    Q_D(const MStringSearchIndex);
+    return d->_alternateHandlingShifted;
+}
+
+QList<int> MStringSearchIndex::matchingRows(const QString &pattern) const
+{
+    Q_D(const MStringSearchIndex);
+    d->clearError();
+    QList<int> rows;
+    MStringSearchIndexTable *table = d->table(pattern);
+    if(!table->isValid())
+        return rows;
+    const QVector<MStringSearchIndexCe> patternCes = table->patternCes(pattern);
+    if(!MStringSearchIndexTable::isSearchable(patternCes, d->_alternateHandlingShifted))
+        return rows;
+    for(int row = 0; row < d->_texts.size(); ++row) {
+        if(table->indexIn(row, patternCes, d->_texts.at(row), pattern, 0) >= 0)
+            rows << row;
+    }
+    return rows;
+}
+
+int MStringSearchIndex::indexIn(int row, const QString &pattern, int *matchedLength) const
+{
+    Q_D(const MStringSearchIndex);
+    d->clearError();
+    if(row < 0 || row >= d->_texts.size())
+        return -1;
+    MStringSearchIndexTable *table = d->table(pattern);
+    if(!table->isValid())
+        return -1;
+    const QVector<MStringSearchIndexCe> patternCes = table->patternCes(pattern);
+    if(!MStringSearchIndexTable::isSearchable(patternCes, d->_alternateHandlingShifted))
+        return -1;
+    return table->indexIn(row, patternCes, d->_texts.at(row), pattern, matchedLength);
+}
+
+QList<int> MStringSearchIndex::prefixMatchingRows(const QString &prefix) const
+{
+    Q_D(const MStringSearchIndex);
+    d->clearError();
+    MStringSearchIndexTable *table = d->table(prefix);
+    if(!table->isValid())
+        return QList<int>();
+    const QVector<MStringSearchIndexCe> patternCes = table->patternCes(prefix);
+    if(!MStringSearchIndexTable::isSearchable(patternCes, d->_alternateHandlingShifted))
+        return QList<int>();
+    return table->prefixMatchingRows(patternCes, d->_texts, prefix);
+}
+
+}
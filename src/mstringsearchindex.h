@@ -0,0 +1,198 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef ML10N_MSTRINGSEARCHINDEX_H
+#define ML10N_MSTRINGSEARCHINDEX_H
+
+#include "mlocaleexport.h"
+#include "mlocale.h"
+#include "mbreakiterator.h"
+
+#include <QStringList>
+
+namespace ML10N {
+
+class MStringSearchIndexPrivate;
+class MStringSearchSessionPrivate;
+
+/*!
+ * \class MStringSearchIndex
+ *
+ * \brief searches a pattern in many texts at once, for example to
+ * filter a list while the user is typing
+ *
+ * MStringSearchIndex matches exactly like MStringSearch with the same
+ * locale, break iterator type, collator strength and alternate
+ * handling. But instead of searching in one text at a time, it takes
+ * all texts once, prepares the collation elements and break
+ * boundaries of every text in advance and then answers which texts
+ * contain a pattern with a single call.
+ *
+ * Example:
+ *
+ * \code
+ * QStringList names;
+ * names << "Åse" << "Aalto" << "Bengt";
+ * MLocale locale("da_DK");
+ * MStringSearchIndex index(names, locale);
+ * QList<int> rows = index.matchingRows("aa"); // now contains 0 and 1
+ * \endcode
+ *
+ * Changing the locale or the texts prepares everything again, changing
+ * the collator strength or the alternate handling is cheap.
+ *
+ * \sa MStringSearch
+ */
+class MLOCALE_EXPORT MStringSearchIndex
+{
+public:
+    /*!
+     * \brief function which returns the text of a row
+     *
+     * \sa setTexts(int rowCount, TextProvider textProvider, void *userData)
+     */
+    typedef QString (*TextProvider)(int row, void *userData);
+
+    /*!
+     * \brief constructs a MStringSearchIndex
+     * \param texts: the texts in which patterns are searched
+     * \param locale: the locale which determines the language-specific rules
+     * \param breakIteratorType: the break iterator type to use
+     *
+     * The break iterator type has the same meaning as in the
+     * constructor of MStringSearch.
+     */
+    MStringSearchIndex(const QStringList &texts, const MLocale &locale,
+                       MBreakIterator::Type breakIteratorType = MBreakIterator::CharacterIterator);
+
+    /*!
+     * \brief destructor for MStringSearchIndex
+     */
+    virtual ~MStringSearchIndex();
+
+    /*!
+     * \brief text describing the error which occurred during the last action
+     */
+    QString errorString() const;
+
+    /*!
+     * \brief sets the locale used for the language-sensitive text searching
+     */
+    void setLocale(const MLocale &locale);
+
+    /*!
+     * \brief sets the texts in which patterns are searched
+     */
+    void setTexts(const QStringList &texts);
+
+    /*!
+     * \brief sets the texts in which patterns are searched
+     *
+     * \a textProvider is called once for every row from 0 to \a
+     * rowCount - 1 with \a userData to get the text of that row.
+     */
+    void setTexts(int rowCount, TextProvider textProvider, void *userData);
+
+    /*!
+     * \brief returns the number of texts
+     */
+    int rowCount() const;
+
+    /*!
+     * \brief returns the text of a row
+     */
+    QString text(int row) const;
+
+    /*!
+     * \brief set the strength of the collator used for searching
+     *
+     * The default strength is MLocale::CollatorStrengthPrimary, like
+     * in MStringSearch.
+     *
+     * \sa MStringSearch::setCollatorStrength()
+     */
+    void setCollatorStrength(MLocale::CollatorStrength collatorStrength);
+
+    /*!
+     * \brief gets the strength of the collator currently used for searching
+     */
+    MLocale::CollatorStrength collatorStrength() const;
+
+    /*!
+     * \brief sets whether the alternate characters are handled shifted or not
+     *
+     * The default is true, like in MStringSearch.
+     *
+     * \sa MStringSearch::setAlternateHandlingShifted()
+     */
+    void setAlternateHandlingShifted(bool isShifted);
+
+    /*!
+     * \brief gets whether alternate characters are handled shifted or not
+     */
+    bool alternateHandlingShifted() const;
+
+    /*!
+     * \brief returns the rows in which the pattern matches, in ascending order
+     */
+    QList<int> matchingRows(const QString &pattern) const;
+
+    /*!
+     * \brief returns the rows in which a word starts with the prefix, in ascending order
+     *
+     * A row is returned if the prefix matches in it like in
+     * matchingRows() and the match starts at the beginning of a
+     * word. This does not search every row, the beginnings of all
+     * words are sorted by their primary collation weights when this
+     * is called for the first time and the prefix is then found with a
+     * binary search.
+     *
+     * For Chinese, the words are searched with the same collation as
+     * in MStringSearch, i.e. “pinyinsearch” if the prefix contains no
+     * Hani characters.
+     *
+     * Use MBreakIterator::CharacterIterator as break iterator type
+     * to match the beginnings of words, with
+     * MBreakIterator::WordIterator the prefix has to match whole
+     * words.
+     */
+    QList<int> prefixMatchingRows(const QString &prefix) const;
+
+    /*!
+     * \brief returns the first index at which the pattern matches in a row
+     * \param row: the row to search in
+     * \param pattern: the string to search for
+     * \param matchedLength: if not 0, receives the length of the match
+     *
+     * Returns “-1” if there is no match. This gives the same result
+     * as MStringSearch::first() and MStringSearch::matchedLength()
+     * for the text of that row.
+     */
+    int indexIn(int row, const QString &pattern, int *matchedLength = 0) const;
+
+private:
+    friend class MStringSearchSessionPrivate;
+    Q_DISABLE_COPY(MStringSearchIndex)
+    MStringSearchIndexPrivate *const d_ptr;
+    Q_DECLARE_PRIVATE(MStringSearchIndex)
+};
+
+}
+
+#endif
@@ -0,0 +1,172 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef MSTRINGSEARCHINDEX_P_H
+#define MSTRINGSEARCHINDEX_P_H
+
+#include <unicode/utypes.h>
+#include <unicode/coll.h>
+#include <unicode/coleitr.h>
+#include <unicode/brkiter.h>
+
+#include <QBitArray>
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+#include "mlocale.h"
+#include "mbreakiterator.h"
+
+namespace ML10N {
+
+class MStringSearchIndex;
+
+// A collation element of a text with the range of the text it comes from
+struct MStringSearchIndexCe
+{
+    quint64 ce;
+    int low;
+    int high;
+};
+
+// The start of a word in the prefix index: the first processed
+// collation element of the word in a row
+struct MStringSearchIndexWordStart
+{
+    int row;
+    int ceIndex;
+};
+
+// Collation elements and break boundaries of all rows for one search
+// collator locale. The raw collation elements do not depend on the
+// collator strength and the alternate handling, the processed ones are
+// recreated from them when these options change.
+class MStringSearchIndexTable
+{
+public:
+    MStringSearchIndexTable(const QString &collatorLocaleName,
+                            MBreakIterator::Type breakIteratorType,
+                            const QStringList &texts);
+    ~MStringSearchIndexTable();
+
+    bool isValid() const;
+    void processCes(MLocale::CollatorStrength collatorStrength, bool alternateHandlingShifted);
+    QVector<MStringSearchIndexCe> patternCes(const QString &pattern) const;
+    bool matchAt(int row, int ceIndex, const QVector<MStringSearchIndexCe> &patternCes,
+                 const QString &text, const QString &pattern,
+                 int *matchedStart, int *matchedLength) const;
+    int indexIn(int row, const QVector<MStringSearchIndexCe> &patternCes,
+                const QString &text, const QString &pattern, int *matchedLength) const;
+
+    static void rawCes(icu::CollationElementIterator *iterator,
+                       QVector<MStringSearchIndexCe> *ces);
+    static void processCes(const MStringSearchIndexCe *raw, int count,
+                           int strength, bool shifted, quint32 variableTop,
+                           QVector<MStringSearchIndexCe> *processed);
+    static bool isSearchable(const QVector<MStringSearchIndexCe> &patternCes, bool shifted);
+
+    bool isMatchStart(int row, int ceIndex) const;
+    bool matchesPrefix(int row, int ceIndex, const QVector<MStringSearchIndexCe> &patternCes) const;
+    bool isBoundary(int row, int index) const;
+    int followingBoundary(int row, int index) const;
+
+    void buildWordStarts(const QStringList &texts);
+    void buildPrefixIndex();
+    int comparePrimaries(const MStringSearchIndexWordStart &wordStart1,
+                         const MStringSearchIndexWordStart &wordStart2) const;
+    int comparePrimaryPrefix(const MStringSearchIndexWordStart &wordStart,
+                             const QVector<quint16> &primaries) const;
+    QList<int> prefixMatchingRows(const QVector<MStringSearchIndexCe> &patternCes,
+                                  const QStringList &texts, const QString &pattern);
+
+    QString _collatorLocaleName;
+    icu::Collator *_icuCollator;
+    quint32 _variableTop;
+    UErrorCode _status;
+
+    // raw collation elements of all rows, the ones of row i are
+    // _rawCes[_rawRowStart[i]] ... _rawCes[_rawRowStart[i + 1] - 1]
+    QVector<MStringSearchIndexCe> _rawCes;
+    QVector<int> _rawRowStart;
+    // the same for the processed collation elements
+    QVector<MStringSearchIndexCe> _ces;
+    QVector<int> _rowStart;
+    // break boundaries, _boundaries[_textRowStart[i] + j] is set if
+    // there is a boundary before the character j of row i
+    QBitArray _boundaries;
+    QVector<int> _textRowStart;
+
+    int _processedStrength;
+    bool _processedShifted;
+
+    // text positions where words start, the ones of row i are
+    // _wordStarts[_wordRowStart[i]] ... _wordStarts[_wordRowStart[i + 1] - 1].
+    // They are only found when the first prefix search is done.
+    QVector<int> _wordStarts;
+    QVector<int> _wordRowStart;
+    // the word starts sorted by the primary weights of the collation
+    // elements from the word start to the end of the row, rebuilt
+    // when the collation elements are processed again
+    QVector<MStringSearchIndexWordStart> _prefixIndex;
+    bool _hasPrefixIndex;
+
+private:
+    Q_DISABLE_COPY(MStringSearchIndexTable)
+};
+
+class MStringSearchIndexPrivate
+{
+    Q_DECLARE_PUBLIC(MStringSearchIndex)
+
+public:
+    MStringSearchIndexPrivate();
+
+    virtual ~MStringSearchIndexPrivate();
+
+    bool hasError() const;
+    void clearError() const;
+    QString errorString() const;
+
+    void clearTables();
+    MStringSearchIndexTable *table(const QString &pattern) const;
+
+    MLocale _locale;
+    MBreakIterator::Type _breakIteratorType;
+    QStringList _texts;
+    MLocale::CollatorStrength _collatorStrength;
+    bool _alternateHandlingShifted;
+    // incremented whenever the texts or any option change, to
+    // invalidate the state of search sessions
+    int _revision;
+
+    mutable UErrorCode _status;
+    // one table per search collator locale, usually there is only
+    // one, but Chinese patterns with and without Hani characters are
+    // searched with different collators:
+    mutable QHash<QString, MStringSearchIndexTable *> _tables;
+
+    MStringSearchIndex *q_ptr;
+
+private:
+    Q_DISABLE_COPY(MStringSearchIndexPrivate)
+};
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#include "mstringsearchsession.h"
+#include "mstringsearchsession_p.h"
+#include "mstringsearchindex.h"
+#include "mstringsearchindex_p.h"
+
+#include <QtAlgorithms>
+
+namespace ML10N {
+
+MStringSearchSessionPrivate::MStringSearchSessionPrivate()
+    : _index(0),
+      _revision(-1),
+      q_ptr(0)
+{
+}
+
+const MStringSearchSessionState *MStringSearchSessionPrivate::current() const
+{
+    if(_states.isEmpty() || _states.last().pattern != _pattern
+       || _revision != _index->d_func()->_revision)
+        return 0;
+    return &_states.last();
+}
+
+void MStringSearchSessionPrivate::search(const QString &pattern)
+{
+    const MStringSearchIndexPrivate *index = _index->d_func();
+    if(_revision != index->_revision) {
+        _states.clear();
+        _revision = index->_revision;
+    }
+    _pattern = pattern;
+
+    // keep only the results for prefixes of the new pattern, this
+    // restores the previous results on backspace:
+    while(!_states.isEmpty() && !pattern.startsWith(_states.last().pattern))
+        _states.removeLast();
+    if(!_states.isEmpty() && _states.last().pattern == pattern)
+        return;
+
+    MStringSearchSessionState state;
+    state.pattern = pattern;
+    index->clearError();
+    const MStringSearchIndexTable *table = index->table(pattern);
+    state.collatorLocaleName = table->_collatorLocaleName;
+    if(table->isValid())
+        state.patternCes = table->patternCes(pattern);
+    if(!table->isValid()
+       || !MStringSearchIndexTable::isSearchable(state.patternCes, index->_alternateHandlingShifted)) {
+        _states.append(state);
+        return;
+    }
+
+    // A match of the new pattern can only start where the collation
+    // elements of the previous pattern were found, if they are a
+    // prefix of the new ones:
+    const MStringSearchSessionState *previous = 0;
+    if(!_states.isEmpty()) {
+        const MStringSearchSessionState &last = _states.last();
+        if(last.hasCandidates
+           && last.collatorLocaleName == state.collatorLocaleName
+           && last.patternCes.size() <= state.patternCes.size()) {
+            previous = &last;
+            for(int i = 0; i < last.patternCes.size(); ++i) {
+                if(last.patternCes.at(i).ce != state.patternCes.at(i).ce) {
+                    previous = 0;
+                    break;
+                }
+            }
+        }
+    }
+
+    if(previous) {
+        const QVector<QPair<int, int> > &candidates = previous->candidates;
+        for(int i = 0; i < candidates.size(); ++i) {
+            const QPair<int, int> &candidate = candidates.at(i);
+            if(table->matchesPrefix(candidate.first, candidate.second, state.patternCes))
+                state.candidates << candidate;
+        }
+    }
+    else {
+        const quint64 firstCe = state.patternCes.first().ce;
+        for(int row = 0; row < index->_texts.size(); ++row) {
+            const int end = table->_rowStart.at(row + 1);
+            for(int i = table->_rowStart.at(row); i < end; ++i) {
+                if(table->_ces.at(i).ce == firstCe
+                   && table->isMatchStart(row, i)
+                   && table->matchesPrefix(row, i, state.patternCes))
+                    state.candidates << qMakePair(row, i);
+            }
+        }
+    }
+    state.hasCandidates = true;
+
+    // check the end of the match for the candidates, the first
+    // complete match in each row is the result for that row:
+    int lastRow = -1;
+    for(int i = 0; i < state.candidates.size(); ++i) {
+        const int row = state.candidates.at(i).first;
+        if(row == lastRow)
+            continue;
+        int start;
+        int length;
+        if(table->matchAt(row, state.candidates.at(i).second, state.patternCes,
+                          index->_texts.at(row), pattern, &start, &length)) {
+            state.rows << row;
+            state.matchedStarts << start;
+            state.matchedLengths << length;
+            lastRow = row;
+        }
+    }
+    _states.append(state);
+}
+
+MStringSearchSession::MStringSearchSession(const MStringSearchIndex *index)
+    : d_ptr(new MStringSearchSessionPrivate)
+{
+    Q_D(MStringSearchSession);
+    d->q_ptr = this;
+    d->_index = index;
+}
+
+MStringSearchSession::~MStringSearchSession()
+{
+    delete d_ptr;
+}
+
+void MStringSearchSession::setPattern(const QString &pattern)
+{
+    Q_D(MStringSearchSession);
+    d->search(pattern);
+}
+
+QString MStringSearchSession::pattern() const
+{
+    Q_D(const MStringSearchSession);
+    return d->_pattern;
+}
+
+QList<int> MStringSearchSession::matchingRows() const
+{
+    Q_D(const MStringSearchSession);
+    const MStringSearchSessionState *state = d->current();
+    if(!state)
+        return d->_index->matchingRows(d->_pattern);
+    return state->rows;
+}
+
+int MStringSearchSession::indexIn(int row, int *matchedLength) const
+{
+    Q_D(const MStringSearchSession);
+    const MStringSearchSessionState *state = d->current();
+    if(!state)
+        return d->_index->indexIn(row, d->_pattern, matchedLength);
+    QList<int>::const_iterator it = qBinaryFind(state->rows.constBegin(), state->rows.constEnd(), row);
+    if(it == state->rows.constEnd())
+        return -1;
+    const int i = it - state->rows.constBegin();
+    if(matchedLength)
+        *matchedLength = state->matchedLengths.at(i);
+    return state->matchedStarts.at(i);
+}
+
+void MStringSearchSession::clear()
+{
+    Q_D(MStringSearchSession);
+    d->_states.clear();
+    d->_pattern.clear();
+}
+
+}
@@ -0,0 +1,120 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef ML10N_MSTRINGSEARCHSESSION_H
+#define ML10N_MSTRINGSEARCHSESSION_H
+
+#include "mlocaleexport.h"
+
+#include <QList>
+#include <QString>
+
+namespace ML10N {
+
+class MStringSearchIndex;
+class MStringSearchSessionPrivate;
+
+/*!
+ * \class MStringSearchSession
+ *
+ * \brief searches an MStringSearchIndex while the user types the pattern
+ *
+ * When one more character is typed, usually only the rows which matched
+ * the shorter pattern can match the longer one. The session remembers
+ * for each pattern where its collation elements were found in the rows
+ * and only checks these positions again when the pattern is extended,
+ * instead of searching all rows. When characters are removed from the
+ * end of the pattern again, the results for the shorter pattern are
+ * restored from the cache without any searching.
+ *
+ * The results are always the same as calling
+ * MStringSearchIndex::matchingRows() with the pattern. If the new
+ * pattern does not extend the previous one, or the collation elements
+ * of the longer pattern do not start with the ones of the shorter
+ * pattern (which can happen with contractions, for example “aa” in
+ * Danish), all rows are searched again.
+ *
+ * Example:
+ *
+ * \code
+ * MStringSearchIndex index(names, locale);
+ * MStringSearchSession session(&index);
+ * session.setPattern("a");     // searches all rows
+ * session.setPattern("an");    // checks only where “a” was found
+ * session.setPattern("ann");   // checks only where “an” was found
+ * session.setPattern("an");    // restored from the cache
+ * QList<int> rows = session.matchingRows();
+ * \endcode
+ *
+ * The index must live longer than the session. Changing the texts,
+ * the locale or the options of the index clears the cache of the
+ * session.
+ */
+class MLOCALE_EXPORT MStringSearchSession
+{
+public:
+    /*!
+     * \brief constructs a session searching in \a index
+     */
+    explicit MStringSearchSession(const MStringSearchIndex *index);
+
+    /*!
+     * \brief destructor for MStringSearchSession
+     */
+    virtual ~MStringSearchSession();
+
+    /*!
+     * \brief sets the pattern and updates the matching rows
+     */
+    void setPattern(const QString &pattern);
+
+    /*!
+     * \brief returns the current pattern
+     */
+    QString pattern() const;
+
+    /*!
+     * \brief returns the rows in which the current pattern matches, in
+     * ascending order
+     */
+    QList<int> matchingRows() const;
+
+    /*!
+     * \brief returns the first index at which the current pattern
+     * matches in a row
+     *
+     * Returns “-1” if the pattern does not match in that row. If \a
+     * matchedLength is not 0, it receives the length of the match.
+     */
+    int indexIn(int row, int *matchedLength = 0) const;
+
+    /*!
+     * \brief forgets all cached results
+     */
+    void clear();
+
+private:
+    Q_DISABLE_COPY(MStringSearchSession)
+    MStringSearchSessionPrivate *const d_ptr;
+    Q_DECLARE_PRIVATE(MStringSearchSession)
+};
+
+}
+
+#endif
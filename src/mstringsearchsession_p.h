@@ -0,0 +1,81 @@
+/***************************************************************************
+**
+** Copyright (C) 2010, 2011 Nokia Corporation and/or its subsidiary(-ies).
+** All rights reserved.
+** Contact: Nokia Corporation (directui@nokia.com)
+**
+** This file is part of libmeegotouch.
+**
+** If you have questions regarding the use of this file, please contact
+** Nokia at directui@nokia.com.
+**
+** This library is free software; you can redistribute it and/or
+** modify it under the terms of the GNU Lesser General Public
+** License version 2.1 as published by the Free Software Foundation
+** and appearing in the file LICENSE.LGPL included in the packaging
+** of this file.
+**
+****************************************************************************/
+
+#ifndef MSTRINGSEARCHSESSION_P_H
+#define MSTRINGSEARCHSESSION_P_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+#include "mstringsearchindex_p.h"
+
+namespace ML10N {
+
+class MStringSearchIndex;
+class MStringSearchSession;
+
+// The search result for one pattern
+struct MStringSearchSessionState
+{
+    QString pattern;
+    QString collatorLocaleName;
+    QVector<MStringSearchIndexCe> patternCes;
+    // false if the pattern cannot match anything and the candidates
+    // were therefore not searched
+    bool hasCandidates;
+    // positions where the collation elements of the pattern were
+    // found, without checking the end of the match, as (row, index of
+    // the first collation element) in ascending order
+    QVector<QPair<int, int> > candidates;
+    // the rows with a complete match and the first match in each
+    QList<int> rows;
+    QVector<int> matchedStarts;
+    QVector<int> matchedLengths;
+
+    MStringSearchSessionState() : hasCandidates(false) {}
+};
+
+class MStringSearchSessionPrivate
+{
+    Q_DECLARE_PUBLIC(MStringSearchSession)
+
+public:
+    MStringSearchSessionPrivate();
+
+    void search(const QString &pattern);
+    const MStringSearchSessionState *current() const;
+
+    const MStringSearchIndex *_index;
+    int _revision;
+    QString _pattern;
+    // the results for the current pattern and its prefixes typed
+    // before, the current one last
+    QList<MStringSearchSessionState> _states;
+
+    MStringSearchSession *q_ptr;
+
+private:
+    Q_DISABLE_COPY(MStringSearchSessionPrivate)
+};
+
+}
+
+#endif
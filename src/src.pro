@@ -49,6 +49,9 @@ contains(DEFINES, HAVE_ICU) {
         mcharsetdetector.h \
         mcharsetmatch.h \
         mstringsearch.h \
+        mstringsearchindex.h \
+        mstringsearchsession.h \
+        mmultistringsearch.h \
 
     PRIVATE_HEADERS += \
         micubreakiterator.h \
@@ -62,6 +65,9 @@ contains(DEFINES, HAVE_ICU) {
         mcharsetdetector.cpp \
         mcharsetmatch.cpp \
         mstringsearch.cpp \
+        mstringsearchindex.cpp \
+        mstringsearchsession.cpp \
+        mmultistringsearch.cpp \
 
 } else {
     PRIVATE_HEADERS += \
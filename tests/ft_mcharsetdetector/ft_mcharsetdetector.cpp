@@ -259,6 +259,19 @@ void Ft_MCharsetDetector::testDetectableCharsets()
         QVERIFY2(detectableCharsets.contains(cs),
                  QString("charset %1 is missing in the list of detectable charset")
                  .arg(cs).toUtf8().constData());
+    // the list is the same for all detectors, whatever was detected
+    // before, and every charset in it can be decoded:
+    charsetDetector.setText(QByteArray("K\xf6nig"));
+    charsetDetector.detectAll();
+    MCharsetDetector otherCharsetDetector;
+    QCOMPARE(otherCharsetDetector.getAllDetectableCharsets(), detectableCharsets);
+    QCOMPARE(charsetDetector.getAllDetectableCharsets(), detectableCharsets);
+    foreach(QString cs, detectableCharsets) {
+        charsetDetector.setText(QByteArray("abc"));
+        charsetDetector.text(MCharsetMatch(cs, "", 10));
+        QVERIFY2(charsetDetector.errorString() != QLatin1String("U_ILLEGAL_ARGUMENT_ERROR"),
+                 QString("no codec for charset %1").arg(cs).toUtf8().constData());
+    }
 }
 
 static QString makeStringLonger(const QString &str, int n)
@@ -2001,4 +2014,473 @@ void Ft_MCharsetDetector::testDetection()
     }
 }
 
+void Ft_MCharsetDetector::testLargeInput_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<bool>("isUtf8");
+
+    // the input is checked in chunks of 64 KiB, make sure sequences
+    // crossing the chunk boundaries and invalid bytes far away from
+    // the start are handled correctly:
+    QByteArray ascii(200000, 'a');
+    QTest::newRow("ASCII")
+        << ascii << true;
+    QTest::newRow("UTF-8 sequence across chunk boundary")
+        << QByteArray(65535, 'a') + "\xc3\xa4" + ascii << true;
+    QTest::newRow("UTF-8 3 byte sequence across chunk boundary")
+        << QByteArray(65535, 'a') + "\xe4\xb8\xad" + ascii << true;
+    QTest::newRow("UTF-8 3 byte sequence at the end")
+        << ascii + "\xe4\xb8\xad" << true;
+    QTest::newRow("invalid UTF-8 at the start")
+        << "\xe4" + ascii << false;
+    QTest::newRow("invalid UTF-8 at the end")
+        << ascii + "\xe4" << false;
+    QTest::newRow("invalid UTF-8 after chunk boundary")
+        << QByteArray(65536, 'a') + "\xe4" + ascii << false;
+}
+
+void Ft_MCharsetDetector::testLargeInput()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(bool, isUtf8);
+
+    MCharsetDetector charsetDetector(input);
+    QList<MCharsetMatch> mCharsetMatchList = charsetDetector.detectAll();
+    QVERIFY(!charsetDetector.hasError());
+    QVERIFY(!mCharsetMatchList.isEmpty());
+    bool hasUtf8 = false;
+    foreach(const MCharsetMatch &match, mCharsetMatchList) {
+        if(match.name() == QLatin1String("UTF-8"))
+            hasUtf8 = true;
+        // every match returned has to decode the complete input:
+        charsetDetector.text(match);
+        QVERIFY2(!charsetDetector.hasError(),
+                 qPrintable("match " + match.name() + " cannot decode the input"));
+    }
+    QCOMPARE(hasUtf8, isUtf8);
+}
+
+void Ft_MCharsetDetector::testInputClassification_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<QString>("declaredLocale");
+    QTest::addColumn<QString>("declaredEncoding");
+    QTest::addColumn<bool>("isValidUtf8");
+    QTest::addColumn<int>("utf8Confidence");
+
+    QByteArray ascii(60, 'a');
+    // valid UTF-8 is returned right away with the confidence the
+    // complete detection would have given:
+    QTest::newRow("short UTF-8, repeated to more than 3 sequences")
+        << QByteArray("\xc3\xa4") << "" << "" << true << 100;
+    QTest::newRow("UTF-8 with 1 sequence")
+        << ascii + "\xc3\xa4" << "" << "" << true << 99;
+    QTest::newRow("UTF-8 with 4 sequences")
+        << ascii + "\xc3\xa4\xc3\xb6\xc3\xbc\xc3\x9f" << "" << "" << true << 100;
+    QTest::newRow("UTF-8 with BOM")
+        << "\xef\xbb\xbf" + ascii << "" << "" << true << 100;
+    QTest::newRow("UTF-8 4 byte sequence")
+        << ascii + "\xf0\x9f\x98\x80" << "" << "" << true << 99;
+    QTest::newRow("UTF-8 sequence across 16 byte block")
+        << QByteArray(15, 'a') + "\xe4\xb8\xad" + ascii << "" << "" << true << 99;
+    QTest::newRow("UTF-8 with declared locale and encoding")
+        << ascii + "\xc3\xa4" << "de_DE" << "ISO-8859-1" << true << 99;
+    // everything else goes through the complete detection:
+    QTest::newRow("ASCII")
+        << ascii << "" << "" << false << 0;
+    QTest::newRow("ASCII with declared locale")
+        << ascii << "ru_RU" << "" << false << 0;
+    QTest::newRow("ASCII with declared encoding")
+        << ascii << "" << "ISO-8859-7" << false << 0;
+    QTest::newRow("ISO-8859-1")
+        << ascii + "\xe4\xf6\xfc" << "" << "" << false << 0;
+    QTest::newRow("overlong UTF-8")
+        << ascii + "\xc0\xaf" << "" << "" << false << 0;
+    QTest::newRow("UTF-8 surrogate")
+        << ascii + "\xed\xa0\x80" << "" << "" << false << 0;
+    QTest::newRow("UTF-8 noncharacter")
+        << ascii + "\xef\xbf\xbf" << "" << "" << false << 0;
+    QTest::newRow("truncated UTF-8 sequence")
+        << ascii + "\xe4\xb8" << "" << "" << false << 0;
+    QTest::newRow("UTF-8 with escape")
+        << ascii + "\x1b(B\xc3\xa4" << "" << "" << false << 0;
+    QTest::newRow("UTF-16LE")
+        << QByteArray("\xff\xfe" "a\0b\0c\0\xe4\0", 10) << "" << "" << false << 0;
+}
+
+void Ft_MCharsetDetector::testInputClassification()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(QString, declaredLocale);
+    QFETCH(QString, declaredEncoding);
+    QFETCH(bool, isValidUtf8);
+    QFETCH(int, utf8Confidence);
+
+    MCharsetDetector charsetDetector(input);
+    charsetDetector.setDeclaredLocale(declaredLocale);
+    charsetDetector.setDeclaredEncoding(declaredEncoding);
+    QList<MCharsetMatch> mCharsetMatchList = charsetDetector.detectAll();
+    QVERIFY(!charsetDetector.hasError());
+    QVERIFY(!mCharsetMatchList.isEmpty());
+    if (isValidUtf8) {
+        QCOMPARE(mCharsetMatchList.size(), 1);
+        QCOMPARE(mCharsetMatchList.first().name(), QString("UTF-8"));
+        QCOMPARE(mCharsetMatchList.first().language(), QString(""));
+        QCOMPARE(mCharsetMatchList.first().confidence(), utf8Confidence);
+        // with the input filter, the complete detection is used:
+        charsetDetector.enableInputFilter(true);
+        QCOMPARE(charsetDetector.detect().name(), QString("UTF-8"));
+    }
+    // the decoding checks are skipped for ASCII input and ASCII
+    // compatible charsets, every match still has to decode it:
+    foreach(const MCharsetMatch &match, mCharsetMatchList) {
+        charsetDetector.text(match);
+        QVERIFY2(!charsetDetector.hasError(),
+                 qPrintable("match " + match.name() + " cannot decode the input"));
+    }
+}
+
+void Ft_MCharsetDetector::testDetectAndDecode_data()
+{
+    testDetection_data();
+}
+
+void Ft_MCharsetDetector::testDetectAndDecode()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, declaredLocale);
+    QFETCH(QString, declaredEncoding);
+    QFETCH(bool, enableInputFilter);
+    QFETCH(QString, inputEncoding);
+    QFETCH(QString, bestMatchName);
+    QFETCH(QString, bestMatchLanguage);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+    QByteArray encodedString = codec->fromUnicode(text);
+
+    MCharsetDetector charsetDetector(encodedString);
+    charsetDetector.setDeclaredLocale(declaredLocale);
+    charsetDetector.setDeclaredEncoding(declaredEncoding);
+    charsetDetector.enableInputFilter(enableInputFilter);
+    MCharsetMatch expectedMatch = charsetDetector.detect();
+    QString expectedText = charsetDetector.text(expectedMatch);
+
+    QString decodedText;
+    MCharsetMatch bestMatch = charsetDetector.detectAndDecode(&decodedText);
+    QVERIFY(!charsetDetector.hasError());
+    QCOMPARE(bestMatch.name(), bestMatchName);
+    QCOMPARE(bestMatch.language(), bestMatchLanguage);
+    QCOMPARE(bestMatch.confidence(), expectedMatch.confidence());
+    QCOMPARE(decodedText, expectedText);
+
+    QByteArray utf8;
+    bestMatch = charsetDetector.detectAndDecodeToUtf8(&utf8);
+    QVERIFY(!charsetDetector.hasError());
+    QCOMPARE(bestMatch.name(), bestMatchName);
+    QCOMPARE(utf8, expectedText.toUtf8());
+
+    // the text is optional:
+    bestMatch = charsetDetector.detectAndDecode(0);
+    QCOMPARE(bestMatch.name(), bestMatchName);
+}
+
+static QList<QByteArray> batchInput()
+{
+    QList<QByteArray> buffers;
+    QString german = QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. ");
+    QString russian = QString::fromUtf8("Съешь же ещё этих мягких французских булок. ");
+    QString japanese = QString::fromUtf8("今日は雨が降っています。明日は晴れるでしょう。");
+    const char *encodings[] = { "UTF-8", "ISO-8859-1", "KOI8-R", "windows-1251",
+                                "Shift_JIS", "EUC-JP", 0 };
+    for (int i = 0; i < 100; ++i) {
+        QString text = i % 3 == 0 ? german : i % 3 == 1 ? russian : japanese;
+        QTextCodec *codec = QTextCodec::codecForName(encodings[i % 6]);
+        if (codec->canEncode(text))
+            buffers << codec->fromUnicode(makeStringLonger(text, 1 + i % 7));
+    }
+    // empty and pure ASCII input in between:
+    buffers.insert(10, QByteArray());
+    buffers.insert(20, QByteArray("plain ASCII text"));
+    return buffers;
+}
+
+void Ft_MCharsetDetector::testDetectBuffers_data()
+{
+    QTest::addColumn<QString>("declaredLocale");
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1 thread") << "" << 1;
+    QTest::newRow("4 threads") << "" << 4;
+    QTest::newRow("ideal thread count") << "" << 0;
+    QTest::newRow("ru, 4 threads") << "ru_RU" << 4;
+}
+
+void Ft_MCharsetDetector::testDetectBuffers()
+{
+    QFETCH(QString, declaredLocale);
+    QFETCH(int, threads);
+
+    QList<QByteArray> buffers = batchInput();
+    QList<MCharsetMatch> matches
+        = MCharsetDetector::detectBuffers(buffers, declaredLocale, QString(), threads);
+    QCOMPARE(matches.size(), buffers.size());
+    // the matches are in input order and the same as detected one by one:
+    for (int i = 0; i < buffers.size(); ++i) {
+        MCharsetDetector charsetDetector(buffers.at(i));
+        charsetDetector.setDeclaredLocale(declaredLocale);
+        MCharsetMatch bestMatch = charsetDetector.detect();
+        QCOMPARE(matches.at(i).name(), bestMatch.name());
+        QCOMPARE(matches.at(i).language(), bestMatch.language());
+        QCOMPARE(matches.at(i).confidence(), bestMatch.confidence());
+    }
+    QVERIFY(MCharsetDetector::detectBuffers(QList<QByteArray>()).isEmpty());
+}
+
+void Ft_MCharsetDetector::testDetectFiles_data()
+{
+    QTest::addColumn<int>("threads");
+
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("4 threads") << 4;
+}
+
+void Ft_MCharsetDetector::testDetectFiles()
+{
+    QFETCH(int, threads);
+
+    QList<QByteArray> buffers = batchInput();
+    // one file larger than the sample budget:
+    buffers << QByteArray(200000, 'a') + "\xc3\xa4" + QByteArray(200000, 'a');
+    QList<QTemporaryFile *> files;
+    QStringList fileNames;
+    for (int i = 0; i < buffers.size(); ++i) {
+        QTemporaryFile *file = new QTemporaryFile;
+        QVERIFY(file->open());
+        QCOMPARE(file->write(buffers.at(i)), qint64(buffers.at(i).size()));
+        file->close();
+        files << file;
+        fileNames << file->fileName();
+    }
+    fileNames.insert(5, QString("/nonexistent/file"));
+    buffers.insert(5, QByteArray());
+
+    QList<MCharsetMatch> matches = MCharsetDetector::detectFiles(fileNames, "", "", threads);
+    QCOMPARE(matches.size(), fileNames.size());
+    QVERIFY(matches.at(5).name().isEmpty());
+    for (int i = 0; i < buffers.size(); ++i) {
+        if (i == 5)
+            continue;
+        MCharsetDetector charsetDetector;
+        charsetDetector.feed(buffers.at(i).constData(), buffers.at(i).size());
+        charsetDetector.finish();
+        MCharsetMatch bestMatch = charsetDetector.detect();
+        QCOMPARE(matches.at(i).name(), bestMatch.name());
+        QCOMPARE(matches.at(i).confidence(), bestMatch.confidence());
+    }
+    qDeleteAll(files);
+}
+
+void Ft_MCharsetDetector::testSetFile_data()
+{
+    QTest::addColumn<QByteArray>("input");
+
+    QTest::newRow("short ISO-8859-1, padded")
+        << QByteArray("K\xf6nig");
+    QTest::newRow("short UTF-8, padded")
+        << QString::fromUtf8("Größe").toUtf8();
+    QTest::newRow("empty")
+        << QByteArray();
+    QTest::newRow("German ISO-8859-1")
+        << QTextCodec::codecForName("ISO-8859-1")->fromUnicode(
+            makeStringLonger(QString::fromUtf8("Größere Dateien mit Umlauten: äöüß ÄÖÜ. "), 100));
+    QTest::newRow("Japanese EUC-JP")
+        << QTextCodec::codecForName("EUC-JP")->fromUnicode(
+            makeStringLonger(QString::fromUtf8("今日は雨が降っています。"), 50));
+    // libicu only gets the input up to the first NUL byte:
+    QTest::newRow("NUL byte in the middle")
+        << QByteArray(100, 'a') + QByteArray(1, '\0') + "\xe4\xf6\xfc" + QByteArray(100, 'b');
+    QTest::newRow("UTF-16LE with BOM")
+        << QByteArray("\xff\xfe", 2) + QTextCodec::codecForName("UTF-16LE")->fromUnicode(
+            makeStringLonger(QString::fromUtf8("Größe "), 20));
+}
+
+void Ft_MCharsetDetector::testSetFile()
+{
+    QFETCH(QByteArray, input);
+
+    MCharsetDetector expectedDetector(input);
+    QList<MCharsetMatch> expectedMatches = expectedDetector.detectAll();
+
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QCOMPARE(file.write(input), qint64(input.size()));
+    file.close();
+
+    MCharsetDetector charsetDetector;
+    QVERIFY(charsetDetector.setFile(file.fileName()));
+    QVERIFY(!charsetDetector.hasError());
+    QList<MCharsetMatch> matches = charsetDetector.detectAll();
+    QCOMPARE(matches.size(), expectedMatches.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(matches.at(i).name(), expectedMatches.at(i).name());
+        QCOMPARE(matches.at(i).confidence(), expectedMatches.at(i).confidence());
+        QCOMPARE(charsetDetector.text(matches.at(i)),
+                 expectedDetector.text(expectedMatches.at(i)));
+    }
+    // the UTF-8 output does not refer to the mapped file:
+    QByteArray utf8;
+    charsetDetector.detectAndDecodeToUtf8(&utf8);
+    charsetDetector.setText(QByteArray("abc"));
+    if (!matches.isEmpty())
+        QCOMPARE(utf8, expectedDetector.text(expectedMatches.first()).toUtf8());
+
+    // the same without copying data from memory:
+    charsetDetector.setRawData(input.constData(), input.size());
+    matches = charsetDetector.detectAll();
+    QCOMPARE(matches.size(), expectedMatches.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(matches.at(i).name(), expectedMatches.at(i).name());
+        QCOMPARE(matches.at(i).confidence(), expectedMatches.at(i).confidence());
+    }
+
+    QVERIFY(!charsetDetector.setFile("/nonexistent/file"));
+    QVERIFY(charsetDetector.hasError());
+}
+
+void Ft_MCharsetDetector::testFeed_data()
+{
+    testDetection_data();
+}
+
+void Ft_MCharsetDetector::testFeed()
+{
+    QFETCH(QString, text);
+    QFETCH(QString, declaredLocale);
+    QFETCH(QString, declaredEncoding);
+    QFETCH(bool, enableInputFilter);
+    QFETCH(QString, inputEncoding);
+
+    QTextCodec *codec = QTextCodec::codecForName(inputEncoding.toLatin1());
+    if (codec == NULL) // there is no codec matching the name
+        QFAIL(QString("no such codec: " + inputEncoding).toLatin1().constData());
+    QByteArray encodedString = codec->fromUnicode(text);
+
+    MCharsetDetector charsetDetector(encodedString);
+    charsetDetector.setDeclaredLocale(declaredLocale);
+    charsetDetector.setDeclaredEncoding(declaredEncoding);
+    charsetDetector.enableInputFilter(enableInputFilter);
+    QList<MCharsetMatch> expectedMatches = charsetDetector.detectAll();
+
+    // feeding input shorter than the sample budget in small pieces
+    // has to give the same result as setText(), unless the
+    // detection is conclusive before the end of the input:
+    MCharsetDetector feedDetector;
+    feedDetector.setDeclaredLocale(declaredLocale);
+    feedDetector.setDeclaredEncoding(declaredEncoding);
+    feedDetector.enableInputFilter(enableInputFilter);
+    bool isConclusive = false;
+    for (int i = 0; i < encodedString.size(); i += 7) {
+        if (!feedDetector.feed(encodedString.constData() + i,
+                               qMin(7, encodedString.size() - i))) {
+            isConclusive = true;
+            break;
+        }
+    }
+    feedDetector.finish();
+    QList<MCharsetMatch> matches = feedDetector.detectAll();
+    if (isConclusive) {
+        QVERIFY(!matches.isEmpty());
+        QVERIFY(!expectedMatches.isEmpty());
+        QCOMPARE(matches.first().name(), expectedMatches.first().name());
+        return;
+    }
+    QCOMPARE(matches.size(), expectedMatches.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(matches.at(i).name(), expectedMatches.at(i).name());
+        QCOMPARE(matches.at(i).language(), expectedMatches.at(i).language());
+        QCOMPARE(matches.at(i).confidence(), expectedMatches.at(i).confidence());
+    }
+}
+
+void Ft_MCharsetDetector::testFeedWithSampleBudget_data()
+{
+    testLargeInput_data();
+}
+
+void Ft_MCharsetDetector::testFeedWithSampleBudget()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(bool, isUtf8);
+
+    MCharsetDetector charsetDetector;
+    charsetDetector.setSampleBudget(1000);
+    QCOMPARE(charsetDetector.sampleBudget(), 1000);
+    for (int i = 0; i < input.size(); i += 4096)
+        charsetDetector.feed(input.constData() + i, qMin(4096, input.size() - i));
+    charsetDetector.finish();
+    QList<MCharsetMatch> mCharsetMatchList = charsetDetector.detectAll();
+    QVERIFY(!charsetDetector.hasError());
+    QVERIFY(!mCharsetMatchList.isEmpty());
+    // only the sample is kept:
+    QCOMPARE(charsetDetector.text(mCharsetMatchList.first()).size(), 1000);
+    bool hasUtf8 = false;
+    foreach(const MCharsetMatch &match, mCharsetMatchList) {
+        if(match.name() == QLatin1String("UTF-8"))
+            hasUtf8 = true;
+        // every match returned has to decode the complete input,
+        // not only the sample:
+        QTextCodec *codec = QTextCodec::codecForName(match.name().toLatin1());
+        QVERIFY(codec);
+        QTextCodec::ConverterState state;
+        codec->toUnicode(input.constData(), input.size(), &state);
+        QVERIFY2(state.invalidChars == 0,
+                 qPrintable("match " + match.name() + " cannot decode the input"));
+    }
+    QCOMPARE(hasUtf8, isUtf8);
+}
+
+void Ft_MCharsetDetector::testFeedConclusive_data()
+{
+    QTest::addColumn<QByteArray>("input");
+    QTest::addColumn<int>("pieceSize");
+    QTest::addColumn<QString>("bestMatchName");
+
+    QByteArray ascii(1000, 'a');
+    QTest::newRow("UTF-8 BOM")
+        << "\xef\xbb\xbf" + ascii << 10 << "UTF-8";
+    QTest::newRow("UTF-8")
+        << ascii + QString::fromUtf8("äöüß äöüß äöüß äöüß").toUtf8() + ascii << 10 << "UTF-8";
+    // feed complete ISO-2022-JP escape sequences:
+    QByteArray iso2022jp = QTextCodec::codecForName("ISO-2022-JP")->fromUnicode(
+        QString::fromUtf8("日本語の文章です。"));
+    QTest::newRow("ISO-2022-JP")
+        << iso2022jp + ascii << iso2022jp.size() << "ISO-2022-JP";
+}
+
+void Ft_MCharsetDetector::testFeedConclusive()
+{
+    QFETCH(QByteArray, input);
+    QFETCH(int, pieceSize);
+    QFETCH(QString, bestMatchName);
+
+    MCharsetDetector charsetDetector;
+    bool isConclusive = false;
+    int fed = 0;
+    for (; fed < input.size() && !isConclusive; fed += pieceSize)
+        isConclusive = !charsetDetector.feed(input.constData() + fed,
+                                             qMin(pieceSize, input.size() - fed));
+    QVERIFY(isConclusive);
+    QVERIFY(fed < input.size());
+    // more input is ignored:
+    QVERIFY(!charsetDetector.feed("\xff\xff", 2));
+    charsetDetector.finish();
+    QCOMPARE(charsetDetector.detect().name(), bestMatchName);
+    // feeding again starts a new input:
+    QVERIFY(charsetDetector.feed("abc", 3));
+    charsetDetector.finish();
+    QCOMPARE(charsetDetector.text(charsetDetector.detect()), QString("abc"));
+}
+
 QTEST_APPLESS_MAIN(Ft_MCharsetDetector);
@@ -56,6 +56,32 @@ private slots:
 
     void testDetection_data();
     void testDetection();
+
+    void testLargeInput_data();
+    void testLargeInput();
+
+    void testInputClassification_data();
+    void testInputClassification();
+
+    void testDetectAndDecode_data();
+    void testDetectAndDecode();
+
+    void testDetectBuffers_data();
+    void testDetectBuffers();
+    void testDetectFiles_data();
+    void testDetectFiles();
+
+    void testSetFile_data();
+    void testSetFile();
+
+    void testFeed_data();
+    void testFeed();
+
+    void testFeedWithSampleBudget_data();
+    void testFeedWithSampleBudget();
+
+    void testFeedConclusive_data();
+    void testFeedConclusive();
 };
 
 #endif
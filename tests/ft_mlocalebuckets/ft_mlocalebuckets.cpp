@@ -665,6 +665,122 @@ void Ft_MLocaleBuckets::testCopy()
     QVERIFY(buckets3.origItemIndex(Y_Bucket, 0) == inputItems.indexOf("Yannick"));
 }
 
+void Ft_MLocaleBuckets::compareBuckets(const MLocaleBuckets &buckets, const MLocaleBuckets &expected) const
+{
+    QCOMPARE(buckets.bucketCount(), expected.bucketCount());
+    for (int b = 0; b < expected.bucketCount(); ++b) {
+        QCOMPARE(buckets.bucketName(b), expected.bucketName(b));
+        QCOMPARE(buckets.bucketContent(b), expected.bucketContent(b));
+        for (int i = 0; i < expected.bucketSize(b); ++i)
+            QCOMPARE(buckets.origItemIndex(b, i), expected.origItemIndex(b, i));
+    }
+}
+
+
+void Ft_MLocaleBuckets::testIndexFile()
+{
+    MLocale locale("de_DE");
+    MLocale::setDefault(locale);
+
+    QString indexFileName("/tmp/ft_mlocalebuckets_index.bin");
+    QFile::remove(indexFileName);
+
+    QStringList items = inputItems;
+    items << "Zoe" << "Ärger" << "aerger" << "Ärger" << "Bernardo" << "" << "123";
+
+    // no index yet, must be sorted and written:
+    MLocaleBuckets buckets;
+    QVERIFY(!buckets.setItems(items, indexFileName));
+    QVERIFY(QFile::exists(indexFileName));
+    compareBuckets(buckets, MLocaleBuckets(items));
+
+    // index is up to date:
+    MLocaleBuckets buckets2;
+    QVERIFY(buckets2.setItems(items, indexFileName));
+    compareBuckets(buckets2, MLocaleBuckets(items));
+
+    // changed items, the index is rebuilt:
+    items.removeAt(3);
+    items.removeAt(0);
+    items << "Ömer" << "Olga" << "Aaron" << "Zacharias";
+    items.move(2, 7);
+    QVERIFY(!buckets2.setItems(items, indexFileName));
+    compareBuckets(buckets2, MLocaleBuckets(items));
+    QVERIFY(buckets2.setItems(items, indexFileName));
+    compareBuckets(buckets2, MLocaleBuckets(items));
+
+    // different sort order:
+    QVERIFY(!buckets2.setItems(items, indexFileName, Qt::DescendingOrder));
+    compareBuckets(buckets2, MLocaleBuckets(items, Qt::DescendingOrder));
+    QVERIFY(buckets2.setItems(items, indexFileName, Qt::DescendingOrder));
+
+    // removing items and writing the index explicitly:
+    buckets2.removeBucketItems(0, 0, 1);
+    buckets2.removeEmptyBucket(0);
+    QVERIFY(buckets2.writeIndex(indexFileName));
+    QStringList remainingItems;
+    for (int b = 0; b < buckets2.bucketCount(); ++b)
+        for (int i = 0; i < buckets2.bucketSize(b); ++i)
+            remainingItems << QString();
+    for (int b = 0; b < buckets2.bucketCount(); ++b)
+        for (int i = 0; i < buckets2.bucketSize(b); ++i)
+            remainingItems[buckets2.origItemIndex(b, i)] = buckets2.bucketContent(b).at(i);
+    MLocaleBuckets buckets3;
+    QVERIFY(buckets3.setItems(remainingItems, indexFileName, Qt::DescendingOrder));
+    compareBuckets(buckets3, buckets2);
+
+    // different locale, the index is rebuilt:
+    MLocale localeCs("cs_CZ");
+    MLocale::setDefault(localeCs);
+    MLocaleBuckets buckets4;
+    QVERIFY(!buckets4.setItems(items, indexFileName));
+    compareBuckets(buckets4, MLocaleBuckets(items));
+    QVERIFY(buckets4.setItems(items, indexFileName));
+
+    // broken index file:
+    QFile file(indexFileName);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.resize(file.size() - 3));
+    file.close();
+    MLocaleBuckets buckets5;
+    QVERIFY(!buckets5.setItems(items, indexFileName));
+    compareBuckets(buckets5, MLocaleBuckets(items));
+
+    QFile::remove(indexFileName);
+    MLocale::setDefault(locale);
+}
+
+
+void Ft_MLocaleBuckets::testSortedItems()
+{
+    MLocale locale("cs_CZ");
+    MLocale::setDefault(locale);
+
+    QStringList items1 = inputItems.mid(0, 7);
+    QStringList items2 = inputItems.mid(7);
+    items2 << "Chaim" << "Ömer" << "Zuzana";
+    QStringList items3;
+    items3 << "Hana" << "Chrudim";
+
+    QList<QStringList> sortedLists;
+    foreach (const QStringList &items, QList<QStringList>() << items1 << items2 << QStringList() << items3) {
+        MLocaleBuckets sorted(items);
+        QStringList sortedItems;
+        for (int b = 0; b < sorted.bucketCount(); ++b)
+            sortedItems << sorted.bucketContent(b);
+        sortedLists << sortedItems;
+    }
+
+    QStringList concatenated;
+    foreach (const QStringList &items, sortedLists)
+        concatenated << items;
+
+    MLocaleBuckets buckets;
+    buckets.setSortedItems(sortedLists);
+    compareBuckets(buckets, MLocaleBuckets(concatenated));
+}
+
+
 void Ft_MLocaleBuckets::sortTestFiles_data()
 {
     QTest::addColumn<QString>("localeName");
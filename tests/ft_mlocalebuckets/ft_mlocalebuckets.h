@@ -41,11 +41,14 @@ private slots:
     void testCzechGrouping();
     void testRemove();
     void testCopy();
+    void testIndexFile();
+    void testSortedItems();
 
     void sortTestFiles_data();
     void sortTestFiles();
 
 private:
+    void compareBuckets(const MLocaleBuckets &buckets, const MLocaleBuckets &expected) const;
     void dumpBuckets(const MLocaleBuckets &buckets, const char *header=0) const;
     bool checkBucketContent(const MLocaleBuckets &buckets, int bucketIndex, const QStringList &expectedItems) const;
 };
@@ -24,6 +24,9 @@
 using ML10N::MLocale;
 using ML10N::MBreakIterator;
 using ML10N::MStringSearch;
+using ML10N::MStringSearchIndex;
+using ML10N::MStringSearchSession;
+using ML10N::MMultiStringSearch;
 
 void Ft_MStringSearch::initTestCase()
 {
@@ -682,5 +685,479 @@ void Ft_MStringSearch::testSearch()
     QCOMPARE(matchText, firstMatchText);
 }
 
+void Ft_MStringSearch::testCachedCollators()
+{
+    MLocale locale("en_US");
+    MStringSearch stringSearch1("a", "x Ä", locale);
+    MStringSearch stringSearch2("a", "x Ä", locale);
+    QCOMPARE(stringSearch1.first(), 2);
+    QCOMPARE(stringSearch2.first(), 2);
+    // changing the options of one instance must neither change
+    // another instance nor the cached collator used for new instances:
+    stringSearch1.setCollatorStrength(MLocale::CollatorStrengthTertiary);
+    QCOMPARE(stringSearch1.first(), -1);
+    QCOMPARE(stringSearch2.first(), 2);
+    MStringSearch stringSearch3("a", "x Ä", locale);
+    QCOMPARE(stringSearch3.first(), 2);
+    stringSearch3.setCollatorStrength(MLocale::CollatorStrengthTertiary);
+    QCOMPARE(stringSearch3.first(), -1);
+    // different break iterator types must not share the cached break iterator:
+    MStringSearch stringSearch4("a", "xa a", locale, MBreakIterator::WordIterator);
+    MStringSearch stringSearch5("a", "xa a", locale, MBreakIterator::CharacterIterator);
+    QCOMPARE(stringSearch4.first(), 3);
+    QCOMPARE(stringSearch5.first(), 1);
+    MStringSearch stringSearch6("a", "xa a", locale, MBreakIterator::WordIterator);
+    QCOMPARE(stringSearch6.first(), 3);
+    QCOMPARE(stringSearch1.errorString(), QString());
+    QCOMPARE(stringSearch6.errorString(), QString());
+}
+
+void Ft_MStringSearch::testFindAll_data()
+{
+    testSearch_data();
+}
+
+void Ft_MStringSearch::testFindAll()
+{
+    QFETCH(QString, language);
+    QFETCH(QString, lcCollate);
+    QFETCH(QString, pattern);
+    QFETCH(QString, text);
+    QFETCH(MBreakIterator::Type, breakIteratorType);
+    QFETCH(MLocale::CollatorStrength, collatorStrength);
+    QFETCH(bool, isAlternateHandlingShifted);
+    QFETCH(QList<int>, matchStarts);
+    QFETCH(QList<int>, matchLengths);
+
+    MLocale locale(language);
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    // repeat the text to get more than one match:
+    const QString longText = text + " " + text + " " + text;
+    MStringSearch stringSearch(pattern, longText, locale, breakIteratorType);
+    stringSearch.setCollatorStrength(collatorStrength);
+    stringSearch.setAlternateHandlingShifted(isAlternateHandlingShifted);
+
+    QVector<QPair<int, int> > expected;
+    for(int start = stringSearch.first(); start != -1; start = stringSearch.next())
+        expected.append(qMakePair(start, stringSearch.matchedLength()));
+    QVERIFY(!expected.isEmpty());
+    QCOMPARE(expected.first(), qMakePair(matchStarts.first(), matchLengths.first()));
+
+    QVector<QPair<int, int> > matches = stringSearch.findAll();
+    QCOMPARE(matches, expected);
+    QCOMPARE(stringSearch.errorString(), QString());
+    QCOMPARE(stringSearch.findAll(0).size(), 0);
+    QCOMPARE(stringSearch.findAll(1), expected.mid(0, 1));
+    QCOMPARE(stringSearch.findAll(2), expected.mid(0, 2));
+    QCOMPARE(stringSearch.findAll(expected.size() + 1), expected);
+}
+
+void Ft_MStringSearch::testSearchIndex_data()
+{
+    testSearch_data();
+}
+
+void Ft_MStringSearch::testSearchIndex()
+{
+    QFETCH(QString, language);
+    QFETCH(QString, lcCollate);
+    QFETCH(QString, pattern);
+    QFETCH(QString, text);
+    QFETCH(MBreakIterator::Type, breakIteratorType);
+    QFETCH(MLocale::CollatorStrength, collatorStrength);
+    QFETCH(bool, isAlternateHandlingShifted);
+    QFETCH(QList<int>, matchStarts);
+    QFETCH(QList<int>, matchLengths);
+    QFETCH(QStringList, matchTexts);
+
+    MLocale locale(language);
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    QStringList texts;
+    texts << QString() << text << "1234567890" << text;
+    MStringSearchIndex index(texts, locale, breakIteratorType);
+    QCOMPARE(index.errorString(), QString());
+    QCOMPARE(index.rowCount(), texts.size());
+    QCOMPARE(index.collatorStrength(), MLocale::CollatorStrengthPrimary);
+    index.setCollatorStrength(collatorStrength);
+    QCOMPARE(index.collatorStrength(), collatorStrength);
+    QCOMPARE(index.alternateHandlingShifted(), true);
+    index.setAlternateHandlingShifted(isAlternateHandlingShifted);
+    QCOMPARE(index.alternateHandlingShifted(), isAlternateHandlingShifted);
+
+    QCOMPARE(index.matchingRows(pattern), QList<int>() << 1 << 3);
+    int matchedLength = -1;
+    QCOMPARE(index.indexIn(1, pattern, &matchedLength), matchStarts.first());
+    QCOMPARE(matchedLength, matchLengths.first());
+    QCOMPARE(text.mid(matchStarts.first(), matchedLength), matchTexts.first());
+    QCOMPARE(index.indexIn(0, pattern), -1);
+}
+
+void Ft_MStringSearch::testSearchIndexAgainstStringSearch_data()
+{
+    QTest::addColumn<QString>("lcCollate");
+    QTest::addColumn<MBreakIterator::Type>("breakIteratorType");
+
+    QStringList localeNames;
+    localeNames << "en_US" << "da_DK" << "de_DE" << "cs_CZ" << "fr_FR"
+                << "zh_CN" << "zh_TW" << "ja_JP" << "th_TH";
+    foreach(const QString &localeName, localeNames) {
+        QTest::newRow((localeName + " character").toUtf8().constData())
+            << localeName << MBreakIterator::CharacterIterator;
+        QTest::newRow((localeName + " word").toUtf8().constData())
+            << localeName << MBreakIterator::WordIterator;
+    }
+}
+
+void Ft_MStringSearch::testSearchIndexAgainstStringSearch()
+{
+    QFETCH(QString, lcCollate);
+    QFETCH(MBreakIterator::Type, breakIteratorType);
+
+    const QStringList pieces = QString::fromUtf8(
+        "a|A|á|å|aa|Å|æ|ae|ö|o|e|é|ch|c|h| |-|ß|ss|\xcc\x81|\xcc\x88|中|文|刘|liu|ก|ไ|1|½|ﬁ|fi|x").split('|');
+    qsrand(4711);
+    QStringList texts;
+    for(int row = 0; row < 200; ++row) {
+        QString text;
+        int length = qrand() % 8;
+        for(int i = 0; i < length; ++i)
+            text += pieces.at(qrand() % pieces.size());
+        texts << text;
+    }
+    QStringList patterns;
+    for(int i = 0; i < 20; ++i) {
+        QString pattern;
+        int length = 1 + qrand() % 3;
+        for(int j = 0; j < length; ++j)
+            pattern += pieces.at(qrand() % pieces.size());
+        patterns << pattern;
+    }
+
+    QList<MLocale::CollatorStrength> strengths;
+    strengths << MLocale::CollatorStrengthPrimary
+              << MLocale::CollatorStrengthSecondary
+              << MLocale::CollatorStrengthTertiary
+              << MLocale::CollatorStrengthQuaternary
+              << MLocale::CollatorStrengthIdentical;
+
+    MLocale locale("en_US");
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    MStringSearchIndex index(texts, locale, breakIteratorType);
+    foreach(MLocale::CollatorStrength strength, strengths) {
+        for(int shifted = 0; shifted < 2; ++shifted) {
+            index.setCollatorStrength(strength);
+            index.setAlternateHandlingShifted(shifted);
+            foreach(const QString &pattern, patterns) {
+                QList<int> expectedRows;
+                for(int row = 0; row < texts.size(); ++row) {
+                    MStringSearch stringSearch(pattern, texts.at(row), locale, breakIteratorType);
+                    stringSearch.setCollatorStrength(strength);
+                    stringSearch.setAlternateHandlingShifted(shifted);
+                    int expectedStart = stringSearch.first();
+                    int expectedLength = expectedStart < 0 ? -1 : stringSearch.matchedLength();
+                    int matchedLength = -1;
+                    int start = index.indexIn(row, pattern, &matchedLength);
+                    if(start != expectedStart || (start >= 0 && matchedLength != expectedLength))
+                        qDebug() << "pattern" << pattern << "text" << texts.at(row)
+                                 << "strength" << strength << "shifted" << shifted;
+                    QCOMPARE(start, expectedStart);
+                    if(start >= 0) {
+                        QCOMPARE(matchedLength, expectedLength);
+                        expectedRows << row;
+                    }
+                }
+                QCOMPARE(index.matchingRows(pattern), expectedRows);
+            }
+        }
+    }
+}
+
+void Ft_MStringSearch::testPrefixMatchingRows_data()
+{
+    QTest::addColumn<QString>("lcCollate");
+    QTest::addColumn<QString>("prefix");
+    QTest::addColumn<QList<int> >("expectedRows");
+
+    QTest::newRow("de_DE an")
+        << "de_DE" << "an" << (QList<int>() << 0 << 1);
+    QTest::newRow("de_DE AN")
+        << "de_DE" << "AN" << (QList<int>() << 0 << 1);
+    QTest::newRow("de_DE ber")
+        << "de_DE" << "ber" << (QList<int>() << 0);
+    QTest::newRow("de_DE ob")
+        << "de_DE" << "ob" << (QList<int>() << 2);
+    QTest::newRow("de_DE peter")
+        << "de_DE" << "peter" << (QList<int>() << 2);
+    QTest::newRow("de_DE anna b")
+        << "de_DE" << "anna b" << (QList<int>() << 0);
+    QTest::newRow("de_DE man")
+        << "de_DE" << "man" << (QList<int>() << 3);
+    QTest::newRow("de_DE ana")
+        << "de_DE" << "ana" << QList<int>();
+    QTest::newRow("de_DE x")
+        << "de_DE" << "x" << QList<int>();
+    QTest::newRow("sv_SE ob")
+        << "sv_SE" << "ob" << QList<int>();
+    QTest::newRow("sv_SE öb")
+        << "sv_SE" << "öb" << (QList<int>() << 2);
+    QTest::newRow("zh_CN 三")
+        << "zh_CN" << "三" << (QList<int>() << 4);
+}
+
+void Ft_MStringSearch::testPrefixMatchingRows()
+{
+    QFETCH(QString, lcCollate);
+    QFETCH(QString, prefix);
+    QFETCH(QList<int>, expectedRows);
+
+    QStringList texts;
+    texts << "Anna Berg" << "Bo Andersson" << "Hans-Peter Öberg" << "Mañana" << "张 三";
+    MLocale locale("en_US");
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    MStringSearchIndex index(texts, locale);
+    QCOMPARE(index.prefixMatchingRows(prefix), expectedRows);
+    QCOMPARE(index.errorString(), QString());
+    // the prefix index must be rebuilt when the options change:
+    index.setCollatorStrength(MLocale::CollatorStrengthTertiary);
+    index.prefixMatchingRows(prefix);
+    index.setCollatorStrength(MLocale::CollatorStrengthPrimary);
+    QCOMPARE(index.prefixMatchingRows(prefix), expectedRows);
+}
+
+void Ft_MStringSearch::testPrefixMatchingRowsAgainstStringSearch_data()
+{
+    QTest::addColumn<QString>("lcCollate");
+
+    QTest::newRow("en_US") << "en_US";
+    QTest::newRow("da_DK") << "da_DK";
+    QTest::newRow("de_DE") << "de_DE";
+    QTest::newRow("cs_CZ") << "cs_CZ";
+    QTest::newRow("zh_CN") << "zh_CN";
+    QTest::newRow("zh_TW") << "zh_TW";
+}
+
+void Ft_MStringSearch::testPrefixMatchingRowsAgainstStringSearch()
+{
+    QFETCH(QString, lcCollate);
+
+    const QStringList pieces = QString::fromUtf8(
+        "a|A|á|å|aa|Å|æ|ae|ö|o|e|é|ch|c|h| | |-|ß|ss|\xcc\x81|中|文|刘|liu|1|½|ﬁ|fi|x").split('|');
+    qsrand(4712);
+    QStringList texts;
+    for(int row = 0; row < 200; ++row) {
+        QString text;
+        int length = qrand() % 10;
+        for(int i = 0; i < length; ++i)
+            text += pieces.at(qrand() % pieces.size());
+        texts << text;
+    }
+    QStringList prefixes;
+    for(int i = 0; i < 30; ++i) {
+        QString prefix;
+        int length = 1 + qrand() % 3;
+        for(int j = 0; j < length; ++j)
+            prefix += pieces.at(qrand() % pieces.size());
+        prefixes << prefix;
+    }
+
+    QList<MLocale::CollatorStrength> strengths;
+    strengths << MLocale::CollatorStrengthPrimary
+              << MLocale::CollatorStrengthSecondary
+              << MLocale::CollatorStrengthTertiary;
+
+    MLocale locale("en_US");
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    MStringSearchIndex index(texts, locale);
+    foreach(MLocale::CollatorStrength strength, strengths) {
+        for(int shifted = 0; shifted < 2; ++shifted) {
+            index.setCollatorStrength(strength);
+            index.setAlternateHandlingShifted(shifted);
+            foreach(const QString &prefix, prefixes) {
+                // a row is expected if MStringSearch finds a match
+                // exactly at the start of a word:
+                QList<int> expectedRows;
+                for(int row = 0; row < texts.size(); ++row) {
+                    const QString &text = texts.at(row);
+                    if(text.isEmpty())
+                        continue;
+                    MStringSearch stringSearch(prefix, text, locale);
+                    stringSearch.setCollatorStrength(strength);
+                    stringSearch.setAlternateHandlingShifted(shifted);
+                    MBreakIterator wordIterator(locale, text, MBreakIterator::WordIterator);
+                    for(int boundary = 0; boundary >= 0 && boundary < text.size();
+                        boundary = wordIterator.next()) {
+                        if(!text.at(boundary).isLetterOrNumber()
+                           && !text.at(boundary).isHighSurrogate())
+                            continue;
+                        stringSearch.setOffset(boundary);
+                        if(stringSearch.next() == boundary) {
+                            expectedRows << row;
+                            break;
+                        }
+                    }
+                }
+                if(index.prefixMatchingRows(prefix) != expectedRows)
+                    qDebug() << "prefix" << prefix
+                             << "strength" << strength << "shifted" << shifted;
+                QCOMPARE(index.prefixMatchingRows(prefix), expectedRows);
+            }
+        }
+    }
+}
+
+void Ft_MStringSearch::testMultiStringSearch()
+{
+    MLocale locale("de_DE");
+    QStringList patterns;
+    patterns << "muller" << "strasse" << "Straße" << "x" << "" << "aupt" << "haupt";
+    MMultiStringSearch search(patterns, locale);
+    QCOMPARE(search.patterns(), patterns);
+    QList<MMultiStringSearch::Match> matches = search.findAll("Müller, Hauptstraße 1, Müller");
+    QCOMPARE(search.errorString(), QString());
+    QList<QList<int> > expected;
+    expected << (QList<int>() << 0 << 0 << 6)
+             << (QList<int>() << 6 << 8 << 5)
+             << (QList<int>() << 5 << 9 << 4)
+             << (QList<int>() << 1 << 13 << 6)
+             << (QList<int>() << 2 << 13 << 6)
+             << (QList<int>() << 0 << 23 << 6);
+    QCOMPARE(matches.size(), expected.size());
+    for(int i = 0; i < matches.size(); ++i) {
+        QCOMPARE(matches.at(i).pattern, expected.at(i).at(0));
+        QCOMPARE(matches.at(i).start, expected.at(i).at(1));
+        QCOMPARE(matches.at(i).length, expected.at(i).at(2));
+    }
+    search.setCollatorStrength(MLocale::CollatorStrengthTertiary);
+    matches = search.findAll("Müller, Hauptstraße 1, Müller");
+    QCOMPARE(matches.size(), 1);
+    QCOMPARE(matches.at(0).pattern, 5);
+    QCOMPARE(search.findAll(QString()).size(), 0);
+}
+
+void Ft_MStringSearch::testMultiStringSearchAgainstStringSearch_data()
+{
+    testSearchIndexAgainstStringSearch_data();
+}
+
+void Ft_MStringSearch::testMultiStringSearchAgainstStringSearch()
+{
+    QFETCH(QString, lcCollate);
+    QFETCH(MBreakIterator::Type, breakIteratorType);
+
+    const QStringList pieces = QString::fromUtf8(
+        "a|A|á|å|aa|Å|æ|ae|ö|o|e|é|ch|c|h| |-|ß|ss|\xcc\x81|\xcc\x88|中|文|刘|liu|ก|ไ|1|½|ﬁ|fi|x").split('|');
+    qsrand(4713);
+    QStringList texts;
+    for(int i = 0; i < 20; ++i) {
+        QString text;
+        int length = 1 + qrand() % 30;
+        for(int j = 0; j < length; ++j)
+            text += pieces.at(qrand() % pieces.size());
+        texts << text;
+    }
+    QStringList patterns;
+    for(int i = 0; i < 15; ++i) {
+        QString pattern;
+        int length = 1 + qrand() % 3;
+        for(int j = 0; j < length; ++j)
+            pattern += pieces.at(qrand() % pieces.size());
+        patterns << pattern;
+    }
+    // the same pattern twice has to be found twice:
+    patterns << patterns.first();
+
+    QList<MLocale::CollatorStrength> strengths;
+    strengths << MLocale::CollatorStrengthPrimary
+              << MLocale::CollatorStrengthSecondary
+              << MLocale::CollatorStrengthTertiary
+              << MLocale::CollatorStrengthQuaternary
+              << MLocale::CollatorStrengthIdentical;
+
+    MLocale locale("en_US");
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    MMultiStringSearch search(patterns, locale, breakIteratorType);
+    foreach(MLocale::CollatorStrength strength, strengths) {
+        for(int shifted = 0; shifted < 2; ++shifted) {
+            search.setCollatorStrength(strength);
+            search.setAlternateHandlingShifted(shifted);
+            foreach(const QString &text, texts) {
+                // ((start, pattern), length) sorts like the result of findAll():
+                QList<QPair<QPair<int, int>, int> > expected;
+                for(int i = 0; i < patterns.size(); ++i) {
+                    MStringSearch stringSearch(patterns.at(i), text, locale, breakIteratorType);
+                    stringSearch.setCollatorStrength(strength);
+                    stringSearch.setAlternateHandlingShifted(shifted);
+                    for(int start = stringSearch.first(); start != -1; start = stringSearch.next())
+                        expected << qMakePair(qMakePair(start, i), stringSearch.matchedLength());
+                }
+                qSort(expected);
+                QList<QPair<QPair<int, int>, int> > matches;
+                foreach(const MMultiStringSearch::Match &match, search.findAll(text))
+                    matches << qMakePair(qMakePair(match.start, match.pattern), match.length);
+                if(matches != expected)
+                    qDebug() << "text" << text << "strength" << strength << "shifted" << shifted;
+                QCOMPARE(matches, expected);
+            }
+        }
+    }
+}
+
+void Ft_MStringSearch::testSearchSession_data()
+{
+    QTest::addColumn<QString>("lcCollate");
+    QTest::addColumn<QStringList>("typedPatterns");
+
+    QTest::newRow("English typing and backspace")
+        << "en_US"
+        << (QStringList() << "a" << "aa" << "aal" << "aa" << "a" << "" << "o" << "ö" << "ö " << "ö x");
+    QTest::newRow("Danish contraction")
+        << "da_DK"
+        << (QStringList() << "a" << "aa" << "aal" << "aa" << "å" << "åa");
+    QTest::newRow("Czech contraction")
+        << "cs_CZ"
+        << (QStringList() << "c" << "ch" << "cha" << "ch" << "c" << "ci");
+    QTest::newRow("Chinese pinyin and Hani")
+        << "zh_CN"
+        << (QStringList() << "l" << "li" << "liu" << "liu刘" << "liu" << "刘" << "刘x");
+    QTest::newRow("combining accent")
+        << "de_DE"
+        << (QStringList() << "u" << "u\xcc\x88" << "u\xcc\x88b" << "u" << "\xcc\x88");
+}
+
+void Ft_MStringSearch::testSearchSession()
+{
+    QFETCH(QString, lcCollate);
+    QFETCH(QStringList, typedPatterns);
+
+    QStringList texts = QString::fromUtf8(
+        "Aaland|Åland|Aalborg|Ålborg|Chrudim|Cihelna|Cheb|Liu 刘|Liú Yang|刘德华|"
+        "Müller|Mueller|Über|Ubach|Ölund|O x|ö-x| |").split('|');
+    MLocale locale("en_US");
+    locale.setCategoryLocale(MLocale::MLcCollate, lcCollate);
+    MStringSearchIndex index(texts, locale);
+    QList<MLocale::CollatorStrength> strengths;
+    strengths << MLocale::CollatorStrengthPrimary
+              << MLocale::CollatorStrengthTertiary;
+    foreach(MLocale::CollatorStrength strength, strengths) {
+        for(int shifted = 0; shifted < 2; ++shifted) {
+            index.setCollatorStrength(strength);
+            index.setAlternateHandlingShifted(shifted);
+            MStringSearchSession session(&index);
+            foreach(const QString &pattern, typedPatterns) {
+                session.setPattern(pattern);
+                QCOMPARE(session.pattern(), pattern);
+                QCOMPARE(session.matchingRows(), index.matchingRows(pattern));
+                for(int row = 0; row < texts.size(); ++row) {
+                    int sessionLength = -1;
+                    int indexLength = -1;
+                    QCOMPARE(session.indexIn(row, &sessionLength),
+                             index.indexIn(row, pattern, &indexLength));
+                    QCOMPARE(sessionLength, indexLength);
+                }
+            }
+        }
+    }
+}
+
 QTEST_APPLESS_MAIN(Ft_MStringSearch);
 
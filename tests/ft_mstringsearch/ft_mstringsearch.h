@@ -28,6 +28,9 @@
 #include <QCoreApplication>
 
 #include <MStringSearch>
+#include <MStringSearchIndex>
+#include <MStringSearchSession>
+#include <MMultiStringSearch>
 
 Q_DECLARE_METATYPE(QList<int>);
 Q_DECLARE_METATYPE(ML10N::MBreakIterator::Type);
@@ -51,6 +54,31 @@ private slots:
 
     void testSearch_data();
     void testSearch();
+
+    void testCachedCollators();
+
+    void testFindAll_data();
+    void testFindAll();
+
+    void testSearchIndex_data();
+    void testSearchIndex();
+
+    void testSearchIndexAgainstStringSearch_data();
+    void testSearchIndexAgainstStringSearch();
+
+    void testPrefixMatchingRows_data();
+    void testPrefixMatchingRows();
+
+    void testPrefixMatchingRowsAgainstStringSearch_data();
+    void testPrefixMatchingRowsAgainstStringSearch();
+
+    void testMultiStringSearch();
+
+    void testMultiStringSearchAgainstStringSearch_data();
+    void testMultiStringSearchAgainstStringSearch();
+
+    void testSearchSession_data();
+    void testSearchSession();
 };
 
 #endif
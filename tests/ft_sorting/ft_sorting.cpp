@@ -24,6 +24,9 @@
 #include <QDebug>
 #include <QProcess>
 
+#include <unicode/coll.h>
+#include <unicode/locid.h>
+
 #define VERBOSE_OUTPUT
 
 using ML10N::MLocale;
@@ -536,4 +539,302 @@ void Ft_Sorting::testCompareWithLocale()
     QVERIFY2(mcomp.compare(loc2, str1, str2) == result, "Compare failed");
 }
 
+void Ft_Sorting::testCompareWithStrength_data()
+{
+    QTest::addColumn<QString>("locale_name");
+    QTest::addColumn<QString>("str1");
+    QTest::addColumn<QString>("str2");
+    QTest::addColumn<MLocale::CollatorStrength>("strength");
+    QTest::addColumn<MLocale::Comparison>("result");
+
+    QTest::newRow("de_DE-primary-case")
+            << QString("de_DE")
+            << QString("abc")
+            << QString("ABC")
+            << MLocale::CollatorStrengthPrimary
+            << MLocale::Equal;
+    QTest::newRow("de_DE-tertiary-case")
+            << QString("de_DE")
+            << QString("abc")
+            << QString("ABC")
+            << MLocale::CollatorStrengthTertiary
+            << MLocale::LessThan;
+    QTest::newRow("de_DE-primary-accent")
+            << QString("de_DE")
+            << QString("öfgh")
+            << QString("ofgh")
+            << MLocale::CollatorStrengthPrimary
+            << MLocale::Equal;
+    QTest::newRow("de_DE-secondary-accent")
+            << QString("de_DE")
+            << QString("öfgh")
+            << QString("ofgh")
+            << MLocale::CollatorStrengthSecondary
+            << MLocale::GreaterThan;
+    QTest::newRow("de_DE-quaternary-accent")
+            << QString("de_DE")
+            << QString("ofgh")
+            << QString("öfgh")
+            << MLocale::CollatorStrengthQuaternary
+            << MLocale::LessThan;
+    QTest::newRow("fi_FI-identical")
+            << QString("fi_FI")
+            << QString("AAA")
+            << QString("AAA")
+            << MLocale::CollatorStrengthIdentical
+            << MLocale::Equal;
+}
+
+void Ft_Sorting::testCompareWithStrength()
+{
+    QFETCH(QString, locale_name);
+    QFETCH(QString, str1);
+    QFETCH(QString, str2);
+    QFETCH(MLocale::CollatorStrength, strength);
+    QFETCH(MLocale::Comparison, result);
+
+    MLocale locale(locale_name);
+    MCollator mCollator = locale.collator();
+    QCOMPARE(mCollator.compare(str1, str2, strength), result);
+    // the strength of the collator itself must not change:
+    QCOMPARE(mCollator.strength(), MLocale::CollatorStrengthQuaternary);
+
+    // must give the same result as switching the strength:
+    MCollator mCollator2(locale);
+    mCollator2.setStrength(strength);
+    QCOMPARE(mCollator2.strength(), strength);
+    QCOMPARE(mCollator2(str1, str2), result == MLocale::LessThan);
+    QCOMPARE(mCollator2(str2, str1), result == MLocale::GreaterThan);
+
+    // copies keep the selected strength:
+    MCollator mCollator3(mCollator2);
+    QCOMPARE(mCollator3.strength(), strength);
+    QCOMPARE(mCollator3.compare(str1, str2, strength), result);
+    mCollator3 = mCollator;
+    QCOMPARE(mCollator3.strength(), MLocale::CollatorStrengthQuaternary);
+}
+
+void Ft_Sorting::testLatin1FastPath_data()
+{
+    QTest::addColumn<QString>("locale_name");
+
+    QTest::newRow("en_US") << QString("en_US");
+    QTest::newRow("de_DE") << QString("de_DE");
+    QTest::newRow("de_DE@collation=phonebook") << QString("de_DE@collation=phonebook");
+    QTest::newRow("fi_FI") << QString("fi_FI");
+    QTest::newRow("da_DK") << QString("da_DK");       // “aa” contraction
+    QTest::newRow("cs_CZ") << QString("cs_CZ");       // “ch” contraction
+    QTest::newRow("fr_CA") << QString("fr_CA");       // French secondary
+    QTest::newRow("es_ES@collation=traditional") << QString("es_ES@collation=traditional");
+    QTest::newRow("tr_TR") << QString("tr_TR");
+    QTest::newRow("is_IS") << QString("is_IS");
+    QTest::newRow("zh_CN@collation=pinyin") << QString("zh_CN@collation=pinyin");
+}
+
+// Compares the results of MCollator, which may use a table of
+// Latin-1 weights instead of icu, against the results of icu for
+// many random Latin-1 strings.
+void Ft_Sorting::testLatin1FastPath()
+{
+    QFETCH(QString, locale_name);
+
+    MLocale locale(locale_name);
+    MCollator mCollator = locale.collator();
+
+    UErrorCode status = U_ZERO_ERROR;
+    icu::Collator *icuCollator =
+        icu::Collator::createInstance(icu::Locale(locale.categoryName(MLocale::MLcCollate).toLatin1().constData()), status);
+    QVERIFY(U_SUCCESS(status));
+
+    QList<MLocale::CollatorStrength> strengths;
+    strengths << MLocale::CollatorStrengthPrimary
+              << MLocale::CollatorStrengthSecondary
+              << MLocale::CollatorStrengthTertiary
+              << MLocale::CollatorStrengthQuaternary
+              << MLocale::CollatorStrengthIdentical;
+    QList<icu::Collator::ECollationStrength> icuStrengths;
+    icuStrengths << icu::Collator::PRIMARY
+                 << icu::Collator::SECONDARY
+                 << icu::Collator::TERTIARY
+                 << icu::Collator::QUATERNARY
+                 << icu::Collator::IDENTICAL;
+
+    qsrand(4711);
+    for (int k = 0; k < 5000; ++k) {
+        QString s1;
+        QString s2;
+        int size1 = qrand() % 8;
+        int size2 = qrand() % 8;
+        for (int i = 0; i < size1; ++i)
+            s1 += (qrand() % 2) ? QChar('a' + qrand() % 26) : QChar(qrand() % 256);
+        for (int i = 0; i < size2; ++i)
+            s2 += (qrand() % 2) ? QChar('a' + qrand() % 26) : QChar(qrand() % 256);
+        if (k % 3 == 0 && !s1.isEmpty()) {
+            // nearly equal strings to exercise the lower levels:
+            s2 = s1;
+            s2[qrand() % s2.size()] = QChar(qrand() % 256);
+        }
+        const icu::UnicodeString us1(reinterpret_cast<const UChar *>(s1.utf16()), s1.size());
+        const icu::UnicodeString us2(reinterpret_cast<const UChar *>(s2.utf16()), s2.size());
+        for (int i = 0; i < strengths.size(); ++i) {
+            icuCollator->setStrength(icuStrengths[i]);
+            UCollationResult icuResult = icuCollator->compare(us1, us2, status);
+            MLocale::Comparison expected = MLocale::Equal;
+            if (icuResult == UCOL_LESS)
+                expected = MLocale::LessThan;
+            else if (icuResult == UCOL_GREATER)
+                expected = MLocale::GreaterThan;
+            QCOMPARE(mCollator.compare(s1, s2, strengths[i]), expected);
+            mCollator.setStrength(strengths[i]);
+            QCOMPARE(mCollator(s1, s2), expected == MLocale::LessThan);
+        }
+        QCOMPARE(MCollator::compare(locale, s1, s2),
+                 mCollator.compare(s1, s2, MLocale::CollatorStrengthQuaternary));
+    }
+    delete icuCollator;
+}
+
+void Ft_Sorting::testParallelSort_data()
+{
+    QTest::addColumn<QString>("locale_name");
+    QTest::addColumn<MLocale::CollatorStrength>("strength");
+    QTest::addColumn<int>("threads");
+    QTest::addColumn<int>("sortOrder");
+
+    QStringList localeNames;
+    localeNames << "de_DE" << "sv_SE" << "zh_CN@collation=pinyin";
+    QList<int> threadCounts;
+    threadCounts << 1 << 3 << 0;
+    foreach (const QString &localeName, localeNames) {
+        foreach (int threads, threadCounts) {
+            QTest::newRow(QString("%1 primary threads=%2").arg(localeName).arg(threads).toUtf8().constData())
+                << localeName << MLocale::CollatorStrengthPrimary << threads << int(Qt::AscendingOrder);
+            QTest::newRow(QString("%1 tertiary threads=%2 descending").arg(localeName).arg(threads).toUtf8().constData())
+                << localeName << MLocale::CollatorStrengthTertiary << threads << int(Qt::DescendingOrder);
+        }
+    }
+}
+
+void Ft_Sorting::testParallelSort()
+{
+    QFETCH(QString, locale_name);
+    QFETCH(MLocale::CollatorStrength, strength);
+    QFETCH(int, threads);
+    QFETCH(int, sortOrder);
+
+    MLocale locale(locale_name);
+    MCollator collator = locale.collator();
+    collator.setStrength(strength);
+
+    const QStringList syllables = QString::fromUtf8(
+        "a,A,ä,Ä,b,c,ch,o,ö,Ö,ü,u,z,å,é,e,E,阿,北,长,- , ").split(',');
+    QStringList list;
+    qsrand(4711);
+    for (int i = 0; i < 5000; ++i) {
+        QString s;
+        int size = qrand() % 5;
+        for (int j = 0; j < size; ++j)
+            s += syllables.at(qrand() % syllables.size());
+        list << s;
+    }
+
+    QStringList expected = list;
+    qStableSort(expected.begin(), expected.end(), collator);
+    if (Qt::SortOrder(sortOrder) == Qt::DescendingOrder) {
+        // reversing the stable ascending order also reverses the
+        // order of equal strings, therefore sort each run of equal
+        // strings back into the original order:
+        QStringList reversed;
+        int end = expected.size();
+        while (end > 0) {
+            int begin = end - 1;
+            while (begin > 0 && collator.compare(expected.at(begin - 1), expected.at(begin), strength) == MLocale::Equal)
+                --begin;
+            for (int i = begin; i < end; ++i)
+                reversed << expected.at(i);
+            end = begin;
+        }
+        expected = reversed;
+    }
+
+    QStringList stableSorted = list;
+    collator.sort(stableSorted, Qt::SortOrder(sortOrder), threads, true);
+    QCOMPARE(stableSorted, expected);
+
+    QStringList sorted = list;
+    collator.sort(sorted, Qt::SortOrder(sortOrder), threads, false);
+    QCOMPARE(sorted.size(), expected.size());
+    for (int i = 0; i < sorted.size(); ++i)
+        QCOMPARE(collator.compare(sorted.at(i), expected.at(i), strength), MLocale::Equal);
+}
+
+void Ft_Sorting::testMerge_data()
+{
+    QTest::addColumn<QString>("locale_name");
+    QTest::addColumn<int>("listCount");
+    QTest::addColumn<int>("sortOrder");
+
+    QStringList localeNames;
+    localeNames << "de_DE" << "cs_CZ" << "zh_CN@collation=pinyin";
+    QList<int> listCounts;
+    listCounts << 0 << 1 << 2 << 7;
+    foreach (const QString &localeName, localeNames) {
+        foreach (int listCount, listCounts) {
+            QTest::newRow(QString("%1 lists=%2").arg(localeName).arg(listCount).toUtf8().constData())
+                << localeName << listCount << int(Qt::AscendingOrder);
+            QTest::newRow(QString("%1 lists=%2 descending").arg(localeName).arg(listCount).toUtf8().constData())
+                << localeName << listCount << int(Qt::DescendingOrder);
+        }
+    }
+}
+
+void Ft_Sorting::testMerge()
+{
+    QFETCH(QString, locale_name);
+    QFETCH(int, listCount);
+    QFETCH(int, sortOrder);
+
+    MLocale locale(locale_name);
+    MCollator collator = locale.collator();
+    collator.setStrength(MLocale::CollatorStrengthPrimary);
+
+    const QStringList syllables = QString::fromUtf8(
+        "a,A,ä,b,c,ch,h,o,ö,z,é,e,阿,北,长").split(',');
+    qsrand(4711 + listCount);
+    QList<QStringList> lists;
+    QStringList all;
+    for (int l = 0; l < listCount; ++l) {
+        QStringList list;
+        int size = qrand() % 300;
+        for (int i = 0; i < size; ++i) {
+            QString s;
+            int length = qrand() % 4;
+            for (int j = 0; j < length; ++j)
+                s += syllables.at(qrand() % syllables.size());
+            list << s;
+        }
+        collator.sort(list, Qt::SortOrder(sortOrder), 1, true);
+        lists << list;
+        all << list;
+    }
+    QStringList expected = all;
+    collator.sort(expected, Qt::SortOrder(sortOrder), 1, true);
+
+    QList<QPair<int, int> > order = collator.merge(lists, Qt::SortOrder(sortOrder));
+    QCOMPARE(order.size(), all.size());
+    QStringList merged;
+    for (int i = 0; i < order.size(); ++i)
+        merged << lists.at(order.at(i).first).at(order.at(i).second);
+    QCOMPARE(merged, expected);
+
+    QList<QList<QByteArray> > keys;
+    foreach (const QStringList &list, lists) {
+        QList<QByteArray> listKeys;
+        foreach (const QString &string, list)
+            listKeys << collator.sortKey(string);
+        keys << listKeys;
+    }
+    QCOMPARE(MCollator::mergeSortKeys(keys, Qt::SortOrder(sortOrder)), order);
+}
+
 QTEST_APPLESS_MAIN(Ft_Sorting);
@@ -31,6 +31,7 @@ using ML10N::MLocale;
 Q_DECLARE_METATYPE(MLocale);
 Q_DECLARE_METATYPE(MLocale::Collation);
 Q_DECLARE_METATYPE(MLocale::Comparison);
+Q_DECLARE_METATYPE(MLocale::CollatorStrength);
 
 #define MAX_PARAMS 10
 class Ft_Sorting : public QObject
@@ -56,6 +57,18 @@ private slots:
 
     void testCompareWithLocale_data();
     void testCompareWithLocale();
+
+    void testCompareWithStrength_data();
+    void testCompareWithStrength();
+
+    void testLatin1FastPath_data();
+    void testLatin1FastPath();
+
+    void testParallelSort_data();
+    void testParallelSort();
+
+    void testMerge_data();
+    void testMerge();
 };
 
 
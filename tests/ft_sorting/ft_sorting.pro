@@ -18,4 +18,6 @@ SOURCES += \
 #    $$STUBSDIR/stubbase.cpp \
 
 
+LIBS += -licui18n -licuuc
+
 include(../common_bot.pri)
@@ -22,6 +22,8 @@
 #include "mcity.h"
 #include "mcountry.h"
 
+#include <math.h>
+
 #ifdef HAVE_ICU
 #include <unicode/timezone.h>
 #endif
@@ -133,6 +135,19 @@ void Ut_MLocationDatabase::testNearestCity_data()
         << qreal(60.205556)
         << qreal(24.655556)
         << "Helsinki";
+    // an unknown position, as reported by positioning APIs:
+    QTest::newRow("NaN")
+        << qreal(qQNaN())
+        << qreal(qQNaN())
+        << "";
+    QTest::newRow("NaN longitude")
+        << qreal(60.205556)
+        << qreal(qQNaN())
+        << "";
+    QTest::newRow("infinite latitude")
+        << qreal(qInf())
+        << qreal(24.655556)
+        << "";
 }
 
 void Ut_MLocationDatabase::testNearestCity()
@@ -155,6 +170,150 @@ void Ut_MLocationDatabase::testNearestCity()
              resultEnglishName);
 }
 
+// great circle distance in radians
+static double haversineDistance(double latitude1, double longitude1,
+                                double latitude2, double longitude2)
+{
+    const double radiansPerDegree = M_PI / 180.0;
+    const double sinHalfLatitude = sin((latitude2 - latitude1) * radiansPerDegree / 2);
+    const double sinHalfLongitude = sin((longitude2 - longitude1) * radiansPerDegree / 2);
+    const double a = sinHalfLatitude * sinHalfLatitude
+        + cos(latitude1 * radiansPerDegree) * cos(latitude2 * radiansPerDegree)
+        * sinHalfLongitude * sinHalfLongitude;
+    return 2 * atan2(sqrt(a), sqrt(1 - a));
+}
+
+void Ut_MLocationDatabase::testNearestCityBruteForce()
+{
+    MLocationDatabase db;
+    QList<MCity> cities = db.cities();
+
+    // do only run the tests, if we were able to load
+    // some cities from the meegotouch-cities-*
+    // package.
+    if (cities.count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+
+    // a grid over the whole globe, including the poles and both
+    // sides of the 180th meridian:
+    for (int latitude = -90; latitude <= 90; latitude += 5) {
+        for (int longitude = -180; longitude <= 180; longitude += 5) {
+            double expectedDistance = 10;
+            foreach (const MCity &city, cities) {
+                expectedDistance = qMin(expectedDistance,
+                                        haversineDistance(latitude, longitude,
+                                                          city.latitude(), city.longitude()));
+            }
+            MCity city = db.nearestCity(latitude, longitude);
+            double distance = haversineDistance(latitude, longitude,
+                                                city.latitude(), city.longitude());
+            QVERIFY2(qAbs(distance - expectedDistance) <= 1e-9,
+                     qPrintable(QString("at %1, %2: %3 is %4 away, expected %5")
+                                .arg(latitude).arg(longitude).arg(city.key())
+                                .arg(distance, 0, 'g', 12).arg(expectedDistance, 0, 'g', 12)));
+        }
+    }
+}
+
+void Ut_MLocationDatabase::testNearestCities_data()
+{
+    QTest::addColumn<qreal>("latitude");
+    QTest::addColumn<qreal>("longitude");
+    QTest::addColumn<int>("count");
+    QTest::addColumn<qreal>("radiusKm");
+
+    QTest::newRow("near Espoo") << qreal(60.205556) << qreal(24.655556) << 10 << qreal(500);
+    QTest::newRow("Fiji, 180th meridian") << qreal(-17.0) << qreal(179.9) << 10 << qreal(3000);
+    QTest::newRow("Fiji, other side") << qreal(-17.0) << qreal(-179.9) << 5 << qreal(3000);
+    QTest::newRow("north pole") << qreal(90.0) << qreal(0.0) << 20 << qreal(3000);
+    QTest::newRow("south pole") << qreal(-90.0) << qreal(0.0) << 1 << qreal(5000);
+    QTest::newRow("Atlantic") << qreal(0.0) << qreal(-30.0) << 3 << qreal(100);
+    QTest::newRow("nothing") << qreal(0.0) << qreal(0.0) << 0 << qreal(0);
+    QTest::newRow("everything") << qreal(48.0) << qreal(11.0) << 100000 << qreal(25000);
+}
+
+void Ut_MLocationDatabase::testNearestCities()
+{
+    QFETCH(qreal, latitude);
+    QFETCH(qreal, longitude);
+    QFETCH(int, count);
+    QFETCH(qreal, radiusKm);
+
+    MLocationDatabase db;
+    QList<MCity> cities = db.cities();
+
+    // do only run the tests, if we were able to load
+    // some cities from the meegotouch-cities-*
+    // package.
+    if (cities.count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+
+    const double earthRadiusKm = 6371.0;
+    QList<double> expectedDistances;
+    foreach (const MCity &city, cities) {
+        expectedDistances << haversineDistance(latitude, longitude,
+                                               city.latitude(), city.longitude()) * earthRadiusKm;
+    }
+    qSort(expectedDistances);
+
+    QList<MCity> nearest = db.nearestCities(latitude, longitude, count);
+    QCOMPARE(nearest.size(), qMin(count, cities.size()));
+    for (int i = 0; i < nearest.size(); ++i) {
+        double distance = haversineDistance(latitude, longitude,
+                                            nearest.at(i).latitude(), nearest.at(i).longitude())
+            * earthRadiusKm;
+        QVERIFY(qAbs(distance - expectedDistances.at(i)) < 1e-6);
+    }
+
+    QList<MCity> within = db.citiesWithin(latitude, longitude, radiusKm);
+    double lastDistance = 0;
+    QSet<QString> withinKeys;
+    foreach (const MCity &city, within) {
+        double distance = haversineDistance(latitude, longitude,
+                                            city.latitude(), city.longitude()) * earthRadiusKm;
+        QVERIFY(distance <= radiusKm + 1e-6);
+        QVERIFY(distance >= lastDistance - 1e-6);
+        lastDistance = distance;
+        withinKeys << city.key();
+    }
+    QCOMPARE(withinKeys.size(), within.size());
+    foreach (const MCity &city, cities) {
+        double distance = haversineDistance(latitude, longitude,
+                                            city.latitude(), city.longitude()) * earthRadiusKm;
+        if (distance < radiusKm - 1e-6)
+            QVERIFY2(withinKeys.contains(city.key()), qPrintable(city.key()));
+    }
+}
+
+void Ut_MLocationDatabase::testNearestCitiesInvalidPosition_data()
+{
+    QTest::addColumn<qreal>("latitude");
+    QTest::addColumn<qreal>("longitude");
+    QTest::addColumn<qreal>("radiusKm");
+
+    // an unknown position, as reported by positioning APIs:
+    QTest::newRow("NaN") << qreal(qQNaN()) << qreal(qQNaN()) << qreal(25000);
+    QTest::newRow("NaN latitude") << qreal(qQNaN()) << qreal(24.655556) << qreal(25000);
+    QTest::newRow("infinite longitude") << qreal(60.205556) << qreal(-qInf()) << qreal(25000);
+    QTest::newRow("NaN radius") << qreal(60.205556) << qreal(24.655556) << qreal(qQNaN());
+}
+
+void Ut_MLocationDatabase::testNearestCitiesInvalidPosition()
+{
+    QFETCH(qreal, latitude);
+    QFETCH(qreal, longitude);
+    QFETCH(qreal, radiusKm);
+
+    MLocationDatabase db;
+    if (!qIsFinite(latitude) || !qIsFinite(longitude))
+        QVERIFY(db.nearestCities(latitude, longitude, 10).isEmpty());
+    QVERIFY(db.citiesWithin(latitude, longitude, radiusKm).isEmpty());
+}
+
 void Ut_MLocationDatabase::testMatchingCities_data()
 {
     QTest::addColumn<QString>("pattern");
@@ -163,6 +322,77 @@ void Ut_MLocationDatabase::testMatchingCities_data()
     QTest::newRow("ber")
         << "ber"
         << (QStringList() << "Berlin" << "Bern");
+    QTest::newRow("BER")
+        << "BER"
+        << (QStringList() << "Berlin" << "Bern");
+    QTest::newRow("be")
+        << "be"
+        << (QStringList() << "Berlin" << "Bern");
+    QTest::newRow("sao paulo")
+        << "sao paulo"
+        << (QStringList() << "São Paulo");
+    QTest::newRow("REYKJAVIK")
+        << "REYKJAVIK"
+        << (QStringList() << "Reykjavík");
+    QTest::newRow("bogotá")
+        << "bogotá"
+        << (QStringList() << "Bogotá");
+    QTest::newRow("é")
+        << "é"
+        << (QStringList() << "Yaoundé" << "Lomé" << "Berlin");
+}
+
+static QString foldForMatching(const QString &str)
+{
+    QString result;
+    for (int i = 0; i < str.size(); ++i) {
+        QString decomposition = str[i].decomposition();
+        if (decomposition.isEmpty())
+            result += str[i];
+        else
+            for (int j = 0; j < decomposition.size(); ++j)
+                if (!decomposition[j].isMark())
+                    result += decomposition[j];
+    }
+    return result.toCaseFolded();
+}
+
+void Ut_MLocationDatabase::testMatchingCitiesBruteForce()
+{
+    MLocationDatabase db;
+    QList<MCity> cities = db.cities();
+
+    // do only run the tests if we were able to load
+    // some cities from the meegotouch-cities-*
+    // package.
+    if (cities.count() < 10) {
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+
+    QStringList patterns;
+    patterns << "" << "a" << "LO" << "ber" << "São" << "an jo" << "los ange"
+             << "ville" << "xyzzy" << "aaa";
+    // and some pieces of the names of the cities themselves:
+    for (int i = 0; i < cities.size(); i += 37) {
+        const QString name = cities.at(i).englishName();
+        patterns << name << name.mid(1, 3) << name.mid(2, 5).toUpper();
+    }
+    foreach (const QString &pattern, patterns) {
+        const QString folded = foldForMatching(pattern);
+        QStringList expectedKeys;
+        foreach (const MCity &city, cities) {
+            if (foldForMatching(city.englishName()).contains(folded)
+                || foldForMatching(city.localName()).contains(folded))
+                expectedKeys << city.key();
+        }
+        QStringList keys;
+        foreach (const MCity &city, db.matchingCities(pattern))
+            keys << city.key();
+        qSort(expectedKeys);
+        qSort(keys);
+        QCOMPARE(keys, expectedKeys);
+    }
 }
 
 void Ut_MLocationDatabase::testMatchingCities()
@@ -896,4 +1126,103 @@ void Ut_MLocationDatabase::testTimeZoneOffsets()
     QProcess::execute("cat " + errorFileName);
     QVERIFY2(allErrors.isEmpty(), qPrintable("There were errors, please check contents of " + errorFileName));
 }
+static QStringList dumpLocationDatabase(MLocationDatabase &db)
+{
+    QStringList lines;
+    foreach (const MCountry &country, db.countries()) {
+        lines << "country\t" + country.key() + '\t' + country.englishName()
+            + '\t' + country.localName() + '\t' + country.countryCode();
+    }
+    foreach (const MCity &city, db.cities()) {
+        lines << "city\t" + city.key() + '\t' + city.englishName()
+            + '\t' + city.localName() + '\t' + city.timeZone()
+            + '\t' + city.country().key() + '\t' + city.country().englishName()
+            + '\t' + QString::number(city.latitude(), 'g', 17)
+            + '\t' + QString::number(city.longitude(), 'g', 17);
+    }
+    // the time zone aliases are used by citiesInTimeZone():
+    foreach (const MCity &city, db.citiesInTimeZone("US/Pacific"))
+        lines << "US/Pacific\t" + city.key();
+    qSort(lines.begin(), lines.end());
+    return lines;
+}
+
+void Ut_MLocationDatabase::testBinaryDatabase()
+{
+    const QByteArray savedCacheHome = qgetenv("XDG_CACHE_HOME");
+    const QString cacheHome = QDir::tempPath() + "/ut_mlocationdatabase-cache";
+    const QString cacheFileName = cacheHome + "/mlocale/locationdatabase.bin";
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(cacheHome));
+    QFile::remove(cacheFileName);
+
+    // the data is shared by all instances, each of them is deleted
+    // before creating the next one to load the data again:
+    MLocationDatabase *xmlDb = new MLocationDatabase;
+    // do only run the tests, if we were able to load
+    // some cities from the meegotouch-cities-*
+    // package.
+    if (xmlDb->cities().count() < 10) {
+        delete xmlDb;
+        qputenv("XDG_CACHE_HOME", savedCacheHome);
+        qWarning( "loading of city list failed, skipping test" );
+        return;
+    }
+    const QStringList expected = dumpLocationDatabase(*xmlDb);
+    delete xmlDb;
+    if (!QFile::exists("/usr/share/meegotouch/locationdatabase/locationdatabase.bin"))
+        QVERIFY(QFile::exists(cacheFileName));
+
+    // loaded from the binary database now:
+    MLocationDatabase *binaryDb = new MLocationDatabase;
+    QCOMPARE(dumpLocationDatabase(*binaryDb), expected);
+    delete binaryDb;
+
+    // a broken cache is ignored and written again:
+    QFile cacheFile(cacheFileName);
+    if (cacheFile.exists()) {
+        const qint64 cacheSize = cacheFile.size();
+        QVERIFY(cacheFile.open(QIODevice::ReadWrite));
+        cacheFile.resize(cacheSize / 2);
+        cacheFile.close();
+        MLocationDatabase rebuiltDb;
+        QCOMPARE(dumpLocationDatabase(rebuiltDb), expected);
+        QCOMPARE(QFileInfo(cacheFileName).size(), cacheSize);
+    }
+
+    const QString binaryFileName = QDir::tempPath() + "/ut_mlocationdatabase.bin";
+    QVERIFY(MLocationDatabase::writeBinaryDatabase(binaryFileName));
+    QVERIFY(QFileInfo(binaryFileName).size() > 0);
+    QFile::remove(binaryFileName);
+
+    QFile::remove(cacheFileName);
+    qputenv("XDG_CACHE_HOME", savedCacheHome);
+}
+
+void Ut_MLocationDatabase::testSharedDatabase()
+{
+    // deleting the last instance while loading in the background
+    // frees the data when loading has finished:
+    MLocationDatabase *db = new MLocationDatabase;
+    QFuture<void> future = db->loadInBackground();
+    delete db;
+    future.waitForFinished();
+
+    MLocationDatabase db1;
+    QVERIFY(!db1.isLoaded());
+    future = db1.loadInBackground();
+    // a second instance shares the data of the first one and waits
+    // for the background loading on the first query:
+    MLocationDatabase db2;
+    QList<MCity> cities = db2.cities();
+    QVERIFY(db1.isLoaded());
+    QVERIFY(db2.isLoaded());
+    future.waitForFinished();
+    QVERIFY(future.isFinished());
+    QCOMPARE(db1.cities().count(), cities.count());
+    QCOMPARE(db1.countries().count(), db2.countries().count());
+
+    MLocationDatabase db3;
+    QVERIFY(db3.isLoaded());
+}
+
 QTEST_APPLESS_MAIN(Ut_MLocationDatabase);
@@ -43,12 +43,19 @@ private slots:
 
     void testNearestCity_data();
     void testNearestCity();
+    void testNearestCityBruteForce();
+
+    void testNearestCities_data();
+    void testNearestCities();
+    void testNearestCitiesInvalidPosition_data();
+    void testNearestCitiesInvalidPosition();
 
     void testCitiesInCountry_data();
     void testCitiesInCountry();
 
     void testMatchingCities_data();
     void testMatchingCities();
+    void testMatchingCitiesBruteForce();
 
     void testCitiesInTimeZone_data();
     void testCitiesInTimeZone();
@@ -64,6 +71,9 @@ private slots:
     void testCitiesDumpInfo();
 
     void testTimeZoneOffsets();
+
+    void testBinaryDatabase();
+    void testSharedDatabase();
 };
 
 #endif